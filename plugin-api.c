@@ -85,12 +85,38 @@ bool mce_hybris_keypad_set_brightness     (int level);
  * INDICATOR_LED_PATTERN
  * ------------------------------------------------------------------------- */
 
+static void mce_hybris_indicator_sanitize_pattern(int *r, int *g, int *b, int *ms_on, int *ms_off);
+static void mce_hybris_indicator_convert_keyframes(led_keyframe_t *dst, const mce_hybris_keyframe_t *src, int count);
+static bool mce_hybris_indicator_apply_pattern(void);
+static void mce_hybris_indicator_reapply  (void);
+static void mce_hybris_indicator_probed_cb(bool found);
+static void mce_hybris_indicator_hal_blink_cb(void *data, int on_ms, int off_ms);
+static void mce_hybris_indicator_hal_value_cb(void *data, int r, int g, int b);
+static bool mce_hybris_indicator_hal_attach(void);
+
 bool mce_hybris_indicator_init            (void);
 void mce_hybris_indicator_quit            (void);
 bool mce_hybris_indicator_set_pattern     (int r, int g, int b, int ms_on, int ms_off);
+bool mce_hybris_indicator_set_sequence    (const mce_hybris_keyframe_t *frames, int count, int repeat);
 bool mce_hybris_indicator_can_breathe     (void);
 void mce_hybris_indicator_enable_breathing(bool enable);
 bool mce_hybris_indicator_set_brightness  (int level);
+bool mce_hybris_indicator_get_wakeup_rate (int *curr, int *avg);
+bool mce_hybris_indicator_get_downgrade_stats(int *count, int *secs);
+bool mce_hybris_indicator_estimate_pattern(int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool mce_hybris_indicator_estimate_named  (const char *name, int *led_ua, int *cpu_ua);
+bool mce_hybris_indicator_pattern_register(const char *name, int priority, int slice_ms, const mce_hybris_keyframe_t *frames, int count);
+bool mce_hybris_indicator_pattern_unregister(const char *name);
+bool mce_hybris_indicator_pattern_activate(const char *name, bool active);
+
+/* ------------------------------------------------------------------------- *
+ * EXTRA_LED_PATTERN
+ * ------------------------------------------------------------------------- */
+
+bool mce_hybris_led_set_pattern           (const char *led, int r, int g, int b, int ms_on, int ms_off);
+bool mce_hybris_led_set_sequence          (const char *led, const mce_hybris_keyframe_t *frames, int count, int repeat);
+bool mce_hybris_led_can_breathe           (const char *led);
+bool mce_hybris_led_enable_breathing      (const char *led, bool enable);
 
 /* ------------------------------------------------------------------------- *
  * PROXIMITY_SENSOR
@@ -139,6 +165,9 @@ mce_hybris_framebuffer_quit(void)
 }
 
 /** Set frame buffer power state via libhybris
+ *
+ * The state is also passed to sysfs led engine, which downgrades
+ * led patterns needing frequent wakeups while display is off.
  *
  * @param state true to power on, false to power off
  *
@@ -147,7 +176,11 @@ mce_hybris_framebuffer_quit(void)
 bool
 mce_hybris_framebuffer_set_power(bool state)
 {
-  return hybris_device_fb_set_power(state);
+  bool ack = hybris_device_fb_set_power(state);
+
+  sysfs_led_set_display_state(state);
+
+  return ack;
 }
 
 /* ========================================================================= *
@@ -236,10 +269,274 @@ clamp_to_range(int lo, int hi, int val)
   return val <= lo ? lo : val <= hi ? val : hi;
 }
 
-/** Flag for: controls for RGB leds exist in sysfs */
-static bool mce_hybris_indicator_uses_sysfs = false;
+/** Flag for: indicator led is driven via sysfs led engine
+ *
+ * Normally this means controls for RGB leds exist in sysfs, but
+ * the engine can also be driving the libhybris indicator device.
+ */
+static bool mce_hybris_indicator_uses_engine = false;
+
+/** Flag for: indicator led is controlled via libhybris */
+static bool mce_hybris_indicator_uses_hal = false;
+
+/** Last requested indicator led state
+ *
+ * Retained so that it can be applied to led backends that
+ * get taken in use after the request was made.
+ */
+static struct
+{
+  bool pattern_set;
+  int  r, g, b;
+  int  ms_on, ms_off;
+  bool breathe;
+  int  level;
+
+  /* Keyframe sequence, used instead of pattern if frame_count > 0 */
+  led_keyframe_t frames[SYSFS_LED_KEYFRAMES_MAX];
+  int            frame_count;
+  int            frame_repeat;
+} mce_hybris_indicator_last =
+{
+  .pattern_set = false,
+  .breathe     = false,
+  .level       = 0,
+  .frame_count = 0,
+};
+
+/** Sanitize led pattern values
+ *
+ * @param r      red intensity, clamped to 0 ... 255
+ * @param g      green intensity, clamped to 0 ... 255
+ * @param b      blue intensity, clamped to 0 ... 255
+ * @param ms_on  milliseconds on, clamped to 50 ... 60000 or 0
+ * @param ms_off milliseconds off, clamped to 50 ... 60000 or 0
+ */
+static void
+mce_hybris_indicator_sanitize_pattern(int *r, int *g, int *b,
+                                      int *ms_on, int *ms_off)
+{
+  /* Clamp time periods to [0, 60] second range.
+   *
+   * While periods longer than few seconds might not count as "blinking",
+   * we need to leave some slack to allow beacon style patterns with
+   * relatively long off periods */
+  *ms_on  = clamp_to_range(0, 60000, *ms_on);
+  *ms_off = clamp_to_range(0, 60000, *ms_off);
+
+  /* Both on and off periods need to be non-zero for the blinking
+   * to happen in the first place. And if the periods are too
+   * short it starts to look like led failure more than indication
+   * of something. */
+  if( *ms_on < 50 || *ms_off < 50 ) {
+    *ms_on = *ms_off = 0;
+  }
+
+  /* Clamp rgb values to [0, 255] range */
+  *r = clamp_to_range(0, 255, *r);
+  *g = clamp_to_range(0, 255, *g);
+  *b = clamp_to_range(0, 255, *b);
+}
+
+/** Convert keyframes from plugin api to led engine format
+ *
+ * Input values are sanitized like in mce_hybris_indicator_set_pattern().
+ */
+static void
+mce_hybris_indicator_convert_keyframes(led_keyframe_t *dst,
+                                       const mce_hybris_keyframe_t *src,
+                                       int count)
+{
+  for( int i = 0; i < count; ++i ) {
+    dst[i].r        = clamp_to_range(0, 255, src[i].r);
+    dst[i].g        = clamp_to_range(0, 255, src[i].g);
+    dst[i].b        = clamp_to_range(0, 255, src[i].b);
+    dst[i].duration = clamp_to_range(50, 60000, src[i].ms);
+    dst[i].interp   = (src[i].interp == MCE_HYBRIS_KEYFRAME_LINEAR ?
+                       LED_INTERP_LINEAR : LED_INTERP_HOLD);
+  }
+}
+
+/** Apply last requested pattern to active led backend
+ *
+ * @return true on success, false on failure
+ */
+static bool
+mce_hybris_indicator_apply_pattern(void)
+{
+  bool ack = false;
+
+  int r      = mce_hybris_indicator_last.r;
+  int g      = mce_hybris_indicator_last.g;
+  int b      = mce_hybris_indicator_last.b;
+  int ms_on  = mce_hybris_indicator_last.ms_on;
+  int ms_off = mce_hybris_indicator_last.ms_off;
+
+  int count  = mce_hybris_indicator_last.frame_count;
+  int repeat = mce_hybris_indicator_last.frame_repeat;
+
+  if( count > 0 ) {
+    /* Keyframe sequences are supported only via led engine */
+    if( mce_hybris_indicator_uses_engine ) {
+      ack = sysfs_led_set_sequence(mce_hybris_indicator_last.frames,
+                                   count, repeat);
+    }
+
+    mce_log(LL_DEBUG, "sequence(%d,%d) -> %s",
+            count, repeat, ack ? "success" : "failure");
+    goto cleanup;
+  }
+
+  /* Use led engine if possible */
+
+  if( mce_hybris_indicator_uses_engine ) {
+    ack = sysfs_led_set_pattern(r, g, b, ms_on, ms_off);
+  }
+  else if( mce_hybris_indicator_uses_hal ) {
+    ack = hybris_device_indicator_set_pattern(r, g, b, ms_on, ms_off);
+  }
+
+  mce_log(LL_DEBUG, "pattern(%d,%d,%d,%d,%d) -> %s",
+          r,g,b, ms_on, ms_off , ack ? "success" : "failure");
+
+cleanup:
+
+  return ack;
+}
+
+/** Apply last requested indicator state to newly selected backend
+ */
+static void
+mce_hybris_indicator_reapply(void)
+{
+  if( mce_hybris_indicator_uses_engine ) {
+    if( mce_hybris_indicator_last.level > 0 ) {
+      sysfs_led_set_brightness(mce_hybris_indicator_last.level);
+    }
+    sysfs_led_set_breathing(mce_hybris_indicator_last.breathe);
+  }
+
+  if( mce_hybris_indicator_last.pattern_set ) {
+    mce_hybris_indicator_apply_pattern();
+  }
+}
+
+/** Callback for handling late sysfs led probing results
+ *
+ * @param found true if sysfs led backend was taken in use
+ */
+static void
+mce_hybris_indicator_probed_cb(bool found)
+{
+  if( !found ) {
+    goto cleanup;
+  }
+
+  if( mce_hybris_indicator_uses_hal ) {
+    /* Sysfs backend showed up late, switch over */
+    mce_log(LL_NOTICE, "switching indicator led from libhybris to sysfs");
+    hybris_device_indicator_quit();
+    mce_hybris_indicator_uses_hal = false;
+  }
+  mce_hybris_indicator_uses_engine = true;
+  mce_hybris_indicator_reapply();
+
+cleanup:
+
+  return;
+}
+
+/** Blinking period last requested by led engine from libhybris led */
+static struct
+{
+  int on_ms, off_ms;
+} mce_hybris_indicator_hal_blink =
+{
+  .on_ms  = 0,
+  .off_ms = 0,
+};
+
+/** Led engine callback for changing libhybris led blinking
+ *
+ * The libhybris api takes color and blinking in one go, so the
+ * period is just cached here and applied with the next color.
+ *
+ * @param data   unused
+ * @param on_ms  milliseconds on, or 0 for no blinking
+ * @param off_ms milliseconds off, or 0 for no blinking
+ */
+static void
+mce_hybris_indicator_hal_blink_cb(void *data, int on_ms, int off_ms)
+{
+  (void)data;
+
+  mce_hybris_indicator_hal_blink.on_ms  = on_ms;
+  mce_hybris_indicator_hal_blink.off_ms = off_ms;
+}
+
+/** Led engine callback for changing libhybris led color
+ *
+ * While breathing the blinking period is zero, i.e. only the
+ * color of the light state changes from one step to the next.
+ *
+ * @param data unused
+ * @param r    red intensity   (0 ... 255)
+ * @param g    green intensity (0 ... 255)
+ * @param b    blue intensity  (0 ... 255)
+ */
+static void
+mce_hybris_indicator_hal_value_cb(void *data, int r, int g, int b)
+{
+  (void)data;
+
+  hybris_device_indicator_set_pattern(r, g, b,
+                                      mce_hybris_indicator_hal_blink.on_ms,
+                                      mce_hybris_indicator_hal_blink.off_ms);
+}
+
+/** Try to let led engine drive the libhybris indicator led
+ *
+ * The led engine measures set_light() latency and takes the device
+ * in use only if it is fast enough for sw breathing. Then the same
+ * breathing step tables and wakeup budget are used as with sysfs
+ * backends. Otherwise libhybris is used directly for hw blinking.
+ *
+ * @return true if led engine is driving the led, false otherwise
+ */
+static bool
+mce_hybris_indicator_hal_attach(void)
+{
+  led_control_t control =
+  {
+    .name        = "libhybris",
+    .data        = 0,
+    .can_breathe = true,
+    .blocking    = false,
+    .use_config  = false,
+    .breath_type = LED_RAMP_HALF_SINE,
+    .settle_type = LED_SETTLE_NONE,
+    .settle_ms   = 0,
+    .step_delay  = 0,
+    .max_steps   = 0,
+    .enable      = 0,
+    .blink       = mce_hybris_indicator_hal_blink_cb,
+    .value       = mce_hybris_indicator_hal_value_cb,
+    /* The device is released by mce_hybris_indicator_quit() */
+    .close       = 0,
+  };
+
+  bool ack = sysfs_led_attach(&control);
+
+  mce_log(LL_DEBUG, "res = %s", ack ? "true" : "false");
+
+  return ack;
+}
 
 /** Initialize libhybris indicator led device object
+ *
+ * Sysfs led backends are probed first, and libhybris is used as
+ * fallback if none are found. Sysfs led backends that show up later
+ * on replace the libhybris fallback.
  *
  * @return true on success, false on failure
  */
@@ -255,10 +552,14 @@ mce_hybris_indicator_init(void)
 
   done = true;
 
-  if( sysfs_led_init() ) {
-    mce_hybris_indicator_uses_sysfs = true;
+  if( sysfs_led_init(mce_hybris_indicator_probed_cb) ) {
+    mce_hybris_indicator_uses_engine = true;
+  }
+  else if( hybris_device_indicator_init() ) {
+    mce_hybris_indicator_uses_hal = true;
+    mce_hybris_indicator_uses_engine = mce_hybris_indicator_hal_attach();
   }
-  else if( !hybris_device_indicator_init() ) {
+  else {
     goto  cleanup;
   }
 
@@ -276,13 +577,14 @@ cleanup:
 void
 mce_hybris_indicator_quit(void)
 {
-  if( mce_hybris_indicator_uses_sysfs ) {
-    /* Release sysfs controls */
-    sysfs_led_quit();
-  }
-  else {
+  /* Release sysfs controls / stop probing */
+  sysfs_led_quit();
+  mce_hybris_indicator_uses_engine = false;
+
+  if( mce_hybris_indicator_uses_hal ) {
     /* Release libhybris controls */
     hybris_device_indicator_quit();
+    mce_hybris_indicator_uses_hal = false;
   }
 }
 
@@ -299,44 +601,51 @@ mce_hybris_indicator_quit(void)
 bool
 mce_hybris_indicator_set_pattern(int r, int g, int b, int ms_on, int ms_off)
 {
-  bool     ack = false;
-
   /* Sanitize input values */
+  mce_hybris_indicator_sanitize_pattern(&r, &g, &b, &ms_on, &ms_off);
 
-  /* Clamp time periods to [0, 60] second range.
-   *
-   * While periods longer than few seconds might not count as "blinking",
-   * we need to leave some slack to allow beacon style patterns with
-   * relatively long off periods */
-  ms_on  = clamp_to_range(0, 60000, ms_on);
-  ms_off = clamp_to_range(0, 60000, ms_off);
-
-  /* Both on and off periods need to be non-zero for the blinking
-   * to happen in the first place. And if the periods are too
-   * short it starts to look like led failure more than indication
-   * of something. */
-  if( ms_on < 50 || ms_off < 50 ) {
-    ms_on = ms_off = 0;
-  }
+  mce_hybris_indicator_last.pattern_set = true;
+  mce_hybris_indicator_last.r      = r;
+  mce_hybris_indicator_last.g      = g;
+  mce_hybris_indicator_last.b      = b;
+  mce_hybris_indicator_last.ms_on  = ms_on;
+  mce_hybris_indicator_last.ms_off = ms_off;
+  mce_hybris_indicator_last.frame_count = 0;
 
-  /* Clamp rgb values to [0, 255] range */
-  r = clamp_to_range(0, 255, r);
-  g = clamp_to_range(0, 255, g);
-  b = clamp_to_range(0, 255, b);
-
-  /* Use raw sysfs controls if possible */
+  return mce_hybris_indicator_apply_pattern();
+}
 
-  if( mce_hybris_indicator_uses_sysfs ) {
-    ack = sysfs_led_set_pattern(r, g, b, ms_on, ms_off);
-  }
-  else {
-    ack = hybris_device_indicator_set_pattern(r, g, b, ms_on, ms_off);
+/** Set indicator led keyframe sequence
+ *
+ * The sequence is compiled into led engine step table and runs
+ * without further requests. Setting a plain pattern cancels it.
+ *
+ * Sequences are supported only when the led engine is in use; failure
+ * is returned when libhybris is used directly for led control.
+ *
+ * @param frames keyframes
+ * @param count  number of keyframes, at most 32
+ * @param repeat number of times to play the sequence, or 0 for forever
+ *
+ * @return true on success, false on failure
+ */
+bool
+mce_hybris_indicator_set_sequence(const mce_hybris_keyframe_t *frames,
+                                  int count, int repeat)
+{
+  if( !frames || count < 1 || count > SYSFS_LED_KEYFRAMES_MAX ) {
+    mce_log(LL_WARN, "invalid keyframe count: %d", count);
+    return false;
   }
 
-  mce_log(LL_DEBUG, "pattern(%d,%d,%d,%d,%d) -> %s",
-          r,g,b, ms_on, ms_off , ack ? "success" : "failure");
+  mce_hybris_indicator_convert_keyframes(mce_hybris_indicator_last.frames,
+                                         frames, count);
 
-  return ack;
+  mce_hybris_indicator_last.pattern_set  = true;
+  mce_hybris_indicator_last.frame_count  = count;
+  mce_hybris_indicator_last.frame_repeat = clamp_to_range(0, 1000, repeat);
+
+  return mce_hybris_indicator_apply_pattern();
 }
 
 /** Query if currently active led backend can support breathing
@@ -348,24 +657,25 @@ mce_hybris_indicator_can_breathe(void)
 {
   bool ack = false;
 
-  /* Note: We can't know how access via hybris behaves, so err
-   *       on the safe side and assume that breathing is not ok
-   *       unless we have direct sysfs controls.
+  /* Note: Direct libhybris access is assumed not to be fast
+   *       enough for breathing. The led engine is used with
+   *       libhybris only if measured latency allows breathing.
    */
 
-  if( mce_hybris_indicator_uses_sysfs )
+  if( mce_hybris_indicator_uses_engine )
   {
     ack = sysfs_led_can_breathe();
   }
 
-  /* The result does not change during runtime of mce, so
-   * log only once */
+  /* The result is fixed during init and changes only if sysfs
+   * led backend shows up late and replaces libhybris, so log
+   * only changes */
 
-  static bool logged = false;
+  static int logged = -1;
 
-  if( !logged )
+  if( logged != ack )
   {
-    logged = true;
+    logged = ack;
     mce_log(LL_DEBUG, "res = %s", ack ? "true" : "false");
   }
 
@@ -381,7 +691,9 @@ mce_hybris_indicator_enable_breathing(bool enable)
 {
   mce_log(LL_DEBUG, "enable = %s", enable ? "true" : "false");
 
-  if( mce_hybris_indicator_uses_sysfs ) {
+  mce_hybris_indicator_last.breathe = enable;
+
+  if( mce_hybris_indicator_uses_engine ) {
     sysfs_led_set_breathing(enable);
   }
 }
@@ -397,10 +709,12 @@ mce_hybris_indicator_set_brightness(int level)
 {
   mce_log(LL_DEBUG, "level = %d", level);
 
-  if( mce_hybris_indicator_uses_sysfs ) {
-    /* Clamp brightness values to [1, 255] range */
-    level = clamp_to_range(1, 255, level);
+  /* Clamp brightness values to [1, 255] range */
+  level = clamp_to_range(1, 255, level);
 
+  mce_hybris_indicator_last.level = level;
+
+  if( mce_hybris_indicator_uses_engine ) {
     sysfs_led_set_brightness(level);
   }
 
@@ -409,6 +723,310 @@ mce_hybris_indicator_set_brightness(int level)
   return true;
 }
 
+/** Get indicator led timer wakeup rates
+ *
+ * @param curr where to store rate implied by active pattern [1/min]
+ * @param avg  where to store average rate since init [1/min]
+ *
+ * @return true on success, or false if led engine is not in use
+ */
+bool
+mce_hybris_indicator_get_wakeup_rate(int *curr, int *avg)
+{
+  bool ack = false;
+
+  if( mce_hybris_indicator_uses_engine ) {
+    sysfs_led_get_wakeup_rate(curr, avg);
+    ack = true;
+  }
+
+  return ack;
+}
+
+/** Get statistics about indicator led patterns downgraded while display is off
+ *
+ * @param count where to store number of downgrades since init
+ * @param secs  where to store total time spent downgraded [s]
+ *
+ * @return true on success, or false if led engine is not in use
+ */
+bool
+mce_hybris_indicator_get_downgrade_stats(int *count, int *secs)
+{
+  bool ack = false;
+
+  if( mce_hybris_indicator_uses_engine ) {
+    sysfs_led_get_downgrade_stats(count, secs);
+    ack = true;
+  }
+
+  return ack;
+}
+
+/** Estimate battery cost of indicator led pattern
+ *
+ * Allows mce to prefer cheaper patterns e.g. in power saving mode.
+ * Led current is estimated from per channel currents configured in
+ * LEDConfigHybris group, and cpu current from number of led timer
+ * wakeups the pattern needs.
+ *
+ * @param r       red intensity 0 ... 255
+ * @param g       green intensity 0 ... 255
+ * @param b       blue intensity 0 ... 255
+ * @param ms_on   milliseconds to keep the led on, or 0 for no flashing
+ * @param ms_off  milliseconds to keep the led off, or 0 for no flashing
+ * @param breathe true to evaluate sw breathing instead of blinking
+ * @param led_ua  where to store average led current [uA], or -1 if
+ *                not configured
+ * @param cpu_ua  where to store average cpu current [uA]
+ *
+ * @return true on success, or false if led engine is not in use
+ */
+bool
+mce_hybris_indicator_estimate_pattern(int r, int g, int b,
+                                      int ms_on, int ms_off, bool breathe,
+                                      int *led_ua, int *cpu_ua)
+{
+  bool ack = false;
+
+  if( !led_ua || !cpu_ua ) {
+    goto cleanup;
+  }
+
+  r = clamp_to_range(0, 255, r);
+  g = clamp_to_range(0, 255, g);
+  b = clamp_to_range(0, 255, b);
+  ms_on  = clamp_to_range(0, 60000, ms_on);
+  ms_off = clamp_to_range(0, 60000, ms_off);
+
+  if( mce_hybris_indicator_uses_engine ) {
+    ack = sysfs_led_estimate_pattern(r, g, b, ms_on, ms_off, breathe,
+                                     led_ua, cpu_ua);
+  }
+
+cleanup:
+
+  return ack;
+}
+
+/** Estimate battery cost of registered indicator led pattern
+ *
+ * @param name    pattern name
+ * @param led_ua  where to store average led current [uA], or -1 if
+ *                not configured
+ * @param cpu_ua  where to store average cpu current [uA]
+ *
+ * @return true on success, or false if the pattern is not registered
+ */
+bool
+mce_hybris_indicator_estimate_named(const char *name,
+                                    int *led_ua, int *cpu_ua)
+{
+  bool ack = false;
+
+  if( !name || !led_ua || !cpu_ua ) {
+    goto cleanup;
+  }
+
+  if( mce_hybris_indicator_uses_engine ) {
+    ack = sysfs_led_estimate_named(name, led_ua, cpu_ua);
+  }
+
+cleanup:
+
+  return ack;
+}
+
+/** Register named indicator led pattern to in-plugin pattern stack
+ *
+ * Registered patterns are precompiled, and switching between them
+ * does not require led restart. While any of the registered patterns
+ * is active, it is shown instead of the pattern set via
+ * mce_hybris_indicator_set_pattern(). The highest priority active
+ * pattern is shown, and patterns of equal priority take turns - each
+ * shown for its time slice.
+ *
+ * The pattern stack is available only when the led is driven via
+ * led engine; on failure mce is expected to do pattern arbitration itself.
+ *
+ * @param name     pattern name
+ * @param priority pattern priority, higher values preempt lower ones
+ * @param slice_ms time slice for taking turns [ms], or 0 for default
+ * @param frames   keyframes
+ * @param count    number of keyframes, at most 32
+ *
+ * @return true on success, false on failure
+ */
+bool
+mce_hybris_indicator_pattern_register(const char *name, int priority,
+                                      int slice_ms,
+                                      const mce_hybris_keyframe_t *frames,
+                                      int count)
+{
+  bool ack = false;
+
+  if( !name || !frames || count < 1 || count > SYSFS_LED_KEYFRAMES_MAX ) {
+    mce_log(LL_WARN, "invalid pattern parameters");
+    goto cleanup;
+  }
+
+  if( !mce_hybris_indicator_uses_engine ) {
+    goto cleanup;
+  }
+
+  led_keyframe_t work[SYSFS_LED_KEYFRAMES_MAX];
+  mce_hybris_indicator_convert_keyframes(work, frames, count);
+
+  slice_ms = clamp_to_range(0, 60000, slice_ms);
+
+  ack = sysfs_led_pattern_register(name, priority, slice_ms, work, count);
+
+cleanup:
+
+  mce_log(LL_DEBUG, "pattern %s, priority %d -> %s",
+          name ?: "(null)", priority, ack ? "success" : "failure");
+
+  return ack;
+}
+
+/** Remove named indicator led pattern from in-plugin pattern stack
+ *
+ * @param name pattern name
+ *
+ * @return true on success, false on failure
+ */
+bool
+mce_hybris_indicator_pattern_unregister(const char *name)
+{
+  bool ack = false;
+
+  if( name && mce_hybris_indicator_uses_engine ) {
+    ack = sysfs_led_pattern_unregister(name);
+  }
+
+  return ack;
+}
+
+/** Activate/deactivate named indicator led pattern
+ *
+ * @param name   pattern name
+ * @param active true to make the pattern eligible for showing
+ *
+ * @return true on success, false on failure
+ */
+bool
+mce_hybris_indicator_pattern_activate(const char *name, bool active)
+{
+  bool ack = false;
+
+  if( name && mce_hybris_indicator_uses_engine ) {
+    ack = sysfs_led_pattern_activate(name, active);
+  }
+
+  return ack;
+}
+
+/* ========================================================================= *
+ * EXTRA_LED_PATTERN
+ * ========================================================================= */
+
+/** Set pattern for an extra led
+ *
+ * Extra leds, e.g. charging or button leds, are configured via
+ * ExtraLeds setting and driven by led engine instances of their own.
+ *
+ * @param led   led name as used in ExtraLeds setting
+ * @param r     red intensity 0 ... 255
+ * @param g     green intensity 0 ... 255
+ * @param b     blue intensity 0 ... 255
+ * @param ms_on milliseconds to keep the led on, or 0 for no flashing
+ * @param ms_on milliseconds to keep the led off, or 0 for no flashing
+ *
+ * @return true on success, false if the led is not available
+ */
+bool
+mce_hybris_led_set_pattern(const char *led, int r, int g, int b,
+                           int ms_on, int ms_off)
+{
+  sysfs_led_t *self = sysfs_led_lookup(led);
+
+  if( self ) {
+    mce_hybris_indicator_sanitize_pattern(&r, &g, &b, &ms_on, &ms_off);
+    sysfs_led_object_set_pattern(self, r, g, b, ms_on, ms_off);
+  }
+
+  mce_log(LL_DEBUG, "%s: pattern(%d,%d,%d,%d,%d) -> %s", led ?: "(null)",
+          r,g,b, ms_on, ms_off, self ? "success" : "failure");
+
+  return self != 0;
+}
+
+/** Set keyframe sequence for an extra led
+ *
+ * @param led    led name as used in ExtraLeds setting
+ * @param frames array of keyframes
+ * @param count  number of keyframes
+ * @param repeat number of times to play the sequence, or 0 for forever
+ *
+ * @return true on success, false on failure
+ */
+bool
+mce_hybris_led_set_sequence(const char *led,
+                            const mce_hybris_keyframe_t *frames,
+                            int count, int repeat)
+{
+  sysfs_led_t   *self = sysfs_led_lookup(led);
+  led_keyframe_t conv[SYSFS_LED_KEYFRAMES_MAX];
+
+  if( !self ) {
+    return false;
+  }
+
+  if( !frames || count < 1 || count > SYSFS_LED_KEYFRAMES_MAX ) {
+    mce_log(LL_WARN, "invalid keyframe count: %d", count);
+    return false;
+  }
+
+  mce_hybris_indicator_convert_keyframes(conv, frames, count);
+  sysfs_led_object_set_sequence(self, conv, count,
+                                clamp_to_range(0, 1000, repeat));
+
+  return true;
+}
+
+/** Query if an extra led can support breathing
+ *
+ * @param led led name as used in ExtraLeds setting
+ *
+ * @return true if breathing can be requested, false otherwise
+ */
+bool
+mce_hybris_led_can_breathe(const char *led)
+{
+  sysfs_led_t *self = sysfs_led_lookup(led);
+
+  return self && sysfs_led_object_can_breathe(self);
+}
+
+/** Enable/disable sw breathing for an extra led
+ *
+ * @param led    led name as used in ExtraLeds setting
+ * @param enable true to enable sw breathing, false to disable
+ *
+ * @return true on success, false if the led is not available
+ */
+bool
+mce_hybris_led_enable_breathing(const char *led, bool enable)
+{
+  sysfs_led_t *self = sysfs_led_lookup(led);
+
+  if( self ) {
+    sysfs_led_object_set_breathing(self, enable);
+  }
+
+  return self != 0;
+}
+
 /* ========================================================================= *
  * PROXIMITY_SENSOR
  * ========================================================================= */
@@ -72,12 +72,44 @@ bool mce_hybris_keypad_init(void);
  * indicator led pattern
  * - - - - - - - - - - - - - - - - - - - */
 
+/** Keyframe interpolation styles */
+typedef enum
+{
+  MCE_HYBRIS_KEYFRAME_HOLD   = 0, // constant color
+  MCE_HYBRIS_KEYFRAME_LINEAR = 1, // fade to the next keyframe color
+} mce_hybris_keyframe_interp_t;
+
+/** Indicator led sequence keyframe */
+typedef struct
+{
+  int r, g, b;    // color 0 ... 255
+  int ms;         // keyframe duration
+  int interp;     // mce_hybris_keyframe_interp_t
+} mce_hybris_keyframe_t;
+
 bool mce_hybris_indicator_init(void);
 void mce_hybris_indicator_quit(void);
 bool mce_hybris_indicator_set_pattern(int r, int g, int b, int ms_on, int ms_off);
+bool mce_hybris_indicator_set_sequence(const mce_hybris_keyframe_t *frames, int count, int repeat);
 void mce_hybris_indicator_enable_breathing(bool enable);
 bool mce_hybris_indicator_set_brightness(int level);
 bool mce_hybris_indicator_can_breathe(void);
+bool mce_hybris_indicator_get_wakeup_rate(int *curr, int *avg);
+bool mce_hybris_indicator_get_downgrade_stats(int *count, int *secs);
+bool mce_hybris_indicator_estimate_pattern(int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool mce_hybris_indicator_estimate_named(const char *name, int *led_ua, int *cpu_ua);
+bool mce_hybris_indicator_pattern_register(const char *name, int priority, int slice_ms, const mce_hybris_keyframe_t *frames, int count);
+bool mce_hybris_indicator_pattern_unregister(const char *name);
+bool mce_hybris_indicator_pattern_activate(const char *name, bool active);
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * extra led pattern
+ * - - - - - - - - - - - - - - - - - - - */
+
+bool mce_hybris_led_set_pattern(const char *led, int r, int g, int b, int ms_on, int ms_off);
+bool mce_hybris_led_set_sequence(const char *led, const mce_hybris_keyframe_t *frames, int count, int repeat);
+bool mce_hybris_led_can_breathe(const char *led);
+bool mce_hybris_led_enable_breathing(const char *led, bool enable);
 
 /* - - - - - - - - - - - - - - - - - - - *
  * proximity sensor
@@ -33,26 +33,35 @@
  * SETTINGS
  * ========================================================================= */
 
+extern gboolean   mce_conf_has_group (const gchar *group);
+extern gboolean   mce_conf_has_key   (const gchar *group, const gchar *key);
+extern gchar     *mce_conf_get_string(const gchar *group, const gchar *key, const gchar *defaultval);
+extern gchar    **mce_conf_get_keys  (const gchar *group, gsize *length);
+
+/** Preloaded key -> value table, or NULL if not preloaded */
+static GHashTable *plugin_config_cache = 0;
+
+/** Group the preloaded values belong to */
+static gchar      *plugin_config_cache_group = 0;
+
 gchar *
 plugin_config_get_string(const gchar *group,
                          const gchar *key,
                          const gchar *defaultval)
 {
-    extern gboolean mce_conf_has_key(const gchar *group,
-                                     const gchar *key);
-
-    extern gchar *mce_conf_get_string(const gchar *group,
-                                      const gchar *key,
-                                      const gchar *defaultval);
-
     gchar *res = 0;
 
+    if( plugin_config_cache && !g_strcmp0(group, plugin_config_cache_group) ) {
+        /* Preloaded values can be used also from worker threads */
+        const gchar *val = g_hash_table_lookup(plugin_config_cache, key);
+        res = g_strdup(val ?: defaultval);
+    }
     /* From MCE point of view it is suspicious if code tries to
      * access settings that are not defined and warning is emitted
      * in such cases. Whereas from this plugin point of view all
      * settings are optional -> check that key actually exists before
      * attempting to fetch the value to avoid unwanted logging. */
-    if( !mce_conf_has_key(group, key) )
+    else if( !mce_conf_has_key(group, key) )
         res = defaultval ? g_strdup(defaultval) : 0;
     else
         res = mce_conf_get_string(group, key, defaultval);
@@ -62,11 +71,87 @@ plugin_config_get_string(const gchar *group,
     return res;
 }
 
+/** Read all settings in a group into memory
+ *
+ * The mce configuration API must be used only from the mainloop
+ * thread. After preloading, plugin_config_get_string() serves the
+ * group from memory and can be used also from worker threads.
+ *
+ * Note: Must be called from mainloop while no worker threads that
+ *       might access configuration are running.
+ *
+ * @param group configuration group name
+ */
+void
+plugin_config_preload(const gchar *group)
+{
+    gsize   count = 0;
+    gchar **keys  = 0;
+
+    plugin_config_unload();
+
+    plugin_config_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, g_free);
+    plugin_config_cache_group = g_strdup(group);
+
+    if( !mce_conf_has_group(group) )
+        goto EXIT;
+
+    if( !(keys = mce_conf_get_keys(group, &count)) )
+        goto EXIT;
+
+    for( gsize i = 0; i < count; ++i ) {
+        gchar *val = mce_conf_get_string(group, keys[i], 0);
+        if( val )
+            g_hash_table_replace(plugin_config_cache, g_strdup(keys[i]), val);
+    }
+
+EXIT:
+    mce_log(LOG_DEBUG, "[%s] %u values preloaded", group,
+            g_hash_table_size(plugin_config_cache));
+
+    g_strfreev(keys);
+}
+
+/** Release preloaded settings
+ *
+ * Note: Must be called from mainloop while no worker threads that
+ *       might access configuration are running.
+ */
+void
+plugin_config_unload(void)
+{
+    if( plugin_config_cache ) {
+        g_hash_table_unref(plugin_config_cache);
+        plugin_config_cache = 0;
+    }
+
+    g_free(plugin_config_cache_group);
+    plugin_config_cache_group = 0;
+}
+
 static inline void *lea(const void *base, int offs)
 {
     return ((char *)base)+offs;
 }
 
+/** Config group objconf_parse() reads from, or NULL for the default */
+static gchar *objconf_group = 0;
+
+/** Select config group to use for parsing led configuration
+ *
+ * Note: Led backends are probed one at a time, and the group must
+ *       stay the same while probing a backend.
+ *
+ * @param group config group name, or NULL for LEDConfigHybris
+ */
+void
+objconf_set_group(const char *group)
+{
+    g_free(objconf_group);
+    objconf_group = g_strdup(group);
+}
+
 /** Set all configurable dynamic data to null
  *
  * @param cfg configuration lookup table
@@ -108,6 +193,8 @@ objconf_parse(const objconf_t *cfg, void *obj, const char *chn)
     int    set = 0;
     gchar *dir = 0;
 
+    const char *group = objconf_group ?: MCE_CONF_LED_CONFIG_HYBRIS_GROUP;
+
     char tmp[256];
 
     /* Fetch channel/led directory in form of:
@@ -119,7 +206,7 @@ objconf_parse(const objconf_t *cfg, void *obj, const char *chn)
      * for multichannel leds.
      */
     snprintf(tmp, sizeof tmp, "%sDirectory", chn);
-    dir = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP, tmp, 0);
+    dir = plugin_config_get_string(group, tmp, 0);
 
     for( size_t i = 0; cfg[i].type != CONFTYPE_NONE; ++i ) {
         const char *ini_key    = cfg[i].key;
@@ -136,16 +223,14 @@ objconf_parse(const objconf_t *cfg, void *obj, const char *chn)
              * Where MEMBER is "Brightness", "MaxBrightness", etc
              */
             snprintf(tmp, sizeof tmp, "%s%sFile", chn, ini_key);
-            ini_value = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
-                                           tmp, 0);
+            ini_value = plugin_config_get_string(group, tmp, 0);
             if( !ini_value && dir ) {
                 /* Fetch control file path relative to directory
                  *
                  * <MEMBER>File=brightness
                  */
                 snprintf(tmp, sizeof tmp, "%sFile", ini_key);
-                ini_value = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
-                                               tmp, 0);
+                ini_value = plugin_config_get_string(group, tmp, 0);
             }
 
             if( !ini_value && cfg[i].def ) {
@@ -169,13 +254,12 @@ objconf_parse(const objconf_t *cfg, void *obj, const char *chn)
              * Where MEMBER is "OnValue", "OffValue", etc
              */
             snprintf(tmp, sizeof tmp, "%s%s", chn, ini_key);
-            ini_value = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
-                                           tmp, 0);
+            ini_value = plugin_config_get_string(group, tmp, 0);
 
             if( !ini_value ) {
                 snprintf(tmp, sizeof tmp, "%s", ini_key);
-                ini_value = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
-                                               tmp, cfg[i].def);
+                ini_value = plugin_config_get_string(group, tmp,
+                                                 cfg[i].def);
             }
 
             if( ini_value )
@@ -43,7 +43,48 @@
 /** Optional enable/disable sw breathing setting */
 #define MCE_CONF_LED_CONFIG_HYBRIS_BREATHING "QuirkBreathing"
 
+/** Optional enable/disable led writer thread setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_WRITER_THREAD "QuirkWriterThread"
+
+/** Optional enable/disable led write latency calibration setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_CALIBRATE "QuirkCalibrate"
+
+/** Optional maximum number of led timer wakeups per minute setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_WAKEUP_BUDGET "QuirkWakeupBudget"
+
+/** Optional breathing timer slack [ms] setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_TIMER_SLACK "QuirkTimerSlack"
+
+/** Optional enable/disable sysfs change notification tracking setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_SYSFS_NOTIFY "QuirkSysfsNotify"
+
+/** Optional pattern downgrade policy while display is off setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_DISPLAY_OFF_POLICY "QuirkDisplayOffPolicy"
+
+/** Optional led current at full red intensity [mA] setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_RED_CURRENT "RedCurrent"
+
+/** Optional led current at full green intensity [mA] setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_GREEN_CURRENT "GreenCurrent"
+
+/** Optional led current at full blue intensity [mA] setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_BLUE_CURRENT "BlueCurrent"
+
+/** Optional battery charge used per led timer wakeup [uAs] setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_WAKEUP_CHARGE "WakeupCharge"
+
+/** Optional led timer backend (glib / thread) setting */
+#define MCE_CONF_LED_CONFIG_HYBRIS_TIMER_BACKEND "TimerBackend"
+
+/** Optional directory to use as root for led sysfs paths */
+#define MCE_CONF_LED_CONFIG_HYBRIS_SYSFS_ROOT "SysfsRoot"
+
+/** Optional list of extra leds that have config groups of their own */
+#define MCE_CONF_LED_CONFIG_HYBRIS_EXTRA_LEDS "ExtraLeds"
+
 gchar * plugin_config_get_string(const gchar *group, const gchar *key, const gchar *defaultval);
+void    plugin_config_preload   (const gchar *group);
+void    plugin_config_unload    (void);
 
 typedef enum
 {
@@ -113,6 +154,7 @@ typedef struct
          .off = offsetof(obj_,memb_),\
      }
 
+void objconf_set_group(const char *group);
 void objconf_init(const objconf_t *cfg, void *obj);
 void objconf_quit(const objconf_t *cfg, void *obj);
 bool objconf_parse(const objconf_t *cfg, void *obj, const char *chn);
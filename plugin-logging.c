@@ -28,14 +28,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
+
+#include <glib.h>
 
 /* ========================================================================= *
  * PROTOTYPES
  * ========================================================================= */
 
+/** Log message queued from worker thread */
+typedef struct mce_hybris_logmsg_t mce_hybris_logmsg_t;
+
+struct mce_hybris_logmsg_t
+{
+  mce_hybris_logmsg_t *next;
+  int                  lev;
+  const char          *file;
+  const char          *func;
+  char                *text;
+};
+
+static void     mce_hybris_log_init     (void) __attribute__((constructor));
+static void     mce_hybris_log_quit     (void) __attribute__((destructor));
+static void     mce_hybris_log_emit     (int lev, const char *file, const char *func, const char *text);
+static void     mce_hybris_log_flush    (void);
+static gboolean mce_hybris_log_flush_cb (gpointer aptr);
+static void     mce_hybris_log_queue    (int lev, const char *file, const char *func, char *text);
+
 void mce_hybris_set_log_hook(mce_hybris_log_fn cb);
+int  mce_hybris_log_p       (int lev, const char *file, const char *func);
 void mce_hybris_log         (int lev, const char *file, const char *func, const char *fmt, ...);
 
+/** Log level check provided by mce, if the plugin is loaded to mce */
+extern int mce_log_p_(int lev, const char *file, const char *func) __attribute__((weak));
+
 /* ========================================================================= *
  * DATA
  * ========================================================================= */
@@ -43,10 +69,135 @@ void mce_hybris_log         (int lev, const char *file, const char *func, const
 /** Callback function for diagnostic output, or NULL for stderr output */
 static mce_hybris_log_fn mce_hybris_log_cb = 0;
 
+/** Thread that is allowed to call the logging callback directly */
+static pthread_t mce_hybris_log_thread;
+
+/** Mutex for protecting worker thread log message queue */
+static pthread_mutex_t mce_hybris_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Log messages from worker threads waiting to be emitted */
+static mce_hybris_logmsg_t *mce_hybris_log_head = 0;
+static mce_hybris_logmsg_t *mce_hybris_log_tail = 0;
+
+/** Idle callback id for flushing queued log messages */
+static guint mce_hybris_log_flush_id = 0;
+
 /* ========================================================================= *
  * FUNCTIONS
  * ========================================================================= */
 
+/** Remember the mainloop thread on plugin load
+ *
+ * The plugin is loaded from mce mainloop thread, logging from
+ * any other thread must be routed via mainloop.
+ */
+static void
+mce_hybris_log_init(void)
+{
+  mce_hybris_log_thread = pthread_self();
+}
+
+/** Emit still queued log messages on plugin unload
+ *
+ * The idle callback must not be left pending, as it would be
+ * dispatched after the plugin code has been unmapped.
+ */
+static void
+mce_hybris_log_quit(void)
+{
+  mce_hybris_log_flush();
+}
+
+/** Pass log message to mce, or print it to stderr
+ */
+static void
+mce_hybris_log_emit(int lev, const char *file, const char *func,
+                    const char *text)
+{
+  if( mce_hybris_log_cb ) {
+    mce_hybris_log_cb(lev, file, func, text);
+  }
+  else {
+    fprintf(stderr, "%s: %s: %s\n", file, func, text);
+  }
+}
+
+/** Emit log messages queued from worker threads
+ *
+ * Must be called from the mainloop thread.
+ */
+static void
+mce_hybris_log_flush(void)
+{
+  pthread_mutex_lock(&mce_hybris_log_mutex);
+  mce_hybris_logmsg_t *head = mce_hybris_log_head;
+  mce_hybris_log_head = mce_hybris_log_tail = 0;
+  guint id = mce_hybris_log_flush_id;
+  mce_hybris_log_flush_id = 0;
+  pthread_mutex_unlock(&mce_hybris_log_mutex);
+
+  if( id )
+    g_source_remove(id);
+
+  while( head ) {
+    mce_hybris_logmsg_t *msg = head;
+    head = msg->next;
+    mce_hybris_log_emit(msg->lev, msg->file, msg->func, msg->text);
+    free(msg->text);
+    free(msg);
+  }
+}
+
+/** Idle callback for emitting log messages queued from worker threads
+ */
+static gboolean
+mce_hybris_log_flush_cb(gpointer aptr)
+{
+  (void)aptr;
+
+  pthread_mutex_lock(&mce_hybris_log_mutex);
+  mce_hybris_log_flush_id = 0;
+  pthread_mutex_unlock(&mce_hybris_log_mutex);
+
+  mce_hybris_log_flush();
+
+  return FALSE;
+}
+
+/** Queue log message from worker thread to be emitted from mainloop
+ *
+ * @param text message text, ownership is transferred
+ */
+static void
+mce_hybris_log_queue(int lev, const char *file, const char *func,
+                     char *text)
+{
+  mce_hybris_logmsg_t *msg = calloc(1, sizeof *msg);
+
+  if( !msg ) {
+    free(text);
+    goto EXIT;
+  }
+
+  msg->lev  = lev;
+  msg->file = file;
+  msg->func = func;
+  msg->text = text;
+
+  pthread_mutex_lock(&mce_hybris_log_mutex);
+  if( mce_hybris_log_tail )
+    mce_hybris_log_tail->next = msg;
+  else
+    mce_hybris_log_head = msg;
+  mce_hybris_log_tail = msg;
+  if( !mce_hybris_log_flush_id )
+    mce_hybris_log_flush_id = g_idle_add(mce_hybris_log_flush_cb, 0);
+  pthread_mutex_unlock(&mce_hybris_log_mutex);
+
+EXIT:
+  return;
+}
+
 /** Set diagnostic output forwarding callback
  *
  * @param cb  The callback function to use, or NULL for stderr output
@@ -57,6 +208,27 @@ mce_hybris_set_log_hook(mce_hybris_log_fn cb)
   mce_hybris_log_cb = cb;
 }
 
+/** Check if message at given level would be emitted
+ *
+ * If mce provides log level check, it is used. Otherwise -
+ * for example when output goes to stderr - everything is
+ * assumed to be emitted.
+ *
+ * @param lev  syslog priority (=mce_log level) i.e. LL_ERR etc
+ * @param file source code path
+ * @param func name of function within file
+ *
+ * @return non-zero if the message should be formatted and emitted
+ */
+int
+mce_hybris_log_p(int lev, const char *file, const char *func)
+{
+  if( mce_hybris_log_cb && mce_log_p_ )
+    return mce_log_p_(lev, file, func);
+
+  return 1;
+}
+
 /** Wrapper for diagnostic logging
  *
  * @param lev  syslog priority (=mce_log level) i.e. LL_ERR etc
@@ -76,13 +248,16 @@ mce_hybris_log(int lev, const char *file, const char *func,
   if( vasprintf(&msg, fmt, va) < 0 ) msg = 0;
   va_end(va);
 
-  if( msg ) {
-    if( mce_hybris_log_cb ) {
-      mce_hybris_log_cb(lev, file, func, msg);
-    }
-    else {
-      fprintf(stderr, "%s: %s: %s\n", file, func, msg);
-    }
-    free(msg);
+  if( !msg ) {
+    // nop
+  }
+  else if( !pthread_equal(mce_hybris_log_thread, pthread_self()) ) {
+    /* The logging in mce is not thread safe */
+    mce_hybris_log_queue(lev, file, func, msg), msg = 0;
   }
+  else {
+    mce_hybris_log_emit(lev, file, func, msg);
+  }
+
+  free(msg);
 }
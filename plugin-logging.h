@@ -41,8 +41,17 @@ enum
 void mce_hybris_log(int lev, const char *file, const char *func,
                     const char *fmt, ...) __attribute__ ((format (printf, 4, 5)));
 
-/** Logging from hybris plugin mimics mce-log.h API */
+int  mce_hybris_log_p(int lev, const char *file, const char *func);
+
+/** Logging from hybris plugin mimics mce-log.h API
+ *
+ * Like in mce, the message is not formatted at all unless
+ * it is going to be emitted.
+ */
 # define mce_log(LEV,FMT,ARGS...) \
-   mce_hybris_log(LEV, __FILE__, __FUNCTION__ ,FMT, ## ARGS)
+   do {\
+     if( mce_hybris_log_p(LEV, __FILE__, __FUNCTION__) )\
+       mce_hybris_log(LEV, __FILE__, __FUNCTION__ ,FMT, ## ARGS);\
+   } while(0)
 
 #endif /* PLUGIN_LOGGING_H_ */
@@ -49,7 +49,13 @@ static const char * const quirk_false_lut[] =
 /** Quirk enum id to settings ini-file key lookup table */
 static const char * const quirk_name_lut[QUIRK_COUNT] =
 {
-    [QUIRK_BREATHING] = MCE_CONF_LED_CONFIG_HYBRIS_BREATHING,
+    [QUIRK_BREATHING]     = MCE_CONF_LED_CONFIG_HYBRIS_BREATHING,
+    [QUIRK_WRITER_THREAD] = MCE_CONF_LED_CONFIG_HYBRIS_WRITER_THREAD,
+    [QUIRK_CALIBRATE]     = MCE_CONF_LED_CONFIG_HYBRIS_CALIBRATE,
+    [QUIRK_WAKEUP_BUDGET] = MCE_CONF_LED_CONFIG_HYBRIS_WAKEUP_BUDGET,
+    [QUIRK_TIMER_SLACK]   = MCE_CONF_LED_CONFIG_HYBRIS_TIMER_SLACK,
+    [QUIRK_SYSFS_NOTIFY]  = MCE_CONF_LED_CONFIG_HYBRIS_SYSFS_NOTIFY,
+    [QUIRK_DISPLAY_OFF_POLICY] = MCE_CONF_LED_CONFIG_HYBRIS_DISPLAY_OFF_POLICY,
 };
 
 /** Flag array for: quirk setting has been defined in mce config */
@@ -176,6 +182,20 @@ quirk_name(quirk_t id)
  */
 int
 quirk_value(quirk_t id, int def)
+{
+    quirk_preload();
+
+    return quirk_is_defined(id) ? quirk_value_lut[id] : def;
+}
+
+/** Read quirk settings from configuration, if not done already
+ *
+ * Quirks are otherwise read on first use. Calling this from mainloop
+ * before starting threads that use quirks avoids racing the lazy
+ * initialization.
+ */
+void
+quirk_preload(void)
 {
     static bool done = false;
 
@@ -183,6 +203,4 @@ quirk_value(quirk_t id, int def)
         done = true;
         plugin_quirk_init();
     }
-
-    return quirk_is_defined(id) ? quirk_value_lut[id] : def;
 }
@@ -39,6 +39,24 @@ typedef enum
     /** Override sw breathing desicion made by led backend */
     QUIRK_BREATHING,
 
+    /** Make led backend writes from a worker thread */
+    QUIRK_WRITER_THREAD,
+
+    /** Calibrate breathing parameters from led write latency */
+    QUIRK_CALIBRATE,
+
+    /** Maximum number of led timer wakeups per minute */
+    QUIRK_WAKEUP_BUDGET,
+
+    /** Breathing timer slack in milliseconds */
+    QUIRK_TIMER_SLACK,
+
+    /** Track kernel side changes to led brightness */
+    QUIRK_SYSFS_NOTIFY,
+
+    /** How to downgrade led patterns while display is off */
+    QUIRK_DISPLAY_OFF_POLICY,
+
     /** Number of quirks */
     QUIRK_COUNT
 } quirk_t;
@@ -47,6 +65,8 @@ const char *quirk_name(quirk_t id);
 
 int quirk_value(quirk_t id, int def);
 
+void quirk_preload(void);
+
 /** Helper for caching quirk value locally and logging use for debug purposes
  */
 #define QUIRK(id,def) ({\
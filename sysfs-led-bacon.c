@@ -36,10 +36,11 @@
 #include "sysfs-led-bacon.h"
 
 #include "sysfs-led-util.h"
+#include "sysfs-val.h"
 #include "plugin-logging.h"
 #include "plugin-config.h"
 
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -59,13 +60,12 @@ typedef struct
 
 typedef struct
 {
-  int fd_brightness;
-  int fd_grpfreq;
-  int fd_grppwm;
-  int fd_blink;
-  int fd_ledreset;
+  sysfsval_t *cached_brightness;
+  sysfsval_t *cached_grpfreq;
+  sysfsval_t *cached_grppwm;
+  sysfsval_t *cached_blink;
+  sysfsval_t *cached_ledreset;
 
-  int brightness;
   int freq;
   int pwm;
   int blink;
@@ -98,24 +98,35 @@ bool               led_control_bacon_probe           (led_control_t *self);
 static void
 led_channel_bacon_init(led_channel_bacon_t *self)
 {
-  self->fd_brightness = -1;
-  self->fd_grpfreq = -1;
-  self->fd_grppwm = -1;
-  self->fd_blink = -1;
-  self->fd_ledreset = -1;
-
-  self->blink = 0;
+  self->cached_brightness = sysfsval_create();
+  self->cached_grpfreq    = sysfsval_create();
+  self->cached_grppwm     = sysfsval_create();
+  self->cached_blink      = sysfsval_create();
+  self->cached_ledreset   = sysfsval_create();
+
+  self->freq   = 0;
+  self->pwm    = 0;
+  self->blink  = 0;
   self->maxval = 255; // load from max_brightness?
 }
 
 static void
 led_channel_bacon_close(led_channel_bacon_t *self)
 {
-  led_util_close_file(&self->fd_brightness);
-  led_util_close_file(&self->fd_grpfreq);
-  led_util_close_file(&self->fd_grppwm);
-  led_util_close_file(&self->fd_blink);
-  led_util_close_file(&self->fd_ledreset);
+  sysfsval_delete(self->cached_brightness),
+    self->cached_brightness = 0;
+
+  sysfsval_delete(self->cached_grpfreq),
+    self->cached_grpfreq = 0;
+
+  sysfsval_delete(self->cached_grppwm),
+    self->cached_grppwm = 0;
+
+  sysfsval_delete(self->cached_blink),
+    self->cached_blink = 0;
+
+  sysfsval_delete(self->cached_ledreset),
+    self->cached_ledreset = 0;
 }
 
 static bool
@@ -124,13 +135,11 @@ led_channel_bacon_probe(led_channel_bacon_t *self,
 {
   bool res = false;
 
-  led_channel_bacon_close(self);
-
-  if( !led_util_open_file(&self->fd_brightness, path->brightness) ||
-      !led_util_open_file(&self->fd_grpfreq, path->grpfreq) ||
-      !led_util_open_file(&self->fd_grppwm, path->grppwm) ||
-      !led_util_open_file(&self->fd_blink, path->blink) ||
-      !led_util_open_file(&self->fd_ledreset, path->ledreset))
+  if( !sysfsval_open_wo(self->cached_brightness, path->brightness) ||
+      !sysfsval_open_wo(self->cached_grpfreq, path->grpfreq) ||
+      !sysfsval_open_wo(self->cached_grppwm, path->grppwm) ||
+      !sysfsval_open_wo(self->cached_blink, path->blink) ||
+      !sysfsval_open_wo(self->cached_ledreset, path->ledreset))
   {
     goto cleanup;
   }
@@ -139,7 +148,14 @@ led_channel_bacon_probe(led_channel_bacon_t *self,
 
 cleanup:
 
-  if( !res ) led_channel_bacon_close(self);
+  if( !res )
+  {
+    sysfsval_close(self->cached_brightness);
+    sysfsval_close(self->cached_grpfreq);
+    sysfsval_close(self->cached_grppwm);
+    sysfsval_close(self->cached_blink);
+    sysfsval_close(self->cached_ledreset);
+  }
 
   return res;
 }
@@ -156,8 +172,20 @@ led_control_bacon_enable_cb(void *data, bool enable)
   const led_channel_bacon_t *channel = data;
   mce_log(LL_INFO, "led_control_bacon_enable_cb(%d)", enable);
 
-  if(!enable)
-    dprintf(channel->fd_ledreset, "%d", 1);
+  if( !enable ) {
+    /* Reset is an action rather than a state: always write it,
+     * and assume it clears the group blink configuration and
+     * turns off all the channels */
+    sysfsval_invalidate(channel->cached_ledreset);
+    sysfsval_set(channel->cached_ledreset, 1);
+
+    sysfsval_invalidate(channel->cached_grpfreq);
+    sysfsval_invalidate(channel->cached_grppwm);
+    sysfsval_invalidate(channel->cached_blink);
+
+    for( size_t i = 0; i < BACON_CHANNELS; ++i )
+      sysfsval_invalidate(channel[i].cached_brightness);
+  }
 }
 
 static void
@@ -190,10 +218,10 @@ led_control_bacon_blink_cb(void *data, int on_ms, int off_ms)
   }
 
   if( channel->blink ) {
-    dprintf(channel->fd_grpfreq, "%d", channel->freq);
-    dprintf(channel->fd_grppwm, "%d", channel->pwm);
+    sysfsval_set(channel->cached_grpfreq, channel->freq);
+    sysfsval_set(channel->cached_grppwm, channel->pwm);
   }
-  dprintf(channel->fd_blink, "%d", channel->blink);
+  sysfsval_set(channel->cached_blink, channel->blink);
 }
 
 static void
@@ -202,24 +230,24 @@ led_control_bacon_value_cb(void *data, int r, int g, int b)
   led_channel_bacon_t *channel = data;
 
   mce_log(LL_INFO, "led_control_bacon_value_cb(%d,%d,%d), blink=%d", r, g, b, channel->blink);
-  if( channel->blink )
-    dprintf(channel->fd_ledreset, "%d", 0);
 
-  (channel+0)->brightness = led_util_scale_value(r, (channel+0)->maxval);
-  (channel+1)->brightness = led_util_scale_value(g, (channel+1)->maxval);
-  (channel+2)->brightness = led_util_scale_value(b, (channel+2)->maxval);
+  if( channel->blink )
+    sysfsval_set(channel->cached_ledreset, 0);
 
-  dprintf((channel+0)->fd_brightness, "%d", (channel+0)->brightness);
-  dprintf((channel+1)->fd_brightness, "%d", (channel+1)->brightness);
-  dprintf((channel+2)->fd_brightness, "%d", (channel+2)->brightness);
+  sysfsval_set((channel+0)->cached_brightness,
+               led_util_scale_value(r, (channel+0)->maxval));
+  sysfsval_set((channel+1)->cached_brightness,
+               led_util_scale_value(g, (channel+1)->maxval));
+  sysfsval_set((channel+2)->cached_brightness,
+               led_util_scale_value(b, (channel+2)->maxval));
 
   if( channel->blink ) {
     // need to reset the blink when changing color (do we?)
-    dprintf(channel->fd_grpfreq, "%d", channel->freq); // 1s
-    dprintf(channel->fd_grppwm, "%d", channel->pwm); // 50%?
-    dprintf(channel->fd_blink, "%d", 1);
+    sysfsval_set(channel->cached_grpfreq, channel->freq); // 1s
+    sysfsval_set(channel->cached_grppwm, channel->pwm); // 50%?
+    sysfsval_set(channel->cached_blink, 1);
   } else
-    dprintf(channel->fd_blink, "%d", 0);
+    sysfsval_set(channel->cached_blink, 0);
 }
 
 static void
@@ -229,6 +257,7 @@ led_control_bacon_close_cb(void *data)
   led_channel_bacon_close(channel + 0);
   led_channel_bacon_close(channel + 1);
   led_channel_bacon_close(channel + 2);
+  free(channel);
 }
 
 static bool
@@ -334,7 +363,10 @@ bool
 led_control_bacon_probe(led_control_t *self)
 {
 
-  static led_channel_bacon_t channel[BACON_CHANNELS];
+  led_channel_bacon_t *channel = calloc(BACON_CHANNELS, sizeof *channel);
+
+  if( !channel )
+    return false;
 
   bool res = false;
 
@@ -355,7 +387,7 @@ led_control_bacon_probe(led_control_t *self)
   if( self->use_config )
     res = led_control_bacon_dynamic_probe(channel);
 
-  if( !res )
+  if( !res && !self->config_only )
     res = led_control_bacon_static_probe(channel);
 
   if( !res )
@@ -39,6 +39,7 @@
 #include "plugin-config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -171,6 +172,7 @@ led_control_binary_close_cb(void *data)
 {
     led_channel_binary_t *channel = data;
     led_channel_binary_close(channel + 0);
+    free(channel);
 }
 
 static bool
@@ -264,7 +266,10 @@ cleanup:
 bool
 led_control_binary_probe(led_control_t *self)
 {
-    static led_channel_binary_t channel[BINARY_CHANNELS];
+    led_channel_binary_t *channel = calloc(BINARY_CHANNELS, sizeof *channel);
+
+    if( !channel )
+        return false;
 
     bool res = false;
 
@@ -281,10 +286,13 @@ led_control_binary_probe(led_control_t *self)
     self->can_breathe = true;
     self->breath_type = LED_RAMP_HARD_STEP;
 
+    /* Brightness changes do not need kernel settle time */
+    self->settle_type = LED_SETTLE_NONE;
+
     if( self->use_config )
         res = led_control_binary_dynamic_probe(channel);
 
-    if( !res )
+    if( !res && !self->config_only )
         res = led_control_binary_static_probe(channel);
 
     if( !res )
@@ -0,0 +1,357 @@
+/** @file sysfs-led-colormap.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Color mapping for leds with reduced set of channels
+ *
+ * Each led channel is described by the rgb color it produces at full
+ * brightness - from built-in defaults or from <Channel>Color ini keys
+ * in the led config group. At probe time a lookup table is built that
+ * gives the channel weights that best reproduce each requested color
+ * in linear light, so that mapping on breathing steps is just a table
+ * lookup.
+ *
+ * The table is indexed by hue only, i.e. the dominant rgb component is
+ * used as intensity and the weights are scaled by it. This way dimming
+ * a color during breathing does not cause hue jumps, and all non-zero
+ * intensity levels remain available.
+ * ========================================================================= */
+
+#include "sysfs-led-colormap.h"
+
+#include "plugin-config.h"
+#include "plugin-logging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Gamma used for converting rgb values to linear light */
+#define LED_COLORMAP_GAMMA 2.2f
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+static float led_colormap_linear   (int value);
+static bool  led_colormap_config   (const char *name, int *rgb);
+static bool  led_colormap_solve    (size_t n, const float (*prim)[3], const float *col, unsigned mask, float *w, float *err);
+static void  led_colormap_weights  (size_t n, const float (*prim)[3], const float *col, bool exclusive, float *w);
+void         led_colormap_init     (led_colormap_t *self, size_t channels, const char * const *names, const int (*defaults)[3], bool exclusive);
+void         led_colormap_map      (const led_colormap_t *self, int r, int g, int b, int *out);
+
+/* ========================================================================= *
+ * FUNCTIONS
+ * ========================================================================= */
+
+/** Convert rgb component value to linear light
+ *
+ * @param value component value [0 ... 255]
+ *
+ * @return linear light value [0 ... 1]
+ */
+static float
+led_colormap_linear(int value)
+{
+    return powf(value / 255.0f, LED_COLORMAP_GAMMA);
+}
+
+/** Get channel color from configuration
+ *
+ * @param name channel name, e.g. "Amber" for AmberColor key
+ * @param rgb  where to store the color
+ *
+ * @return true if valid color was configured, false otherwise
+ */
+static bool
+led_colormap_config(const char *name, int *rgb)
+{
+    bool   ack = false;
+    gchar *key = g_strdup_printf("%sColor", name);
+    gchar *val = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                          key, 0);
+    int    r, g, b;
+
+    if( !val )
+        goto cleanup;
+
+    if( sscanf(val, "%d,%d,%d", &r, &g, &b) != 3 ||
+        r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255 ||
+        r + g + b == 0 ) {
+        mce_log(LL_WARN, "%s: invalid color: %s", key, val);
+        goto cleanup;
+    }
+
+    rgb[0] = r, rgb[1] = g, rgb[2] = b;
+    ack = true;
+
+cleanup:
+    g_free(val);
+    g_free(key);
+
+    return ack;
+}
+
+/** Least squares fit using a subset of channels
+ *
+ * @param n    number of channels
+ * @param prim channel colors in linear light
+ * @param col  requested color in linear light
+ * @param mask bitmask of channels to use
+ * @param w    where to store channel weights
+ * @param err  where to store squared error
+ *
+ * @return true if a solution with non-negative weights was found
+ */
+static bool
+led_colormap_solve(size_t n, const float (*prim)[3], const float *col,
+                   unsigned mask, float *w, float *err)
+{
+    size_t idx[LED_COLORMAP_MAX_CHANNELS];
+    size_t k = 0;
+
+    for( size_t i = 0; i < n; ++i ) {
+        w[i] = 0.0f;
+        if( mask & (1u << i) )
+            idx[k++] = i;
+    }
+
+    /* Normal equations: augmented k x (k+1) matrix */
+    float a[LED_COLORMAP_MAX_CHANNELS][LED_COLORMAP_MAX_CHANNELS + 1];
+
+    for( size_t i = 0; i < k; ++i ) {
+        for( size_t j = 0; j < k; ++j ) {
+            a[i][j] = 0.0f;
+            for( size_t c = 0; c < 3; ++c )
+                a[i][j] += prim[idx[i]][c] * prim[idx[j]][c];
+        }
+        a[i][k] = 0.0f;
+        for( size_t c = 0; c < 3; ++c )
+            a[i][k] += prim[idx[i]][c] * col[c];
+    }
+
+    /* Gauss-Jordan elimination with partial pivoting */
+    for( size_t i = 0; i < k; ++i ) {
+        size_t p = i;
+        for( size_t j = i + 1; j < k; ++j ) {
+            if( fabsf(a[j][i]) > fabsf(a[p][i]) )
+                p = j;
+        }
+        if( fabsf(a[p][i]) < 1e-6f )
+            return false;
+
+        for( size_t j = 0; j <= k; ++j ) {
+            float t = a[i][j]; a[i][j] = a[p][j]; a[p][j] = t;
+        }
+
+        for( size_t j = 0; j < k; ++j ) {
+            if( j == i )
+                continue;
+            float f = a[j][i] / a[i][i];
+            for( size_t c = i; c <= k; ++c )
+                a[j][c] -= f * a[i][c];
+        }
+    }
+
+    for( size_t i = 0; i < k; ++i ) {
+        float v = a[i][k] / a[i][i];
+        if( v < 0.0f )
+            return false;
+        w[idx[i]] = v;
+    }
+
+    *err = 0.0f;
+    for( size_t c = 0; c < 3; ++c ) {
+        float d = col[c];
+        for( size_t i = 0; i < n; ++i )
+            d -= w[i] * prim[i][c];
+        *err += d * d;
+    }
+
+    return true;
+}
+
+/** Evaluate channel weights that best reproduce a color
+ *
+ * The weights are normalized so that the strongest channel is
+ * driven at full brightness.
+ *
+ * @param n         number of channels
+ * @param prim      channel colors in linear light
+ * @param col       requested color in linear light
+ * @param exclusive true if only one channel can be lit at a time
+ * @param w         where to store channel weights [0 ... 1]
+ */
+static void
+led_colormap_weights(size_t n, const float (*prim)[3], const float *col,
+                     bool exclusive, float *w)
+{
+    for( size_t i = 0; i < n; ++i )
+        w[i] = 0.0f;
+
+    if( exclusive ) {
+        /* Choose the channel closest in hue */
+        size_t best = 0;
+        float  cos_best = 0.0f;
+
+        for( size_t i = 0; i < n; ++i ) {
+            float dot = 0.0f, len = 0.0f;
+            for( size_t c = 0; c < 3; ++c ) {
+                dot += prim[i][c] * col[c];
+                len += prim[i][c] * prim[i][c];
+            }
+            float cos_i = dot / sqrtf(len);
+            if( cos_best < cos_i )
+                best = i, cos_best = cos_i;
+        }
+        w[best] = 1.0f;
+        return;
+    }
+
+    /* Non-negative least squares: try all channel subsets */
+    float best_err = INFINITY;
+
+    for( unsigned mask = 1; mask < (1u << n); ++mask ) {
+        float tmp[LED_COLORMAP_MAX_CHANNELS];
+        float err;
+
+        if( !led_colormap_solve(n, prim, col, mask, tmp, &err) )
+            continue;
+
+        if( err < best_err ) {
+            best_err = err;
+            memcpy(w, tmp, n * sizeof *w);
+        }
+    }
+
+    float top = 0.0f;
+    for( size_t i = 0; i < n; ++i ) {
+        if( top < w[i] )
+            top = w[i];
+    }
+
+    /* Colors that none of the channels can reproduce, e.g. blue on
+     * red/green led, must not turn the led off -> use all channels */
+    for( size_t i = 0; i < n; ++i )
+        w[i] = (top > 1e-4f) ? w[i] / top : 1.0f;
+}
+
+/** Build color mapping lookup table
+ *
+ * @param self      color map to initialize
+ * @param channels  number of led channels
+ * @param names     channel names used in ini keys
+ * @param defaults  channel colors to use when not configured
+ * @param exclusive true if only one channel can be lit at a time
+ */
+void
+led_colormap_init(led_colormap_t *self, size_t channels,
+                  const char * const *names, const int (*defaults)[3],
+                  bool exclusive)
+{
+    float prim[LED_COLORMAP_MAX_CHANNELS][3];
+
+    if( channels > LED_COLORMAP_MAX_CHANNELS )
+        channels = LED_COLORMAP_MAX_CHANNELS;
+
+    self->channels = channels;
+
+    for( size_t i = 0; i < channels; ++i ) {
+        int rgb[3] = { defaults[i][0], defaults[i][1], defaults[i][2] };
+
+        led_colormap_config(names[i], rgb);
+
+        mce_log(LL_DEBUG, "%s: color = %d,%d,%d", names[i],
+                rgb[0], rgb[1], rgb[2]);
+
+        for( size_t c = 0; c < 3; ++c )
+            prim[i][c] = led_colormap_linear(rgb[c]);
+    }
+
+    const int s = LED_COLORMAP_STEPS;
+
+    for( int dom = 0; dom < 3; ++dom ) {
+        for( int q1 = 0; q1 < s; ++q1 ) {
+            for( int q2 = 0; q2 < s; ++q2 ) {
+                /* Full intensity color: dominant component at max,
+                 * the other two in rgb order */
+                int rgb[3];
+                rgb[dom]           = 255;
+                rgb[(dom + 1) % 3] = q1 * 255 / (s - 1);
+                rgb[(dom + 2) % 3] = q2 * 255 / (s - 1);
+
+                float col[3];
+                for( size_t c = 0; c < 3; ++c )
+                    col[c] = led_colormap_linear(rgb[c]);
+
+                float w[LED_COLORMAP_MAX_CHANNELS];
+                led_colormap_weights(channels, prim, col, exclusive, w);
+
+                uint8_t *entry = self->lut[(dom * s + q1) * s + q2];
+                for( size_t i = 0; i < channels; ++i )
+                    entry[i] = (uint8_t)(w[i] * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+/** Map requested rgb color to led channel values
+ *
+ * @param self color map
+ * @param r    red component [0 ... 255]
+ * @param g    green component [0 ... 255]
+ * @param b    blue component [0 ... 255]
+ * @param out  where to store channel values [0 ... 255]
+ */
+void
+led_colormap_map(const led_colormap_t *self, int r, int g, int b, int *out)
+{
+    int rgb[3] = { r, g, b };
+    int dom    = 0;
+
+    if( rgb[dom] < rgb[1] ) dom = 1;
+    if( rgb[dom] < rgb[2] ) dom = 2;
+
+    int top = rgb[dom];
+
+    if( top <= 0 ) {
+        for( size_t i = 0; i < self->channels; ++i )
+            out[i] = 0;
+        return;
+    }
+
+    const int s  = LED_COLORMAP_STEPS;
+    int       q1 = (rgb[(dom + 1) % 3] * (s - 1) + top / 2) / top;
+    int       q2 = (rgb[(dom + 2) % 3] * (s - 1) + top / 2) / top;
+
+    const uint8_t *entry = self->lut[(dom * s + q1) * s + q2];
+
+    for( size_t i = 0; i < self->channels; ++i )
+        out[i] = (entry[i] * top + 127) / 255;
+}
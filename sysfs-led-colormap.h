@@ -0,0 +1,63 @@
+/** @file sysfs-led-colormap.h
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef  SYSFS_LED_COLORMAP_H_
+# define SYSFS_LED_COLORMAP_H_
+
+# include <stdbool.h>
+# include <stddef.h>
+# include <stdint.h>
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Maximum number of led channels a color map can drive */
+# define LED_COLORMAP_MAX_CHANNELS 3
+
+/** Number of quantization steps used for non-dominant rgb components */
+# define LED_COLORMAP_STEPS 32
+
+/** Mapping from requested rgb colors to reduced set of led channels
+ */
+typedef struct
+{
+    /** Number of led channels in use */
+    size_t  channels;
+
+    /** Channel weights [0 ... 255] for full intensity colors, indexed
+     *  by dominant rgb component and the two other components */
+    uint8_t lut[3 * LED_COLORMAP_STEPS * LED_COLORMAP_STEPS][LED_COLORMAP_MAX_CHANNELS];
+} led_colormap_t;
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+void led_colormap_init(led_colormap_t *self, size_t channels,
+                       const char * const *names, const int (*defaults)[3],
+                       bool exclusive);
+void led_colormap_map (const led_colormap_t *self, int r, int g, int b,
+                       int *out);
+
+#endif /* SYSFS_LED_COLORMAP_H_ */
@@ -40,6 +40,7 @@
 #include "plugin-config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -189,8 +190,7 @@ led_channel_f5121_set_value(led_channel_f5121_t *self,
      * Note that upper level state machine logic + caching of the
      * assumed sysfs values means that these transitions are done in
      * 3 steps (cancel previous mode, reset to black, switch to new
-     * mode) with pproximately SYSFS_LED_KERNEL_DELAY ms in between
-     * the steps.
+     * mode) with the backend settle time in between the steps.
      */
     if( self->control_blink ) {
         sysfsval_set(self->cached_brightness, 0);
@@ -245,6 +245,7 @@ led_control_f5121_close_cb(void *data)
     led_channel_f5121_close(channel + 0);
     led_channel_f5121_close(channel + 1);
     led_channel_f5121_close(channel + 2);
+    free(channel);
 }
 
 static bool
@@ -351,7 +352,10 @@ cleanup:
 bool
 led_control_f5121_probe(led_control_t *self)
 {
-    static led_channel_f5121_t channel[F5121_CHANNELS];
+    led_channel_f5121_t *channel = calloc(F5121_CHANNELS, sizeof *channel);
+
+    if( !channel )
+        return false;
 
     bool ack = false;
 
@@ -369,10 +373,13 @@ led_control_f5121_probe(led_control_t *self)
     /* Prefer to use the built-in soft-blinking */
     self->can_breathe = false;
 
+    /* Mode switches need settle time, intensity changes do not */
+    self->settle_type = LED_SETTLE_BLINK;
+
     if( self->use_config )
         ack = led_control_f5121_dynamic_probe(channel);
 
-    if( !ack )
+    if( !ack && !self->config_only )
         ack = led_control_f5121_static_probe(channel);
 
     if( !ack )
@@ -34,16 +34,17 @@
  * - Blinking is always soft, handled by kernel driver / hw.
  * - The sysfs writes will block until change is finished -> Intensity
  *   changes are slow. Breathing from userspace can't be used as it
- *   would constantly block mce mainloop.
+ *   would constantly block mce mainloop - unless led writer thread
+ *   is enabled via QuirkWriterThread setting.
  * ========================================================================= */
 
 #include "sysfs-led-hammerhead.h"
 
 #include "sysfs-led-util.h"
+#include "sysfs-val.h"
 #include "plugin-config.h"
 
-#include <stdio.h>
-#include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -62,10 +63,10 @@ typedef struct
 
 typedef struct
 {
-  int cached_max_brightness;
-  int fd_brightness;
-  int fd_on_off_ms;
-  int fd_rgb_start;
+  sysfsval_t *cached_max_brightness;
+  sysfsval_t *cached_brightness;
+  sysfsval_t *cached_on_off_ms;
+  sysfsval_t *cached_rgb_start;
 } led_channel_hammerhead_t;
 
 /* ------------------------------------------------------------------------- *
@@ -97,18 +98,26 @@ bool               led_control_hammerhead_probe      (led_control_t *self);
 static void
 led_channel_hammerhead_init(led_channel_hammerhead_t *self)
 {
-  self->cached_max_brightness = -1;
-  self->fd_brightness         = -1;
-  self->fd_on_off_ms          = -1;
-  self->fd_rgb_start          = -1;
+  self->cached_max_brightness = sysfsval_create();
+  self->cached_brightness     = sysfsval_create();
+  self->cached_on_off_ms      = sysfsval_create();
+  self->cached_rgb_start      = sysfsval_create();
 }
 
 static void
 led_channel_hammerhead_close(led_channel_hammerhead_t *self)
 {
-  led_util_close_file(&self->fd_brightness);
-  led_util_close_file(&self->fd_on_off_ms);
-  led_util_close_file(&self->fd_rgb_start);
+  sysfsval_delete(self->cached_max_brightness),
+    self->cached_max_brightness = 0;
+
+  sysfsval_delete(self->cached_brightness),
+    self->cached_brightness = 0;
+
+  sysfsval_delete(self->cached_on_off_ms),
+    self->cached_on_off_ms = 0;
+
+  sysfsval_delete(self->cached_rgb_start),
+    self->cached_rgb_start = 0;
 }
 
 static bool
@@ -117,16 +126,17 @@ led_channel_hammerhead_probe(led_channel_hammerhead_t *self,
 {
   bool res = false;
 
-  led_channel_hammerhead_close(self);
+  if( !sysfsval_open_ro(self->cached_max_brightness, path->max_brightness) )
+    goto cleanup;
 
-  if( (self->cached_max_brightness = led_util_read_number(path->max_brightness)) <= 0 )
-  {
+  sysfsval_refresh(self->cached_max_brightness);
+
+  if( sysfsval_get(self->cached_max_brightness) <= 0 )
     goto cleanup;
-  }
 
-  if( !led_util_open_file(&self->fd_brightness,    path->brightness)    ||
-      !led_util_open_file(&self->fd_on_off_ms, path->on_off_ms) ||
-      !led_util_open_file(&self->fd_rgb_start, path->rgb_start) )
+  if( !sysfsval_open_wo(self->cached_brightness, path->brightness) ||
+      !sysfsval_open_wo(self->cached_on_off_ms,  path->on_off_ms)  ||
+      !sysfsval_open_wo(self->cached_rgb_start,  path->rgb_start) )
   {
     goto cleanup;
   }
@@ -135,7 +145,16 @@ led_channel_hammerhead_probe(led_channel_hammerhead_t *self,
 
 cleanup:
 
-  if( !res ) led_channel_hammerhead_close(self);
+  /* Always close the max_brightness file */
+  sysfsval_close(self->cached_max_brightness);
+
+  /* On failure close the other files too */
+  if( !res )
+  {
+    sysfsval_close(self->cached_brightness);
+    sysfsval_close(self->cached_on_off_ms);
+    sysfsval_close(self->cached_rgb_start);
+  }
 
   return res;
 }
@@ -144,37 +163,23 @@ static void
 led_channel_hammerhead_set_enabled(const led_channel_hammerhead_t *self,
                                    bool enable)
 {
-  if( self->fd_rgb_start != -1 )
-  {
-    dprintf(self->fd_rgb_start, "%d", enable);
-  }
+  sysfsval_set(self->cached_rgb_start, enable);
 }
 
 static void
 led_channel_hammerhead_set_value(const led_channel_hammerhead_t *self,
                                  int value)
 {
-  if( self->fd_brightness != -1 )
-  {
-    dprintf(self->fd_brightness, "%d", led_util_scale_value(value, self->cached_max_brightness));
-  }
+  value = led_util_scale_value(value,
+                               sysfsval_get(self->cached_max_brightness));
+  sysfsval_set(self->cached_brightness, value);
 }
 
 static void
 led_channel_hammerhead_set_blink(const led_channel_hammerhead_t *self,
                                  int on_ms, int off_ms)
 {
-  if( self->fd_on_off_ms != -1 )
-  {
-    char tmp[32];
-    int len = snprintf(tmp, sizeof tmp, "%d %d", on_ms, off_ms);
-    if( len > 0 && len <= (int)sizeof tmp )
-    {
-      if( write(self->fd_on_off_ms, tmp, len) < 0 ) {
-        // dontcare, keep compiler from complaining too
-      }
-    }
-  }
+  sysfsval_set_pair(self->cached_on_off_ms, on_ms, off_ms);
 }
 
 /* ========================================================================= *
@@ -217,6 +222,7 @@ led_control_hammerhead_close_cb(void *data)
   led_channel_hammerhead_close(channel + 0);
   led_channel_hammerhead_close(channel + 1);
   led_channel_hammerhead_close(channel + 2);
+  free(channel);
 }
 
 static bool
@@ -311,7 +317,10 @@ bool
 led_control_hammerhead_probe(led_control_t *self)
 {
 
-  static led_channel_hammerhead_t channel[HAMMERHEAD_CHANNELS];
+  led_channel_hammerhead_t *channel = calloc(HAMMERHEAD_CHANNELS, sizeof *channel);
+
+  if( !channel )
+    return false;
 
   bool ack = false;
 
@@ -327,13 +336,15 @@ led_control_hammerhead_probe(led_control_t *self)
   self->close  = led_control_hammerhead_close_cb;
 
   /* Changing led parameters is so slow and consumes so much
-   * cpu cycles that we just can't have breathing available */
+   * cpu cycles that we just can't have breathing available
+   * unless the writes are made from a worker thread */
   self->can_breathe = false;
+  self->blocking    = true;
 
   if( self->use_config )
     ack = led_control_hammerhead_dynamic_probe(channel);
 
-  if( !ack )
+  if( !ack && !self->config_only )
     ack = led_control_hammerhead_static_probe(channel);
 
   if( !ack )
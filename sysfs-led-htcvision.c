@@ -32,16 +32,18 @@
  * Assumptions built into code:
  * - while there are two channels, kernel and/or hw only allows one of them
  *   to be active -> Map rgb form request from mce to amber/green and try
- *   to minimize color error.
+ *   to minimize color error, see sysfs-led-colormap.c
  * ========================================================================= */
 
 #include "sysfs-led-htcvision.h"
 
 #include "sysfs-led-util.h"
+#include "sysfs-led-colormap.h"
 #include "sysfs-val.h"
 #include "plugin-config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -64,6 +66,14 @@ typedef struct
   sysfsval_t * cached_blink;
 } led_channel_htcvision_t;
 
+#define HTCVISION_CHANNELS 2
+
+typedef struct
+{
+  led_channel_htcvision_t channel[HTCVISION_CHANNELS];
+  led_colormap_t          colormap;
+} led_data_htcvision_t;
+
 /* ------------------------------------------------------------------------- *
  * ONE_CHANNEL
  * ------------------------------------------------------------------------- */
@@ -78,7 +88,6 @@ static void        led_channel_htcvision_set_blink   (const led_channel_htcvisio
  * ALL_CHANNELS
  * ------------------------------------------------------------------------- */
 
-static void        led_control_htcvision_map_color   (int r, int g, int b, int *amber, int *green);
 static void        led_control_htcvision_blink_cb    (void *data, int on_ms, int off_ms);
 static void        led_control_htcvision_value_cb    (void *data, int r, int g, int b);
 static void        led_control_htcvision_close_cb    (void *data);
@@ -163,39 +172,11 @@ led_channel_htcvision_set_blink(const led_channel_htcvision_t *self, int blink)
  * ALL_CHANNELS
  * ========================================================================= */
 
-#define HTCVISION_CHANNELS 2
-
-static void
-led_control_htcvision_map_color(int r, int g, int b,
-                                int *amber, int *green)
-{
-  /* Only "amber" or "green" color can be used.
-   *
-   * Assume amber = r:ff g:7f b:00
-   *        green = r:00 g:ff b:00
-   *
-   * Try to choose the one with smaller delta to the
-   * requested rgb color by using the 'r':'g' ratio.
-   *
-   * The 'b' is used for intensity preservation only.
-   */
-
-  if( r * 3 < g * 4)
-  {
-    *amber = 0;
-    *green = (g > b) ? g : b;
-  }
-  else
-  {
-    *amber = (r > b) ? r : b;
-    *green = 0;
-  }
-}
-
 static void
 led_control_htcvision_blink_cb(void *data, int on_ms, int off_ms)
 {
-  const led_channel_htcvision_t *channel = data;
+  const led_data_htcvision_t    *self    = data;
+  const led_channel_htcvision_t *channel = self->channel;
 
   int blink = (on_ms && off_ms);
 
@@ -206,22 +187,25 @@ led_control_htcvision_blink_cb(void *data, int on_ms, int off_ms)
 static void
 led_control_htcvision_value_cb(void *data, int r, int g, int b)
 {
-  const led_channel_htcvision_t *channel = data;
+  const led_data_htcvision_t    *self    = data;
+  const led_channel_htcvision_t *channel = self->channel;
 
-  int amber = 0;
-  int green = 0;
-  led_control_htcvision_map_color(r, g, b, &amber, &green);
+  /* Only "amber" or "green" color can be used at a time */
+  int value[HTCVISION_CHANNELS];
+  led_colormap_map(&self->colormap, r, g, b, value);
 
-  led_channel_htcvision_set_value(channel + 0, amber);
-  led_channel_htcvision_set_value(channel + 1, green);
+  led_channel_htcvision_set_value(channel + 0, value[0]);
+  led_channel_htcvision_set_value(channel + 1, value[1]);
 }
 
 static void
 led_control_htcvision_close_cb(void *data)
 {
-  led_channel_htcvision_t *channel = data;
+  led_data_htcvision_t    *self    = data;
+  led_channel_htcvision_t *channel = self->channel;
   led_channel_htcvision_close(channel + 0);
   led_channel_htcvision_close(channel + 1);
+  free(self);
 }
 
 static bool
@@ -305,8 +289,12 @@ cleanup:
 bool
 led_control_htcvision_probe(led_control_t *self)
 {
+  led_data_htcvision_t *data = calloc(1, sizeof *data);
+
+  if( !data )
+    return false;
 
-  static led_channel_htcvision_t channel[HTCVISION_CHANNELS];
+  led_channel_htcvision_t *channel = data->channel;
 
   bool ack = false;
 
@@ -314,7 +302,7 @@ led_control_htcvision_probe(led_control_t *self)
   led_channel_htcvision_init(channel+1);
 
   self->name   = "htcvision";
-  self->data   = channel;
+  self->data   = data;
   self->enable = 0;
   self->blink  = led_control_htcvision_blink_cb;
   self->value  = led_control_htcvision_value_cb;
@@ -323,14 +311,32 @@ led_control_htcvision_probe(led_control_t *self)
   /* TODO: check if breathing can be left enabled */
   self->can_breathe = true;
 
+  /* Settle time is needed only after blink changes */
+  self->settle_type = LED_SETTLE_BLINK;
+
   if( self->use_config )
     ack = led_control_htcvision_dynamic_probe(channel);
 
-  if( !ack )
+  if( !ack && !self->config_only )
     ack = led_control_htcvision_static_probe(channel);
 
-  if( !ack )
+  if( ack ) {
+    /* Assume amber = r:ff g:7f b:00
+     *        green = r:00 g:ff b:00 */
+    static const char * const names[HTCVISION_CHANNELS] =
+    {
+      "Amber", "Green"
+    };
+    static const int colors[HTCVISION_CHANNELS][3] =
+    {
+      { 255, 127, 0 }, { 0, 255, 0 }
+    };
+    led_colormap_init(&data->colormap, HTCVISION_CHANNELS,
+                      names, colors, true);
+  }
+  else {
     led_control_close(self);
+  }
 
   return ack;
 }
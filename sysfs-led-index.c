@@ -0,0 +1,239 @@
+/** @file sysfs-led-index.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Index of led class sysfs entries
+ *
+ * Backend probing tries a number of hard coded paths, most of which
+ * do not exist on any given device. Instead of making failing open()
+ * calls for each of them, the led class directory - plus attributes
+ * of each led and its parent device - is scanned once and the probe
+ * time opens then consult the index first.
+ *
+ * The index is conservative: paths that are not within scanned
+ * directories are always assumed to exist, i.e. opening them
+ * is attempted normally.
+ * ========================================================================= */
+
+#include "sysfs-led-index.h"
+#include "sysfs-led-util.h"
+
+#include "plugin-logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Led class directory */
+#define SYSFS_LED_INDEX_ROOT "/sys/class/leds"
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+static DIR *sysfs_led_index_open  (const char *dir);
+static bool sysfs_led_index_scan  (const char *dir);
+void        sysfs_led_index_init  (void);
+void        sysfs_led_index_quit  (void);
+bool        sysfs_led_index_exists(const char *path);
+
+/* ========================================================================= *
+ * STATE
+ * ========================================================================= */
+
+/** Paths of all entries found in scanned directories */
+static GHashTable *sysfs_led_index_entries = 0;
+
+/** Paths of directories that have been scanned */
+static GHashTable *sysfs_led_index_scanned = 0;
+
+/* ========================================================================= *
+ * FUNCTIONS
+ * ========================================================================= */
+
+/** Open directory via possibly redirected sysfs root
+ *
+ * @param dir directory path
+ *
+ * @return directory handle, or NULL on failure
+ */
+static DIR *
+sysfs_led_index_open(const char *dir)
+{
+    char *real = led_util_root_path(dir);
+    DIR  *dh   = real ? opendir(real) : 0;
+
+    free(real);
+
+    return dh;
+}
+
+/** Add entries of one directory to the index
+ *
+ * Paths stored in the index refer to real sysfs, even when
+ * sysfs root has been redirected.
+ *
+ * @param dir directory path
+ *
+ * @return true if directory was scanned, false otherwise
+ */
+static bool
+sysfs_led_index_scan(const char *dir)
+{
+    DIR *dh = sysfs_led_index_open(dir);
+
+    if( !dh )
+        return false;
+
+    struct dirent *de;
+
+    while( (de = readdir(dh)) ) {
+        gchar *path = g_strdup_printf("%s/%s", dir, de->d_name);
+        g_hash_table_replace(sysfs_led_index_entries, path, path);
+    }
+
+    closedir(dh);
+
+    gchar *path = g_strdup(dir);
+    g_hash_table_replace(sysfs_led_index_scanned, path, path);
+
+    return true;
+}
+
+/** Build led class sysfs index
+ *
+ * Scans the led class directory, attribute files of each led and
+ * attribute files of the device each led belongs to.
+ */
+void
+sysfs_led_index_init(void)
+{
+    DIR *dh = 0;
+
+    sysfs_led_index_quit();
+
+    sysfs_led_index_entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, 0);
+    sysfs_led_index_scanned = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, 0);
+
+    if( !sysfs_led_index_scan(SYSFS_LED_INDEX_ROOT) )
+        goto EXIT;
+
+    if( !(dh = sysfs_led_index_open(SYSFS_LED_INDEX_ROOT)) )
+        goto EXIT;
+
+    struct dirent *de;
+
+    while( (de = readdir(dh)) ) {
+        if( de->d_name[0] == '.' )
+            continue;
+
+        gchar *led = g_strdup_printf("%s/%s", SYSFS_LED_INDEX_ROOT,
+                                     de->d_name);
+        if( sysfs_led_index_scan(led) ) {
+            gchar *dev = g_strdup_printf("%s/device", led);
+            sysfs_led_index_scan(dev);
+            g_free(dev);
+        }
+        g_free(led);
+    }
+
+EXIT:
+    if( dh )
+        closedir(dh);
+
+    mce_log(LOG_DEBUG, "indexed %u entries in %u directories",
+            g_hash_table_size(sysfs_led_index_entries),
+            g_hash_table_size(sysfs_led_index_scanned));
+}
+
+/** Release led class sysfs index
+ *
+ * After this all paths are assumed to exist.
+ */
+void
+sysfs_led_index_quit(void)
+{
+    if( sysfs_led_index_entries )
+        g_hash_table_unref(sysfs_led_index_entries),
+            sysfs_led_index_entries = 0;
+
+    if( sysfs_led_index_scanned )
+        g_hash_table_unref(sysfs_led_index_scanned),
+            sysfs_led_index_scanned = 0;
+}
+
+/** Check whether a path might exist
+ *
+ * Each parent directory of the path that has been scanned
+ * must contain the next path component.
+ *
+ * @param path file path
+ *
+ * @return false if path is known not to exist, true otherwise
+ */
+bool
+sysfs_led_index_exists(const char *path)
+{
+    bool   exists = true;
+    gchar *work   = 0;
+
+    if( !path || !sysfs_led_index_scanned )
+        goto EXIT;
+
+    work = g_strdup(path);
+
+    for( char *sep = strchr(work + 1, '/'); sep; sep = strchr(sep + 1, '/') ) {
+        *sep = 0;
+        bool scanned = g_hash_table_lookup(sysfs_led_index_scanned, work);
+        *sep = '/';
+
+        if( !scanned )
+            continue;
+
+        /* Terminate at the component following the directory */
+        char *end = strchr(sep + 1, '/');
+        if( end )
+            *end = 0;
+
+        exists = g_hash_table_lookup(sysfs_led_index_entries, work);
+
+        if( end )
+            *end = '/';
+
+        if( !exists )
+            break;
+    }
+
+EXIT:
+    g_free(work);
+
+    return exists;
+}
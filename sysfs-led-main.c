@@ -32,16 +32,24 @@
 #include "sysfs-led-binary.h"
 #include "sysfs-led-redgreen.h"
 #include "sysfs-led-white.h"
+#include "sysfs-led-multicolor.h"
+#include "sysfs-led-writer.h"
+#include "sysfs-led-index.h"
+#include "sysfs-led-uevent.h"
+#include "sysfs-led-timer.h"
+#include "sysfs-val.h"
 
 #include "plugin-logging.h"
 #include "plugin-config.h"
 #include "plugin-quirks.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include <glib.h>
 
@@ -49,18 +57,85 @@
  * CONSTANTS
  * ========================================================================= */
 
-/** Questimate of the duration of the kernel delayed work */
+/** Questimate of the duration of the kernel delayed work
+ *
+ * Used as settle time for backends that do not define their own.
+ */
 #define SYSFS_LED_KERNEL_DELAY 10 // [ms]
 
-/** Minimum delay between breathing steps */
+/** Default minimum delay between breathing steps */
 #define SYSFS_LED_STEP_DELAY 50 // [ms]
 
-/** Maximum number of breathing steps; rise and fall time combined */
+/** Default maximum number of breathing steps; rise and fall time combined */
 #define SYSFS_LED_MAX_STEPS 256
 
+/** Lower limit for calibrated minimum delay between breathing steps */
+#define SYSFS_LED_MIN_STEP_DELAY 20 // [ms]
+
+/** Upper limit for calibrated step delay that still allows breathing */
+#define SYSFS_LED_MAX_STEP_DELAY 200 // [ms]
+
+/** Upper limit for calibrated maximum number of breathing steps */
+#define SYSFS_LED_STEPS_LIMIT 1024
+
+/** Number of write rounds per channel made during calibration */
+#define SYSFS_LED_CALIBRATE_ROUNDS 4
+
+/** Intensity used for calibration writes
+ *
+ * Dim enough not to be noticed; raised only if backend scaling
+ * makes it indistinguishable from zero. */
+#define SYSFS_LED_CALIBRATE_LEVEL 1
+
+/** Step delay / write latency ratio when writing from mainloop */
+#define SYSFS_LED_LOAD_FACTOR 20
+
+/** Step delay / write latency ratio when writing from worker thread */
+#define SYSFS_LED_THREAD_LOAD_FACTOR 2
+
 /** Minimum number of breathing steps on rise/fall time */
 #define SYSFS_LED_MIN_STEPS 5
 
+/** Minimum number of breathing steps per cycle under wakeup budget */
+#define SYSFS_LED_MIN_BUDGET_STEPS 2
+
+/** Length of the period wakeup budget is expressed for */
+#define SYSFS_LED_BUDGET_PERIOD 60000 // [ms]
+
+/** Delay between led class uevent and re-probing
+ *
+ * Multi channel leds show up as a burst of devices, and udev
+ * needs some time for adjusting access rights too. */
+#define SYSFS_LED_REPROBE_DELAY 1000 // [ms]
+
+/** How early flexible timers can be dispatched along with others
+ *
+ * Breathing steps of several led instances that fall within this
+ * window are served from a single wakeup. */
+#define SYSFS_LED_COALESCE_WINDOW 10 // [ms]
+
+/** Length of cross-fade when switching between stacked patterns */
+#define SYSFS_LED_CROSSFADE_TIME 300 // [ms]
+
+/** Default time slice for stacked patterns of equal priority */
+#define SYSFS_LED_DEFAULT_SLICE 3000 // [ms]
+
+/** Default battery charge used per led timer wakeup
+ *
+ * Roughly 5 ms of cpu activity at 100 mA.
+ */
+#define SYSFS_LED_WAKEUP_CHARGE 500 // [uAs]
+
+/** Environment variable that overrides SysfsRoot configuration
+ *
+ * Allows running several instances against separate fake sysfs
+ * trees without touching the configuration files.
+ */
+#define SYSFS_LED_ROOT_ENV "MCE_HYBRIS_SYSFS_ROOT"
+
+/** Maximum number of extra leds that can be configured */
+#define SYSFS_LED_EXTRA_MAX 4
+
 /* ========================================================================= *
  * PROTOTYPES
  * ========================================================================= */
@@ -72,14 +147,18 @@
  * ------------------------------------------------------------------------- */
 
 static void        led_control_enable                (led_control_t *self, bool enable);
-static void        led_control_blink                 (led_control_t *self, int on_ms, int off_ms);
-static void        led_control_value                 (led_control_t *self, int r, int g, int b);
+void               led_control_blink                 (led_control_t *self, int on_ms, int off_ms);
+void               led_control_value                 (led_control_t *self, int r, int g, int b);
 static void        led_control_init                  (led_control_t *self);
 
 static bool        led_control_can_breathe           (const led_control_t *self);
 static led_ramp_t  led_control_breath_type           (const led_control_t *self);
+static int         led_control_settle_delay          (const led_control_t *self, bool blink);
 
-static bool        led_control_probe                 (led_control_t *self);
+static int64_t     led_control_time_value            (led_control_t *self, int r, int g, int b);
+static int64_t     led_control_measure               (led_control_t *self, int level);
+static void        led_control_calibrate             (led_control_t *self, bool threaded);
+static bool        led_control_probe                 (led_control_t *self, const char *group);
 void               led_control_close                 (led_control_t *self);
 
 /* ------------------------------------------------------------------------- *
@@ -92,27 +171,43 @@ void               led_control_close                 (led_control_t *self);
  */
 typedef struct
 {
-  int  r,g,b;    // color
-  int  on,off;   // blink timing
-  int  level;    // brightness [0 ... 255]
-  bool breathe;  // breathe instead of blinking
+  int      r,g,b;    // color
+  int      on,off;   // blink timing
+  int      level;    // brightness [0 ... 255]
+  bool     breathe;  // breathe instead of blinking
+  unsigned sequence; // keyframe sequence id, or 0 for none
 } led_state_t;
 
 /** Different styles of led patterns
  */
 typedef enum
 {
-  STYLE_OFF,    // led is off
-  STYLE_STATIC, // led has constant color
-  STYLE_BLINK,  // led is blinking with on/off periods
-  STYLE_BREATH, // led is breathing with rise/fall times
+  STYLE_OFF,      // led is off
+  STYLE_STATIC,   // led has constant color
+  STYLE_BLINK,    // led is blinking with on/off periods
+  STYLE_BREATH,   // led is breathing with rise/fall times
+  STYLE_SEQUENCE, // led is running a keyframe sequence
 } led_style_t;
 
-static bool        led_state_has_equal_timing        (const led_state_t *self, const led_state_t *that);
-static bool        led_state_is_equal                (const led_state_t *self, const led_state_t *that);
-static bool        led_state_has_color               (const led_state_t *self);
-static void        led_state_sanitize                (led_state_t *self);
-static led_style_t led_state_get_style               (const led_state_t *self);
+/** Different kinds of led state transitions
+ */
+typedef enum
+{
+  CHANGE_NONE,   // nothing changes
+  CHANGE_LEVEL,  // only the als based brightness level changes
+  CHANGE_COLOR,  // color changes, style and timing stay the same
+  CHANGE_TIMING, // blink/breathing timing changes
+  CHANGE_STYLE,  // switch between off/static/blink/breath styles
+} led_change_t;
+
+static bool         led_state_has_equal_timing       (const led_state_t *self, const led_state_t *that);
+static bool         led_state_has_equal_color        (const led_state_t *self, const led_state_t *that);
+static bool         led_state_is_equal               (const led_state_t *self, const led_state_t *that);
+static bool         led_state_has_color              (const led_state_t *self);
+static void         led_state_sanitize               (led_state_t *self, int step_delay);
+static led_style_t  led_state_get_style              (const led_state_t *self);
+static led_change_t led_state_get_change             (const led_state_t *self, const led_state_t *that);
+static const char  *led_change_repr                  (led_change_t change);
 
 /* ------------------------------------------------------------------------- *
  * SYSFS_LED
@@ -120,31 +215,305 @@ static led_style_t led_state_get_style               (const led_state_t *self);
  * Top level sysfs led functionality used by mce hybris plugin.
  * ------------------------------------------------------------------------- */
 
-static void        sysfs_led_close_files             (void);
-static bool        sysfs_led_probe_files             (void);
+/** Placeholder step index for: no breathing step applied yet */
+#define SYSFS_LED_NO_STEP ((size_t)-1)
+
+/** How led patterns are downgraded while display is off
+ */
+typedef enum
+{
+  SYSFS_LED_DOWNGRADE_NONE   = 0, // patterns run as requested
+  SYSFS_LED_DOWNGRADE_BLINK  = 1, // hw blinking, or static if not available
+  SYSFS_LED_DOWNGRADE_STATIC = 2, // static color
+} sysfs_led_downgrade_t;
+
+/** Function called when led engine timer is due
+ *
+ * @param self led engine instance
+ * @param now  monotonic time stamp [ms] to evaluate timeline at
+ */
+typedef void (*sysfs_led_timer_fn)(sysfs_led_t *self, int64_t now);
+
+/** Timer slot served by the shared scheduler
+ */
+typedef struct
+{
+  /** Monotonic time stamp [ms] when timer is due */
+  int64_t            due;
+
+  /** Function to call, or NULL if timer is not active */
+  sysfs_led_timer_fn func;
+
+  /** Flag for: may be dispatched early along with other timers */
+  bool               flexible;
+} sysfs_led_timer_t;
+
+/** Intensity curve for sw breathing
+ *
+ * The breathing steps are tied to a timeline on monotonic clock
+ * that begins from the start time - the step to apply is always
+ * evaluated from the current time instead of counting timer
+ * callbacks.
+ *
+ * Keyframe sequences are compiled into the same step table, with
+ * per step colors and an optional limit on number of cycles.
+ */
+typedef struct
+{
+  size_t  step;
+  size_t  steps;
+  int     delay;
+  int     cycle;
+  int64_t start;
+  uint8_t value[SYSFS_LED_STEPS_LIMIT];
+  int     duration[SYSFS_LED_STEPS_LIMIT];
+  int     offset[SYSFS_LED_STEPS_LIMIT];
+
+  /* Keyframe sequence data */
+  bool    colored;
+  int     repeat;
+  uint8_t color[SYSFS_LED_STEPS_LIMIT][3];
+  uint8_t final[3];
+} sysfs_led_ramp_t;
+
+typedef struct sysfs_led_pattern_t sysfs_led_pattern_t;
+
+/** Named pattern in led engine pattern stack
+ */
+struct sysfs_led_pattern_t
+{
+  /** Next pattern in registration order */
+  sysfs_led_pattern_t *next;
+
+  /** Name used for identifying the pattern */
+  char                *name;
+
+  /** Priority - higher values preempt lower ones */
+  int                  priority;
+
+  /** How long to show before letting equal priority patterns run [ms] */
+  int                  slice;
+
+  /** Flag for: pattern is a candidate for showing */
+  bool                 active;
+
+  /** Precompiled step table */
+  sysfs_led_ramp_t     table;
+
+  /** Keyframes, retained for evaluating downgraded pattern */
+  led_keyframe_t       frames[SYSFS_LED_KEYFRAMES_MAX];
+
+  /** Number of keyframes in use */
+  int                  frame_count;
+};
+
+/** Led engine instance
+ */
+struct sysfs_led_t
+{
+  /** Next instance in scheduler list */
+  sysfs_led_t       *next;
+
+  /** Backend used for controlling the led */
+  led_control_t      control;
 
-static void        sysfs_led_set_rgb_blink           (int on, int off);
-static void        sysfs_led_set_rgb_value           (int r, int g, int b);
+  /** Currently active led state */
+  led_state_t        curr;
 
-static void        sysfs_led_generate_ramp_half_sin  (int ms_on, int ms_off);
-static void        sysfs_led_generate_ramp_hard_step (int ms_on, int ms_off);
-static void        sysfs_led_generate_ramp_dummy     (void);
-static void        sysfs_led_generate_ramp           (int ms_on, int ms_off);
+  /** Latest led state request, before possible downgrade */
+  led_state_t        want;
 
-static gboolean    sysfs_led_static_cb               (gpointer aptr);
-static gboolean    sysfs_led_step_cb                 (gpointer aptr);
-static gboolean    sysfs_led_stop_cb                 (gpointer aptr);
-static void        sysfs_led_start                   (const led_state_t *next);
+  /** Currently used breathing curve */
+  sysfs_led_ramp_t   breathe;
 
-static void        sysfs_led_wait_kernel             (void);
+  /** Monotonic time stamp until which kernel side is assumed to be busy */
+  int64_t            settle_tick;
 
-bool               sysfs_led_init                    (void);
+  /** Flag for: blinking must be reset before applying next state */
+  bool               reset_blinking;
+
+  /** Timer for stopping led */
+  sysfs_led_timer_t  stop_timer;
+
+  /** Timer for breathing/setting led */
+  sysfs_led_timer_t  step_timer;
+
+  /** Keyframes of the latest sequence request */
+  led_keyframe_t     frames[SYSFS_LED_KEYFRAMES_MAX];
+
+  /** Number of keyframes in use */
+  int                frame_count;
+
+  /** How many times the sequence is played, or 0 for forever */
+  int                frame_repeat;
+
+  /** Id of the latest sequence request */
+  unsigned           sequence_id;
+
+  /** Latest plain pattern request, shown when pattern stack is empty */
+  led_state_t        base;
+
+  /** Registered stacked patterns */
+  sysfs_led_pattern_t *stack;
+
+  /** Stacked pattern currently shown, or NULL */
+  sysfs_led_pattern_t *stack_top;
+
+  /** Sequence id used while showing stacked patterns */
+  unsigned           stack_seq;
+
+  /** Timer for rotating stacked patterns of equal priority */
+  sysfs_led_timer_t  slice_timer;
+
+  /** Led color last written, after brightness scaling */
+  int                shown[3];
+
+  /** Cross-fade start time [ms], length [ms] and starting color */
+  int64_t            fade_start;
+  int                fade_len;
+  int                fade_from[3];
+
+  /** Flag for: display is off, prefer patterns that need no wakeups */
+  bool               lowpower;
+
+  /** Monotonic time stamp [ms] when current downgrade began, or 0 */
+  int64_t            downgrade_start;
+
+  /** Number of times led pattern has been downgraded */
+  int                downgrade_count;
+
+  /** Total time spent in finished downgrades [ms] */
+  int64_t            downgrade_time;
+
+  /** Led current at full red, green and blue [uA], or 0 if not known */
+  int                current[3];
+
+  /** Battery charge used per timer wakeup [uAs] */
+  int                wakeup_charge;
+};
+
+/** Extra led that has a config group of its own
+ */
+typedef struct
+{
+  /** Name used in ExtraLeds setting and for lookups */
+  gchar             *name;
+
+  /** Led engine instance driving the led */
+  sysfs_led_t       *led;
+} sysfs_led_extra_t;
+
+static char       *sysfs_led_resolve_path            (const char *path);
+static void        sysfs_led_close_files             (led_control_t *control);
+static bool        sysfs_led_probe_files             (led_control_t *control, const char *group);
+
+static void        sysfs_led_update_settle           (sysfs_led_t *self, bool blink);
+static int         sysfs_led_get_settle              (sysfs_led_t *self);
+
+static void        sysfs_led_set_rgb_blink           (sysfs_led_t *self, int on, int off);
+static void        sysfs_led_set_rgb_value           (sysfs_led_t *self, int r, int g, int b);
+
+static int         sysfs_led_get_budget_steps        (sysfs_led_t *self, int ms_cycle);
+static void        sysfs_led_finish_ramp             (sysfs_led_ramp_t *ramp);
+static void        sysfs_led_generate_ramp_sparse    (sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off, int steps);
+static void        sysfs_led_generate_ramp_half_sin  (sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off);
+static void        sysfs_led_generate_ramp_hard_step (sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off);
+static void        sysfs_led_generate_ramp_dummy     (sysfs_led_ramp_t *ramp);
+static void        sysfs_led_generate_ramp           (sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off);
+static void        sysfs_led_compile_sequence        (sysfs_led_t *self, sysfs_led_ramp_t *ramp, const led_keyframe_t *frames, int count, int repeat);
+static void        sysfs_led_generate_ramp_sequence  (sysfs_led_t *self);
+
+static bool        sysfs_led_timer_is_active         (const sysfs_led_timer_t *timer);
+static void        sysfs_led_timer_start             (sysfs_led_timer_t *timer, int64_t due, sysfs_led_timer_fn func, bool flexible);
+static void        sysfs_led_timer_stop              (sysfs_led_timer_t *timer);
+static void        sysfs_led_sched_dispatch          (sysfs_led_t *self, sysfs_led_timer_t *timer, int64_t now);
+void               sysfs_led_lock                    (void);
+void               sysfs_led_unlock                  (void);
+
+static void        sysfs_led_sched_fire              (void);
+static void        sysfs_led_sched_rethink           (void);
+bool               sysfs_led_sched_select            (led_timer_type_t type);
+
+static void        sysfs_led_reset_phase             (sysfs_led_t *self, int64_t start);
+static size_t      sysfs_led_find_step               (sysfs_led_t *self, int phase);
+static int64_t     sysfs_led_align_deadline          (int64_t deadline, int64_t limit);
+
+static void        sysfs_led_update                  (sysfs_led_t *self);
+static void        sysfs_led_update_cb               (sysfs_led_t *self, int64_t now);
+static void        sysfs_led_static                  (sysfs_led_t *self);
+static void        sysfs_led_static_cb               (sysfs_led_t *self, int64_t now);
+static void        sysfs_led_step_cb                 (sysfs_led_t *self, int64_t now);
+static void        sysfs_led_stop                    (sysfs_led_t *self);
+static void        sysfs_led_stop_cb                 (sysfs_led_t *self, int64_t now);
+static void        sysfs_led_apply                   (sysfs_led_t *self, bool blink);
+static void        sysfs_led_restart                 (sysfs_led_t *self, const led_state_t *prev);
+static void        sysfs_led_start                   (sysfs_led_t *self, const led_state_t *next);
+
+static void        sysfs_led_wait_kernel             (sysfs_led_t *self);
+
+static bool        sysfs_led_downgrade_enabled       (const sysfs_led_t *self);
+static int         sysfs_led_keyframe_peak           (const led_keyframe_t *frame);
+static bool        sysfs_led_downgrade_sequence      (const sysfs_led_t *self, led_state_t *state);
+static bool        sysfs_led_downgrade               (const sysfs_led_t *self, led_state_t *state);
+static void        sysfs_led_downgrade_account       (sysfs_led_t *self, bool downgraded);
+
+static unsigned    sysfs_led_next_sequence           (sysfs_led_t *self);
+static sysfs_led_pattern_t *sysfs_led_stack_find     (sysfs_led_t *self, const char *name);
+static sysfs_led_pattern_t *sysfs_led_stack_pick     (sysfs_led_t *self, bool rotate, int *peers);
+static void        sysfs_led_stack_switch            (sysfs_led_t *self);
+static void        sysfs_led_stack_select            (sysfs_led_t *self, bool rotate);
+static void        sysfs_led_stack_slice_cb          (sysfs_led_t *self, int64_t now);
+static void        sysfs_led_stack_adopt             (sysfs_led_t *self, sysfs_led_t *from);
+
+static int         sysfs_led_energy_config           (const char *key, int def, double scale);
+static void        sysfs_led_energy_init             (sysfs_led_t *self);
+static int64_t     sysfs_led_energy_color            (const sysfs_led_t *self, int r, int g, int b);
+static void        sysfs_led_energy_ramp             (const sysfs_led_t *self, const sysfs_led_ramp_t *ramp, const led_state_t *state, int *led_ua, int *cpu_ua);
+static void        sysfs_led_energy_estimate         (sysfs_led_t *self, const led_state_t *state, const sysfs_led_ramp_t *table, int *led_ua, int *cpu_ua);
+
+sysfs_led_t       *sysfs_led_create                  (const led_control_t *control);
+void               sysfs_led_delete                  (sysfs_led_t *self);
+void               sysfs_led_object_set_pattern      (sysfs_led_t *self, int r, int g, int b, int ms_on, int ms_off);
+void               sysfs_led_object_set_sequence     (sysfs_led_t *self, const led_keyframe_t *frames, int count, int repeat);
+bool               sysfs_led_object_can_breathe      (const sysfs_led_t *self);
+bool               sysfs_led_object_pattern_register (sysfs_led_t *self, const char *name, int priority, int slice_ms, const led_keyframe_t *frames, int count);
+bool               sysfs_led_object_pattern_unregister(sysfs_led_t *self, const char *name);
+bool               sysfs_led_object_pattern_activate (sysfs_led_t *self, const char *name, bool active);
+void               sysfs_led_object_set_breathing    (sysfs_led_t *self, bool enable);
+void               sysfs_led_object_set_brightness   (sysfs_led_t *self, int level);
+void               sysfs_led_object_set_display_state(sysfs_led_t *self, bool on);
+bool               sysfs_led_object_estimate_pattern (sysfs_led_t *self, int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool               sysfs_led_object_estimate_named   (sysfs_led_t *self, const char *name, int *led_ua, int *cpu_ua);
+
+static void        sysfs_led_extra_init              (void);
+static void        sysfs_led_extra_quit              (void);
+sysfs_led_t       *sysfs_led_lookup                  (const char *name);
+
+static void        sysfs_led_activate                (void);
+static void       *sysfs_led_probe_thread_cb         (void *aptr);
+static gboolean    sysfs_led_probe_done_cb           (gpointer aptr);
+static void        sysfs_led_probe_join              (void);
+static bool        sysfs_led_probe_start             (void);
+static gboolean    sysfs_led_reprobe_cb              (gpointer aptr);
+static void        sysfs_led_probe_uevent_cb         (void);
+
+bool               sysfs_led_init                    (sysfs_led_probed_fn cb);
+bool               sysfs_led_attach                  (const led_control_t *control);
 void               sysfs_led_quit                    (void);
 
 bool               sysfs_led_set_pattern             (int r, int g, int b, int ms_on, int ms_off);
+bool               sysfs_led_set_sequence            (const led_keyframe_t *frames, int count, int repeat);
 bool               sysfs_led_can_breathe             (void);
+bool               sysfs_led_pattern_register        (const char *name, int priority, int slice_ms, const led_keyframe_t *frames, int count);
+bool               sysfs_led_pattern_unregister      (const char *name);
+bool               sysfs_led_pattern_activate        (const char *name, bool active);
 void               sysfs_led_set_breathing           (bool enable);
 void               sysfs_led_set_brightness          (int level);
+void               sysfs_led_get_wakeup_rate         (int *curr, int *avg);
+void               sysfs_led_set_display_state       (bool on);
+void               sysfs_led_get_downgrade_stats     (int *count, int *secs);
+bool               sysfs_led_estimate_pattern        (int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool               sysfs_led_estimate_named          (const char *name, int *led_ua, int *cpu_ua);
 
 /* ========================================================================= *
  * LED_CONTROL
@@ -174,7 +543,7 @@ led_control_enable(led_control_t *self, bool enable)
  * @param on   milliseconds on
  * @param off  milliseconds off
  */
-static void
+void
 led_control_blink(led_control_t *self, int on_ms, int off_ms)
 {
   if( self->blink )
@@ -191,7 +560,7 @@ led_control_blink(led_control_t *self, int on_ms, int off_ms)
  * @param g    green intensity (0 ... 255)
  * @param b    blue intensity  (0 ... 255)
  */
-static void
+void
 led_control_value(led_control_t *self, int r, int g, int b)
 {
   if( self->value )
@@ -219,13 +588,24 @@ led_control_init(led_control_t *self)
   self->close  = 0;
 
   /* Assume paths from config are not to be used */
-  self->use_config = false;
+  self->use_config  = false;
+  self->config_only = false;
 
   /* Assume that it is exceptional if sw breathing can't be supported */
   self->can_breathe = true;
+  /* And that sysfs writes do not block */
+  self->blocking = false;
   /* And half sine curve should be used for breathing */
   self->breath_type = LED_RAMP_HALF_SINE;
 
+  /* Unless backend knows better, allow kernel to settle after
+   * every change */
+  self->settle_type = LED_SETTLE_FIXED;
+  self->settle_ms   = SYSFS_LED_KERNEL_DELAY;
+
+  /* Use built-in breathing limits unless calibrated */
+  self->step_delay  = SYSFS_LED_STEP_DELAY;
+  self->max_steps   = SYSFS_LED_MAX_STEPS;
 }
 
 /** Query if backend can support sw breathing
@@ -248,14 +628,168 @@ led_control_breath_type(const led_control_t *self)
   return self->can_breathe ? self->breath_type : LED_RAMP_DISABLED;
 }
 
-/** Probe sysfs for RGB LED controls
+/** Query how long kernel side needs to settle after a change
+ *
+ * @param self  control object
+ * @param blink true if blinking config was changed, false otherwise
+ *
+ * @return settle time in milliseconds, or zero if not needed
+ */
+static int
+led_control_settle_delay(const led_control_t *self, bool blink)
+{
+  int delay = 0;
+
+  switch( self->settle_type ) {
+  case LED_SETTLE_NONE:
+    break;
+
+  case LED_SETTLE_BLINK:
+    if( blink )
+      delay = self->settle_ms;
+    break;
+
+  default:
+    delay = self->settle_ms;
+    break;
+  }
+
+  return delay;
+}
+
+/** Measure how long setting RGB LED color takes
  *
  * @param self control object
+ * @param r    red intensity   (0 ... 255)
+ * @param g    green intensity (0 ... 255)
+ * @param b    blue intensity  (0 ... 255)
+ *
+ * @return duration in microseconds
+ */
+static int64_t
+led_control_time_value(led_control_t *self, int r, int g, int b)
+{
+  int64_t t = led_util_get_tick_us();
+  led_control_value(self, r, g, b);
+  return led_util_get_tick_us() - t;
+}
+
+/** Measure worst average write latency over all color channels
+ *
+ * @param self  control object
+ * @param level intensity to toggle each channel to and from zero
+ *
+ * @return latency in microseconds
+ */
+static int64_t
+led_control_measure(led_control_t *self, int level)
+{
+  static const int lut[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+
+  int64_t latency = 0;
+
+  for( size_t c = 0; c < G_N_ELEMENTS(lut); ++c ) {
+    int64_t sum = 0;
+
+    for( int i = 0; i < SYSFS_LED_CALIBRATE_ROUNDS; ++i ) {
+      int v = (i & 1) ? 0 : level;
+      sum += led_control_time_value(self, lut[c][0] * v,
+                                    lut[c][1] * v, lut[c][2] * v);
+    }
+    led_control_value(self, 0, 0, 0);
+
+    int64_t avg = sum / SYSFS_LED_CALIBRATE_ROUNDS;
+    mce_log(LL_DEBUG, "%s: channel %zu: level %d: avg write = %lld us",
+            self->name, c, level, (long long)avg);
+
+    if( latency < avg )
+      latency = avg;
+  }
+
+  return latency;
+}
+
+/** Adjust breathing parameters based on measured write latency
+ *
+ * Each color channel is toggled between minimal and zero intensity
+ * few times and the worst average latency is used for deciding
+ * minimum breathing step delay, maximum number of steps and
+ * whether sw breathing should be allowed at all.
+ *
+ * If the backend maps the minimal intensity to zero, sysfs writes
+ * get elided and the level is raised until actual writes are made.
+ *
+ * @param self     successfully probed control object
+ * @param threaded true if writes are going to be made from a worker
+ *                 thread, false if they are made from mainloop
+ */
+static void
+led_control_calibrate(led_control_t *self, bool threaded)
+{
+  int64_t latency = 0;
+
+  for( int level = SYSFS_LED_CALIBRATE_LEVEL; ; level *= 2 ) {
+    if( level > 255 )
+      level = 255;
+
+    unsigned written0 = 0, elided0 = 0;
+    unsigned written1 = 0, elided1 = 0;
+
+    sysfsval_get_stats(&written0, &elided0);
+    latency = led_control_measure(self, level);
+    sysfsval_get_stats(&written1, &elided1);
+
+    /* Backends that do not use sysfsval make all writes; others
+     * must have made at least one write per toggle */
+    bool tracked = (written1 + elided1) != (written0 + elided0);
+    bool written = (written1 - written0) >= 3 * SYSFS_LED_CALIBRATE_ROUNDS;
+
+    if( !tracked || written || level >= 255 )
+      break;
+  }
+
+  int factor = threaded ? SYSFS_LED_THREAD_LOAD_FACTOR : SYSFS_LED_LOAD_FACTOR;
+  int delay  = (int)((latency * factor + 999) / 1000);
+
+  if( delay < SYSFS_LED_MIN_STEP_DELAY )
+    delay = SYSFS_LED_MIN_STEP_DELAY;
+
+  /* Keep the wakeups per breathing cycle at the default level */
+  int steps = SYSFS_LED_MAX_STEPS * SYSFS_LED_STEP_DELAY / delay;
+
+  if( steps > SYSFS_LED_STEPS_LIMIT )
+    steps = SYSFS_LED_STEPS_LIMIT;
+
+  self->step_delay = delay;
+  self->max_steps  = steps;
+
+  if( delay > SYSFS_LED_MAX_STEP_DELAY ) {
+    /* Too slow for sw breathing */
+    self->can_breathe = false;
+  }
+  else if( self->blocking && threaded ) {
+    /* Blocking is not an issue when using worker thread */
+    self->can_breathe = true;
+  }
+
+  mce_log(LL_NOTICE, "%s: write latency %lld us -> step delay %d ms,"
+          " max steps %d, breathing %s", self->name, (long long)latency,
+          self->step_delay, self->max_steps,
+          self->can_breathe ? "allowed" : "denied");
+}
+
+/** Probe sysfs for RGB LED controls
+ *
+ * Extra leds must have backend and paths defined in their own config
+ * group, built-in fallback paths are used only for the indicator led.
+ *
+ * @param self  control object
+ * @param group config group of an extra led, or NULL for indicator led
  *
  * @return true if required control files were available, false otherwise
  */
 static bool
-led_control_probe(led_control_t *self)
+led_control_probe(led_control_t *self, const char *group)
 {
   typedef bool (*led_control_probe_fn)(led_control_t *);
 
@@ -268,6 +802,10 @@ led_control_probe(led_control_t *self)
     led_control_probe_fn func;
   } lut[] =
   {
+    /* The multicolor backend requires presense of
+     * unique 'multi_index' and 'multi_intensity' files. */
+    { "multicolor", led_control_multicolor_probe },
+
     /* The hammerhead backend requires presense of
      * unique 'on_off_ms' and 'rgb_start' files. */
     { "hammerhead", led_control_hammerhead_probe },
@@ -303,13 +841,22 @@ led_control_probe(led_control_t *self)
   };
 
   bool   ack  = false;
-  gchar *name = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+  gchar *name = plugin_config_get_string(group ?: MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
                                          MCE_CONF_LED_CONFIG_HYBRIS_BACKEND,
                                          0);
 
+  if( group && !name ) {
+    mce_log(LL_WARN, "[%s] %s not defined", group,
+            MCE_CONF_LED_CONFIG_HYBRIS_BACKEND);
+    goto cleanup;
+  }
+
+  objconf_set_group(group);
+
   for( size_t i = 0; i < G_N_ELEMENTS(lut); ++i )
   {
-    self->use_config = false;
+    self->use_config  = false;
+    self->config_only = (group != 0);
 
     if( name ) {
       if( strcmp(lut[i].name, name) ) {
@@ -329,12 +876,31 @@ led_control_probe(led_control_t *self)
       continue;
     }
 
+    bool threaded = QUIRK(QUIRK_WRITER_THREAD, false);
+
+    /* Optionally calibrate breathing parameters. This must be done
+     * before possible writer thread takes over the backend. */
+    if( QUIRK(QUIRK_CALIBRATE, false) )
+      led_control_calibrate(self, threaded);
+
+    /* Optionally move backend writes to a worker thread. Then
+     * blocking writes do not stall mainloop, and sw breathing
+     * can be used with such backends too. */
+    if( threaded && led_writer_attach(self) ) {
+      if( self->blocking && self->step_delay <= SYSFS_LED_MAX_STEP_DELAY )
+        self->can_breathe = true;
+    }
+
     self->can_breathe = QUIRK(QUIRK_BREATHING, self->can_breathe);
 
     ack = true;
     break;
   }
 
+  objconf_set_group(0);
+
+cleanup:
+
   g_free(name);
 
   return ack;
@@ -365,8 +931,19 @@ led_control_close(led_control_t *self)
 static bool
 led_state_has_equal_timing(const led_state_t *self, const led_state_t *that)
 {
-  return (self->on  == that->on &&
-          self->off == that->off);
+  return (self->on       == that->on  &&
+          self->off      == that->off &&
+          self->sequence == that->sequence);
+}
+
+/** Test for led request color equality
+ */
+static bool
+led_state_has_equal_color(const led_state_t *self, const led_state_t *that)
+{
+  return (self->r == that->r &&
+          self->g == that->g &&
+          self->b == that->b);
 }
 
 /** Test for led request equality
@@ -380,7 +957,8 @@ led_state_is_equal(const led_state_t *self, const led_state_t *that)
           self->on      == that->on &&
           self->off     == that->off &&
           self->level   == that->level &&
-          self->breathe == that->breathe);
+          self->breathe == that->breathe &&
+          self->sequence == that->sequence);
 }
 
 /** Test for active led request
@@ -388,17 +966,29 @@ led_state_is_equal(const led_state_t *self, const led_state_t *that)
 static bool
 led_state_has_color(const led_state_t *self)
 {
+  /* Keyframe sequences carry their own colors */
+  if( self->sequence )
+    return true;
+
   return self->r > 0 || self->g > 0 || self->b > 0;
 }
 
 /** Normalize/sanity check requested values
+ *
+ * @param self       led state
+ * @param step_delay minimum breathing step delay [ms]
  */
 static void
-led_state_sanitize(led_state_t *self)
+led_state_sanitize(led_state_t *self, int step_delay)
 {
-  int min_period = SYSFS_LED_STEP_DELAY * SYSFS_LED_MIN_STEPS;
+  int min_period = step_delay * SYSFS_LED_MIN_STEPS;
 
-  if( !led_state_has_color(self) ) {
+  if( self->sequence ) {
+    /* keyframes define the timing */
+    self->on  = 0;
+    self->off = 0;
+  }
+  else if( !led_state_has_color(self) ) {
     /* blinking/breathing black and black makes no sense */
     self->on  = 0;
     self->off = 0;
@@ -424,6 +1014,10 @@ led_state_sanitize(led_state_t *self)
 static led_style_t
 led_state_get_style(const led_state_t *self)
 {
+  if( self->sequence ) {
+    return STYLE_SEQUENCE;
+  }
+
   if( !led_state_has_color(self) ) {
     return STYLE_OFF;
   }
@@ -439,25 +1033,72 @@ led_state_get_style(const led_state_t *self)
   return STYLE_BLINK;
 }
 
+/** Classify transition from one led request to another
+ */
+static led_change_t
+led_state_get_change(const led_state_t *self, const led_state_t *that)
+{
+  if( led_state_is_equal(self, that) )
+    return CHANGE_NONE;
+
+  /* Initial state is invalid -> treat as style change */
+  if( self->r < 0 || self->g < 0 || self->b < 0 )
+    return CHANGE_STYLE;
+
+  if( led_state_get_style(self) != led_state_get_style(that) )
+    return CHANGE_STYLE;
+
+  if( !led_state_has_equal_timing(self, that) )
+    return CHANGE_TIMING;
+
+  if( !led_state_has_equal_color(self, that) )
+    return CHANGE_COLOR;
+
+  return CHANGE_LEVEL;
+}
+
+/** Get human readable name of led state transition type
+ */
+static const char *
+led_change_repr(led_change_t change)
+{
+  static const char * const lut[] =
+  {
+    [CHANGE_NONE]   = "none",
+    [CHANGE_LEVEL]  = "level",
+    [CHANGE_COLOR]  = "color",
+    [CHANGE_TIMING] = "timing",
+    [CHANGE_STYLE]  = "style",
+  };
+
+  return lut[change];
+}
+
 /* ========================================================================= *
  * SYSFS_LED
  * ========================================================================= */
 
-/** Currently used intensity curve for sw breathing */
+/** Led timer wakeup bookkeeping, shared by all instances */
 static struct {
-  size_t  step;
-  size_t  steps;
-  int     delay;
-  uint8_t value[SYSFS_LED_MAX_STEPS];
-} sysfs_led_breathe =
+  int64_t  started;
+  uint64_t count;
+} sysfs_led_wakeups =
 {
-  .step  = 0,
-  .steps = 0,
-  .delay = 0,
+  .started = 0,
+  .count   = 0,
 };
 
-/** Currently active RGB led state; initialize to invalid color */
-static led_state_t sysfs_led_curr =
+/** Led engine instances, in creation order */
+static sysfs_led_t *sysfs_led_instances = 0;
+
+/** Lock for serializing led engine access from mainloop and timer thread
+ *
+ * Recursive, as public functions get called also from within the engine.
+ */
+static pthread_mutex_t sysfs_led_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/** Initial state for led engine instances */
+static const led_state_t sysfs_led_initial =
 {
   /* force 1st change to take effect by initializing to invalid color */
   .r       = -1,
@@ -471,401 +1112,2572 @@ static led_state_t sysfs_led_curr =
 
   /* full brightness */
   .level   = 255,
+
+  /* no keyframe sequence */
+  .sequence = 0,
 };
 
-static led_control_t led_control;
+/** Map sysfs path to the file sysfsval should open
+ *
+ * Files that the led class index knows not to exist are skipped,
+ * and paths are redirected to possibly configured fake sysfs root.
+ *
+ * @param path sysfs path
+ *
+ * @return path to open, or NULL with errno set
+ */
+static char *
+sysfs_led_resolve_path(const char *path)
+{
+  char *res = 0;
+
+  if( !sysfs_led_index_exists(path) ) {
+    errno = ENOENT;
+    goto cleanup;
+  }
+
+  res = led_util_root_path(path);
+
+cleanup:
+
+  return res;
+}
 
 /** Close all LED sysfs files
+ *
+ * @param control led control backend
  */
 static void
-sysfs_led_close_files(void)
+sysfs_led_close_files(led_control_t *control)
 {
-  led_control_close(&led_control);
+  unsigned written = 0, elided = 0;
+  sysfsval_get_stats(&written, &elided);
+  mce_log(LL_DEBUG, "led sysfs writes: %u made, %u elided",
+          written, elided);
+
+  led_control_close(control);
+
+  /* Close files that are no longer in use */
+  sysfsval_registry_flush();
 }
 
 /** Open sysfs control files for RGB leds
+ *
+ * @param control led control backend to initialize
+ * @param group   config group of an extra led, or NULL for indicator led
  *
  * @return true if required control files were available, false otherwise
  */
 static bool
-sysfs_led_probe_files(void)
+sysfs_led_probe_files(led_control_t *control, const char *group)
 {
-  led_control_init(&led_control);
+  led_control_init(control);
+
+  /* Scan led class directory once instead of trying
+   * to open each and every candidate path */
+  sysfs_led_index_init();
 
-  bool probed = led_control_probe(&led_control);
+  bool probed = led_control_probe(control, group);
+
+  sysfs_led_index_quit();
+
+  /* Close files left open by failed probing attempts */
+  sysfsval_registry_flush();
 
   /* Note: As there are devices that do not have indicator
    *       led, a ailures to find a suitable backend must
    *       be assumed to be ok and not logged in the default
    *       verbosity level.
    */
-  mce_log(LL_NOTICE, "led sysfs backend: %s",
-          probed ? led_control.name : "N/A");
+  mce_log(LL_NOTICE, "%s%sled sysfs backend: %s",
+          group ?: "", group ? ": " : "",
+          probed ? control->name : "N/A");
 
   return probed;
 }
 
+/** Update kernel settle time after making changes
+ *
+ * @param blink true if blinking config was changed, false otherwise
+ */
+static void
+sysfs_led_update_settle(sysfs_led_t *self, bool blink)
+{
+  int delay = led_control_settle_delay(&self->control, blink);
+
+  if( delay > 0 ) {
+    int64_t tick = led_util_get_tick() + delay;
+    if( self->settle_tick < tick )
+      self->settle_tick = tick;
+  }
+}
+
+/** Get time left before kernel side is assumed to be settled
+ *
+ * @return milliseconds to wait, or zero if changes can be made now
+ */
+static int
+sysfs_led_get_settle(sysfs_led_t *self)
+{
+  int64_t left = self->settle_tick - led_util_get_tick();
+
+  return (left > 0) ? (int)left : 0;
+}
+
 /** Change blinking attributes of RGB led
  */
 static void
-sysfs_led_set_rgb_blink(int on, int off)
+sysfs_led_set_rgb_blink(sysfs_led_t *self, int on, int off)
 {
   mce_log(LOG_DEBUG, "on_ms = %d, off_ms = %d", on, off);
-  led_control_blink(&led_control, on, off);
+  led_control_blink(&self->control, on, off);
+  sysfs_led_update_settle(self, true);
 }
 
 /** Change intensity attributes of RGB led
  */
 static void
-sysfs_led_set_rgb_value(int r, int g, int b)
+sysfs_led_set_rgb_value(sysfs_led_t *self, int r, int g, int b)
 {
   mce_log(LOG_DEBUG, "rgb = %d %d %d", r, g, b);
-  led_control_value(&led_control, r, g, b);
+  led_control_value(&self->control, r, g, b);
+  sysfs_led_update_settle(self, false);
+
+  self->shown[0] = r;
+  self->shown[1] = g;
+  self->shown[2] = b;
 }
 
-/** Generate half sine intensity curve for use from breathing timer
+/** Get number of breathing steps per cycle allowed by wakeup budget
+ *
+ * The budget is configured as maximum number of led timer
+ * wakeups per minute.
+ *
+ * @param ms_cycle length of breathing cycle [ms]
+ *
+ * @return maximum number of steps, or zero if budget is not used
  */
-static void
-sysfs_led_generate_ramp_half_sin(int ms_on, int ms_off)
+static int
+sysfs_led_get_budget_steps(sysfs_led_t *self, int ms_cycle)
 {
-  int t = ms_on + ms_off;
-  int s = (t + SYSFS_LED_MAX_STEPS - 1) / SYSFS_LED_MAX_STEPS;
+  int budget = QUIRK(QUIRK_WAKEUP_BUDGET, 0);
 
-  if( s < SYSFS_LED_STEP_DELAY ) {
-    s = SYSFS_LED_STEP_DELAY;
-  }
-  int n = (t + s - 1) / s;
+  if( budget <= 0 )
+    return 0;
 
-  int steps_on  = (n * ms_on + t / 2) / t;
-  int steps_off = n - steps_on;
+  int64_t steps = (int64_t)budget * ms_cycle / SYSFS_LED_BUDGET_PERIOD;
 
-  const float m_pi_2 = (float)M_PI_2;
+  if( steps < SYSFS_LED_MIN_BUDGET_STEPS )
+    steps = SYSFS_LED_MIN_BUDGET_STEPS;
 
-  int k = 0;
+  if( steps > self->control.max_steps )
+    steps = self->control.max_steps;
 
-  for( int i = 0; i < steps_on; ++i ) {
-    float a = i * m_pi_2 / steps_on;
-    sysfs_led_breathe.value[k++] = (uint8_t)(sinf(a) * 255.0f);
-  }
+  return (int)steps;
+}
+
+/** Update breathing cycle length after generating intensity curve
+ */
+static void
+sysfs_led_finish_ramp(sysfs_led_ramp_t *ramp)
+{
+  int cycle = 0;
+
+  for( size_t i = 0; i < ramp->steps; ++i ) {
+    ramp->offset[i] = cycle;
+    cycle += ramp->duration[i];
+  }
+
+  ramp->cycle = cycle;
+
+  if( cycle > 0 ) {
+    mce_log(LL_DEBUG, "cycle=%d, steps=%zu, wakeups/min=%d", cycle,
+            ramp->steps, (int)(ramp->steps *
+                               SYSFS_LED_BUDGET_PERIOD / cycle));
+  }
+}
+
+/** Generate sparse half sine intensity curve for use from breathing timer
+ *
+ * Used when wakeup budget does not allow evenly spaced steps that
+ * are dense enough to look smooth. Instead of spacing the steps evenly
+ * in time, they are placed so that each one changes the intensity
+ * by equal amount. Steps closer than minimum step delay are merged.
+ *
+ * @param ramp   step table to fill in
+ * @param ms_on  rise time [ms]
+ * @param ms_off fall time [ms]
+ * @param steps  number of steps the wakeup budget allows
+ */
+static void
+sysfs_led_generate_ramp_sparse(sysfs_led_t *self, sysfs_led_ramp_t *ramp,
+                               int ms_on, int ms_off, int steps)
+{
+  int t = ms_on + ms_off;
+
+  int steps_on  = (steps * ms_on + t / 2) / t;
+
+  if( steps_on < 1 )
+    steps_on = 1;
+  else if( steps_on > steps - 1 )
+    steps_on = steps - 1;
+
+  int steps_off = steps - steps_on;
+
+  const float m_pi_2 = (float)M_PI_2;
+
+  int     when[SYSFS_LED_STEPS_LIMIT];
+  uint8_t value[SYSFS_LED_STEPS_LIMIT];
+  int     k = 0;
+
+  for( int i = 0; i < steps_on; ++i ) {
+    float v = (float)i / steps_on;
+    when[k]  = (int)(asinf(v) / m_pi_2 * ms_on + 0.5f);
+    value[k] = (uint8_t)(v * 255.0f);
+    ++k;
+  }
+  for( int i = 0; i < steps_off; ++i ) {
+    float v = (float)(steps_off - i) / steps_off;
+    when[k]  = ms_on + (int)(acosf(v) / m_pi_2 * ms_off + 0.5f);
+    value[k] = (uint8_t)(v * 255.0f);
+    ++k;
+  }
+
+  /* Drop steps that would follow the previous one too soon */
+  size_t n = 0;
+
+  for( int i = 0; i < k; ++i ) {
+    if( n > 0 && when[i] - when[n - 1] < self->control.step_delay )
+      continue;
+    when[n]  = when[i];
+    value[n] = value[i];
+    ++n;
+  }
+
+  /* The last step lasts until the end of the cycle */
+  if( n > 1 && t - when[n - 1] < self->control.step_delay )
+    --n;
+
+  for( size_t i = 0; i < n; ++i ) {
+    int next = (i + 1 < n) ? when[i + 1] : t;
+    ramp->value[i]    = value[i];
+    ramp->duration[i] = next - when[i];
+  }
+
+  ramp->delay = self->control.step_delay;
+  ramp->steps = n;
+
+  mce_log(LL_DEBUG, "budget=%d, steps_on=%d, steps_off=%d, used=%zu",
+          steps, steps_on, steps_off, n);
+}
+
+/** Generate half sine intensity curve for use from breathing timer
+ */
+static void
+sysfs_led_generate_ramp_half_sin(sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off)
+{
+  int t = ms_on + ms_off;
+  int s = (t + self->control.max_steps - 1) / self->control.max_steps;
+
+  if( s < self->control.step_delay ) {
+    s = self->control.step_delay;
+  }
+  int n = (t + s - 1) / s;
+
+  int budget = sysfs_led_get_budget_steps(self, t);
+
+  if( budget > 0 && n > budget ) {
+    sysfs_led_generate_ramp_sparse(self, ramp, ms_on, ms_off, budget);
+    return;
+  }
+
+  int steps_on  = (n * ms_on + t / 2) / t;
+  int steps_off = n - steps_on;
+
+  const float m_pi_2 = (float)M_PI_2;
+
+  int k = 0;
+
+  for( int i = 0; i < steps_on; ++i ) {
+    float a = i * m_pi_2 / steps_on;
+    ramp->duration[k] = s;
+    ramp->value[k++] = (uint8_t)(sinf(a) * 255.0f);
+  }
   for( int i = 0; i < steps_off; ++i ) {
     float a = m_pi_2 + i * m_pi_2 / steps_off;
-    sysfs_led_breathe.value[k++] = (uint8_t)(sinf(a) * 255.0f);
+    ramp->duration[k] = s;
+    ramp->value[k++] = (uint8_t)(sinf(a) * 255.0f);
+  }
+
+  ramp->delay = s;
+  ramp->steps = k;
+
+  mce_log(LL_DEBUG, "delay=%d, steps_on=%d, steps_off=%d",
+          ramp->delay, steps_on, steps_off);
+}
+
+/** Generate hard step intensity curve for use from breathing timer
+ */
+static void
+sysfs_led_generate_ramp_hard_step(sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off)
+{
+  /* Round up given on/off lengths to avoid totally bizarre
+   * values that could cause excessive number of timer wakeups.
+   */
+  ms_on  = led_util_roundup(ms_on,  100);
+  ms_off = led_util_roundup(ms_off, 100);
+
+  if( ms_on < self->control.step_delay )
+    ms_on = self->control.step_delay;
+
+  if( ms_off < self->control.step_delay )
+    ms_off = self->control.step_delay;
+
+  /* As the breathing timer supports variable step lengths, we
+   * need to wake up only to flip the led on/off - which also
+   * stays within any sensible wakeup budget.
+   */
+  ramp->value[0]    = 255;
+  ramp->duration[0] = ms_on;
+  ramp->value[1]    = 0;
+  ramp->duration[1] = ms_off;
+
+  ramp->delay = self->control.step_delay;
+  ramp->steps = 2;
+
+  mce_log(LL_DEBUG, "on=%d, off=%d", ms_on, ms_off);
+}
+
+/** Invalidate sw breathing intensity curve
+ */
+static void
+sysfs_led_generate_ramp_dummy(sysfs_led_ramp_t *ramp)
+{
+  ramp->delay = 0;
+  ramp->steps = 0;
+  ramp->cycle = 0;
+}
+
+/** Generate intensity curve for use from breathing timer
+ */
+static void
+sysfs_led_generate_ramp(sysfs_led_t *self, sysfs_led_ramp_t *ramp, int ms_on, int ms_off)
+{
+  switch( led_control_breath_type(&self->control) ) {
+  case LED_RAMP_HARD_STEP:
+    sysfs_led_generate_ramp_hard_step(self, ramp, ms_on, ms_off);
+    break;
+
+  case LED_RAMP_HALF_SINE:
+    sysfs_led_generate_ramp_half_sin(self, ramp, ms_on, ms_off);
+    break;
+
+  default:
+    sysfs_led_generate_ramp_dummy(ramp);
+    break;
+  }
+
+  sysfs_led_finish_ramp(ramp);
+}
+
+/** Compile keyframe sequence into step table for use from breathing timer
+ *
+ * Each keyframe takes at least one step. Linearly interpolated keyframes
+ * are split into further steps of roughly step delay length - within the
+ * limits set by wakeup budget and maximum number of steps.
+ *
+ * @param ramp   step table to fill in
+ * @param frames keyframes
+ * @param count  number of keyframes, in [1, SYSFS_LED_KEYFRAMES_MAX] range
+ * @param repeat number of times to play the sequence, or 0 for forever
+ */
+static void
+sysfs_led_compile_sequence(sysfs_led_t *self, sysfs_led_ramp_t *ramp,
+                           const led_keyframe_t *frames, int count,
+                           int repeat)
+{
+  int  s      = self->control.step_delay;
+  bool smooth = led_control_can_breathe(&self->control);
+
+  /* Each keyframe must last at least one step */
+  int duration[SYSFS_LED_KEYFRAMES_MAX];
+
+  for( int i = 0; i < count; ++i )
+    duration[i] = frames[i].duration < s ? s : frames[i].duration;
+
+  /* Evaluate how many steps are available for interpolation */
+  int t    = 0;
+  int want = 0;
+
+  for( int i = 0; i < count; ++i ) {
+    t += duration[i];
+    if( smooth && frames[i].interp == LED_INTERP_LINEAR )
+      want += duration[i] / s - 1;
+  }
+
+  int limit  = self->control.max_steps;
+  int budget = sysfs_led_get_budget_steps(self, t);
+
+  if( budget > 0 && limit > budget )
+    limit = budget;
+
+  int spare = limit - count;
+
+  if( spare < 0 )
+    spare = 0;
+
+  size_t k = 0;
+
+  for( int i = 0; i < count; ++i ) {
+    const led_keyframe_t *cur = &frames[i];
+    const led_keyframe_t *nxt = &frames[(i + 1) % count];
+
+    int n = 1;
+
+    if( smooth && cur->interp == LED_INTERP_LINEAR ) {
+      int extra = duration[i] / s - 1;
+      if( want > spare )
+        extra = extra * spare / want;
+      n += extra;
+    }
+
+    for( int m = 0; m < n; ++m ) {
+      int a = duration[i] * m / n;
+      int e = duration[i] * (m + 1) / n;
+
+      ramp->color[k][0] = (uint8_t)(cur->r + (nxt->r - cur->r) * m / n);
+      ramp->color[k][1] = (uint8_t)(cur->g + (nxt->g - cur->g) * m / n);
+      ramp->color[k][2] = (uint8_t)(cur->b + (nxt->b - cur->b) * m / n);
+      ramp->value[k]    = 255;
+      ramp->duration[k] = e - a;
+      ++k;
+    }
+  }
+
+  /* After the last cycle the led is left at the color the
+   * last keyframe ends with */
+  const led_keyframe_t *last = &frames[count - 1];
+  if( smooth && last->interp == LED_INTERP_LINEAR )
+    last = &frames[0];
+
+  ramp->final[0] = (uint8_t)last->r;
+  ramp->final[1] = (uint8_t)last->g;
+  ramp->final[2] = (uint8_t)last->b;
+
+  ramp->step    = SYSFS_LED_NO_STEP;
+  ramp->colored = true;
+  ramp->repeat  = repeat;
+  ramp->delay   = s;
+  ramp->steps   = k;
+
+  mce_log(LL_DEBUG, "keyframes=%d, repeat=%d", count, repeat);
+
+  sysfs_led_finish_ramp(ramp);
+}
+
+/** Compile requested keyframe sequence for use from breathing timer
+ */
+static void
+sysfs_led_generate_ramp_sequence(sysfs_led_t *self)
+{
+  sysfs_led_compile_sequence(self, &self->breathe, self->frames,
+                             self->frame_count, self->frame_repeat);
+}
+
+/** Check if led engine timer is active
+ */
+static bool
+sysfs_led_timer_is_active(const sysfs_led_timer_t *timer)
+{
+  return timer->func != 0;
+}
+
+/** Schedule led engine timer
+ *
+ * @param timer    timer slot
+ * @param due      monotonic time stamp [ms] when the timer is due
+ * @param func     function to call
+ * @param flexible true if the timer can be dispatched slightly early
+ */
+static void
+sysfs_led_timer_start(sysfs_led_timer_t *timer, int64_t due,
+                      sysfs_led_timer_fn func, bool flexible)
+{
+  timer->due      = due;
+  timer->func     = func;
+  timer->flexible = flexible;
+  sysfs_led_sched_rethink();
+}
+
+/** Cancel led engine timer
+ */
+static void
+sysfs_led_timer_stop(sysfs_led_timer_t *timer)
+{
+  if( timer->func ) {
+    timer->func = 0;
+    sysfs_led_sched_rethink();
+  }
+}
+
+/** Call led engine timer function if it is due
+ *
+ * Flexible timers that are due within the coalescing window are
+ * dispatched early - with time stamp of the original due time so
+ * that timeline evaluation picks the intended step.
+ */
+static void
+sysfs_led_sched_dispatch(sysfs_led_t *self, sysfs_led_timer_t *timer,
+                         int64_t now)
+{
+  sysfs_led_timer_fn func = timer->func;
+
+  if( !func )
+    goto cleanup;
+
+  int64_t limit = now;
+  if( timer->flexible )
+    limit += SYSFS_LED_COALESCE_WINDOW;
+
+  if( timer->due > limit )
+    goto cleanup;
+
+  /* Clear before calling so that the function can reschedule */
+  timer->func = 0;
+  func(self, timer->due > now ? timer->due : now);
+
+cleanup:
+
+  return;
+}
+
+/** Obtain led engine lock
+ *
+ * The lock is recursive. Backends must hold it when touching
+ * state that is also used from led engine timer callbacks.
+ */
+void
+sysfs_led_lock(void)
+{
+  pthread_mutex_lock(&sysfs_led_mutex);
+}
+
+/** Release led engine lock
+ */
+void
+sysfs_led_unlock(void)
+{
+  pthread_mutex_unlock(&sysfs_led_mutex);
+}
+
+/** Shared scheduler timer callback
+ *
+ * Dispatches due led engine timers of all instances.
+ *
+ * Note: Depending on timer backend, this can be called from
+ * a worker thread.
+ */
+static void
+sysfs_led_sched_fire(void)
+{
+  sysfs_led_lock();
+
+  sysfs_led_wakeups.count += 1;
+
+  int64_t now = led_util_get_tick();
+
+  for( sysfs_led_t *self = sysfs_led_instances; self; self = self->next ) {
+    sysfs_led_sched_dispatch(self, &self->stop_timer, now);
+    sysfs_led_sched_dispatch(self, &self->step_timer, now);
+    sysfs_led_sched_dispatch(self, &self->slice_timer, now);
+  }
+
+  sysfs_led_sched_rethink();
+
+  sysfs_led_unlock();
+}
+
+/** Reprogram shared scheduler timer to match the earliest led timer
+ */
+static void
+sysfs_led_sched_rethink(void)
+{
+  bool    have = false;
+  int64_t due  = 0;
+
+  for( sysfs_led_t *self = sysfs_led_instances; self; self = self->next ) {
+    sysfs_led_timer_t *timers[] = {
+      &self->stop_timer, &self->step_timer, &self->slice_timer
+    };
+    for( size_t i = 0; i < G_N_ELEMENTS(timers); ++i ) {
+      if( !sysfs_led_timer_is_active(timers[i]) )
+        continue;
+      if( !have || due > timers[i]->due )
+        due = timers[i]->due;
+      have = true;
+    }
+  }
+
+  /* Led engine used without explicit timer selection */
+  if( have && !led_timer_is_ready() )
+    led_timer_init(LED_TIMER_GLIB, sysfs_led_sched_fire);
+
+  if( have )
+    led_timer_arm(due);
+  else
+    led_timer_disarm();
+}
+
+/** Select timer backend for the shared scheduler
+ *
+ * The virtual backend is meant to be used together with a virtual
+ * clock (see led_util_set_clock()) for evaluating led engine timing
+ * deterministically: the driver advances the clock to the time
+ * returned by led_timer_get_due() and calls led_timer_run().
+ *
+ * If the requested backend can't be used, glib timers are used.
+ *
+ * Note: Must not be called with led engine lock held.
+ *
+ * @param type timer backend to use
+ *
+ * @return true if requested backend was taken in use, false otherwise
+ */
+bool
+sysfs_led_sched_select(led_timer_type_t type)
+{
+  bool ack = led_timer_init(type, sysfs_led_sched_fire);
+
+  if( !ack && type != LED_TIMER_GLIB ) {
+    mce_log(LL_WARN, "falling back to glib led timer");
+    led_timer_init(LED_TIMER_GLIB, sysfs_led_sched_fire);
+  }
+
+  sysfs_led_lock();
+  sysfs_led_sched_rethink();
+  sysfs_led_unlock();
+
+  return ack;
+}
+
+/** Restart breathing timeline
+ *
+ * @param start monotonic time stamp [ms] of the 1st step
+ */
+static void
+sysfs_led_reset_phase(sysfs_led_t *self, int64_t start)
+{
+  self->breathe.start = start;
+  self->breathe.step  = SYSFS_LED_NO_STEP;
+}
+
+/** Lookup breathing step that covers given position in cycle
+ *
+ * @param phase offset from beginning of breathing cycle [ms]
+ *
+ * @return breathing step index
+ */
+static size_t
+sysfs_led_find_step(sysfs_led_t *self, int phase)
+{
+  size_t lo = 0;
+  size_t hi = self->breathe.steps;
+
+  while( hi - lo > 1 ) {
+    size_t i = (lo + hi) / 2;
+    if( self->breathe.offset[i] <= phase )
+      lo = i;
+    else
+      hi = i;
+  }
+
+  return lo;
+}
+
+/** Align breathing timer deadline to timer slack grid
+ *
+ * When timer slack is configured, deadlines are rounded up to
+ * multiples of it on the monotonic clock - so that our wakeups
+ * coincide with each other and with other timers using similar
+ * alignment. As the breathing phase is evaluated from the timeline,
+ * the rounding does not accumulate.
+ *
+ * @param deadline monotonic time stamp [ms] of the next step
+ * @param limit    alignment must not postpone wakeup past this
+ *
+ * @return adjusted deadline
+ */
+static int64_t
+sysfs_led_align_deadline(int64_t deadline, int64_t limit)
+{
+  int slack = QUIRK(QUIRK_TIMER_SLACK, 0);
+
+  if( slack > 1 ) {
+    int64_t aligned = (deadline + slack - 1) / slack * slack;
+    if( aligned < limit )
+      deadline = aligned;
+  }
+
+  return deadline;
+}
+
+/** Set led color without touching blinking state
+ */
+static void
+sysfs_led_update(sysfs_led_t *self)
+{
+  // get configured color
+  int r = self->curr.r;
+  int g = self->curr.g;
+  int b = self->curr.b;
+
+  // adjust by brightness level
+  int l = self->curr.level;
+
+  r = led_util_scale_value(r, l);
+  g = led_util_scale_value(g, l);
+  b = led_util_scale_value(b, l);
+
+  // set led color
+  sysfs_led_set_rgb_value(self, r, g, b);
+}
+
+/** Timer callback for setting led color
+ */
+static void
+sysfs_led_update_cb(sysfs_led_t *self, int64_t now)
+{
+  (void) now;
+
+  sysfs_led_update(self);
+}
+
+/** Set led to configured static/blinking state
+ */
+static void
+sysfs_led_static(sysfs_led_t *self)
+{
+  // set led blinking and color
+  sysfs_led_set_rgb_blink(self, self->curr.on, self->curr.off);
+  sysfs_led_update(self);
+}
+
+/** Timer callback for setting led
+ */
+static void
+sysfs_led_static_cb(sysfs_led_t *self, int64_t now)
+{
+  (void) now;
+
+  sysfs_led_static(self);
+}
+
+/** Timer callback for taking a led breathing step
+ *
+ * The step to apply is evaluated from breathing timeline, i.e. late
+ * wakeups skip directly to the correct step. As step lengths can vary,
+ * each step reschedules the timer for the next one.
+ *
+ * @param now time stamp to evaluate the timeline at
+ */
+static void
+sysfs_led_step_cb(sysfs_led_t *self, int64_t now)
+{
+  if( self->breathe.cycle <= 0 ) {
+    goto cleanup;
+  }
+
+  // locate current step on the timeline
+  int64_t elapsed = now - self->breathe.start;
+
+  if( elapsed < 0 )
+    elapsed = 0;
+
+  if( self->breathe.repeat > 0 &&
+      elapsed >= (int64_t)self->breathe.repeat * self->breathe.cycle ) {
+    // sequence has been played through - leave led at final color
+    int l = self->curr.level;
+    sysfs_led_set_rgb_value(self,
+                            led_util_scale_value(self->breathe.final[0], l),
+                            led_util_scale_value(self->breathe.final[1], l),
+                            led_util_scale_value(self->breathe.final[2], l));
+    goto cleanup;
+  }
+
+  int64_t base  = now - elapsed % self->breathe.cycle;
+  int     phase = (int)(now - base);
+  size_t  i     = sysfs_led_find_step(self, phase);
+  size_t  prev  = self->breathe.step;
+  bool    fade  = now < self->fade_start + self->fade_len;
+
+  if( !fade && self->fade_len > 0 ) {
+    // cross-fade finished - make sure the step gets fully applied
+    self->fade_len = 0;
+    prev = SYSFS_LED_NO_STEP;
+  }
+
+  if( i == prev && !fade ) {
+    // woke up early - do not repeat the same step
+    goto reschedule;
+  }
+
+  if( prev != SYSFS_LED_NO_STEP && prev != i ) {
+    size_t n = self->breathe.steps;
+    size_t skipped = (i + n - prev - 1) % n;
+    if( skipped > 0 )
+      mce_log(LL_DEBUG, "late by %zu steps", skipped);
+  }
+
+  self->breathe.step = i;
+
+  // get configured color
+  int r = self->curr.r;
+  int g = self->curr.g;
+  int b = self->curr.b;
+
+  if( self->breathe.colored ) {
+    // keyframe sequence step color
+    r = self->breathe.color[i][0];
+    g = self->breathe.color[i][1];
+    b = self->breathe.color[i][2];
+  }
+
+  // adjust by brightness level
+  int l = self->curr.level;
+
+  r = led_util_scale_value(r, l);
+  g = led_util_scale_value(g, l);
+  b = led_util_scale_value(b, l);
+
+  // adjust by curve position
+  int v = self->breathe.value[i];
+
+  r = led_util_scale_value(r, v);
+  g = led_util_scale_value(g, v);
+  b = led_util_scale_value(b, v);
+
+  // blend with the color shown before cross-fade
+  if( fade ) {
+    int w = (int)((now - self->fade_start) * 255 / self->fade_len);
+    r = self->fade_from[0] + (r - self->fade_from[0]) * w / 255;
+    g = self->fade_from[1] + (g - self->fade_from[1]) * w / 255;
+    b = self->fade_from[2] + (b - self->fade_from[2]) * w / 255;
+  }
+
+  // set led color
+  sysfs_led_set_rgb_value(self, r, g, b);
+
+reschedule:
+  {
+    // schedule the next step
+    size_t  j        = (i + 1) % self->breathe.steps;
+    int64_t deadline = base + self->breathe.offset[i] +
+                       self->breathe.duration[i];
+    int64_t limit    = deadline + self->breathe.duration[j];
+
+    deadline = sysfs_led_align_deadline(deadline, limit);
+
+    // cross-fade needs steps even if the table does not
+    if( fade && deadline > now + self->control.step_delay )
+      deadline = now + self->control.step_delay;
+
+    sysfs_led_timer_start(&self->step_timer, deadline,
+                          sysfs_led_step_cb, true);
+  }
+
+cleanup:
+
+  return;
+}
+
+/** Stop current led pattern and start the next one
+ */
+static void
+sysfs_led_stop(sysfs_led_t *self)
+{
+  bool has_color = led_state_has_color(&self->curr);
+
+  if( self->reset_blinking ) {
+    // blinking off - must be followed by rgb set to have an effect
+    sysfs_led_set_rgb_blink(self, 0, 0);
+  }
+
+  if( self->reset_blinking || !has_color ) {
+    // set rgb to black
+    sysfs_led_set_rgb_value(self, 0, 0, 0);
+    self->reset_blinking = false;
+  }
+
+  if( !has_color ) {
+    // nothing more to do
+  }
+  else if( self->breathe.delay > 0 ) {
+    // start breathing timer
+    int64_t start = led_util_get_tick() + self->breathe.delay;
+    sysfs_led_reset_phase(self, start);
+    sysfs_led_timer_start(&self->step_timer, start,
+                          sysfs_led_step_cb, false);
+  }
+  else {
+    // set rgb to target - after kernel settle delay if needed
+    int delay = sysfs_led_get_settle(self);
+
+    if( delay > 0 )
+      sysfs_led_timer_start(&self->step_timer,
+                            led_util_get_tick() + delay,
+                            sysfs_led_static_cb, false);
+    else
+      sysfs_led_static(self);
+  }
+}
+
+/** Timer callback from stopping/restarting led
+ */
+static void
+sysfs_led_stop_cb(sysfs_led_t *self, int64_t now)
+{
+  (void) now;
+
+  sysfs_led_stop(self);
+}
+
+/** Apply color change in place
+ *
+ * @param blink true if blinking config needs to be re-applied too
+ */
+static void
+sysfs_led_apply(sysfs_led_t *self, bool blink)
+{
+  /* Pending stop/static/breathing timer uses the
+   * current state -> no need to do anything now */
+  if( sysfs_led_timer_is_active(&self->stop_timer) ||
+      sysfs_led_timer_is_active(&self->step_timer) ) {
+    goto cleanup;
+  }
+
+  int delay = sysfs_led_get_settle(self);
+
+  if( delay > 0 ) {
+    sysfs_led_timer_start(&self->step_timer,
+                          led_util_get_tick() + delay,
+                          blink ? sysfs_led_static_cb
+                          :       sysfs_led_update_cb, false);
+  }
+  else if( blink ) {
+    sysfs_led_static(self);
+  }
+  else {
+    sysfs_led_update(self);
+  }
+
+cleanup:
+
+  return;
+}
+
+/** Restart led pattern from scratch
+ *
+ * @param prev led state before the change
+ */
+static void
+sysfs_led_restart(sysfs_led_t *self, const led_state_t *prev)
+{
+  led_style_t old_style = led_state_get_style(prev);
+  led_style_t new_style = led_state_get_style(&self->curr);
+
+  // stop existing breathing timer
+  sysfs_led_timer_stop(&self->step_timer);
+
+  // re-evaluate breathing constants
+  self->breathe.step  = SYSFS_LED_NO_STEP;
+  self->breathe.delay = 0;
+  self->breathe.cycle = 0;
+  self->breathe.colored = false;
+  self->breathe.repeat  = 0;
+  if( new_style == STYLE_BREATH ) {
+    sysfs_led_generate_ramp(self, &self->breathe,
+                            self->curr.on, self->curr.off);
+  }
+  else if( new_style == STYLE_SEQUENCE ) {
+    if( self->stack_top && self->curr.sequence == self->stack_seq )
+      self->breathe = self->stack_top->table;
+    else
+      sysfs_led_generate_ramp_sequence(self);
+  }
+
+  if( old_style == STYLE_BLINK || new_style == STYLE_BLINK )
+    self->reset_blinking = true;
+
+  /* Schedule led off after kernel settle timeout; once that
+   * is done, new led color/blink/breathing will be started.
+   * If the backend is not busy, do it immediately. */
+  if( !sysfs_led_timer_is_active(&self->stop_timer) ) {
+    int delay = sysfs_led_get_settle(self);
+
+    if( delay > 0 )
+      sysfs_led_timer_start(&self->stop_timer,
+                            led_util_get_tick() + delay,
+                            sysfs_led_stop_cb, false);
+    else
+      sysfs_led_stop(self);
+  }
+}
+
+/** Start static/blinking/breathing led
+ */
+static void
+sysfs_led_start(sysfs_led_t *self, const led_state_t *next)
+{
+  led_state_t work = *next;
+
+  self->want = work;
+
+  led_state_sanitize(&work, self->control.step_delay);
+
+  /* While display is off, replace patterns that need timer
+   * wakeups with something the backend can do autonomously */
+  bool downgraded = sysfs_led_downgrade(self, &work);
+  if( downgraded )
+    led_state_sanitize(&work, self->control.step_delay);
+
+  sysfs_led_downgrade_account(self, downgraded);
+
+  led_change_t change = led_state_get_change(&self->curr, &work);
+
+  if( change == CHANGE_NONE ) {
+    goto cleanup;
+  }
+
+  mce_log(LL_DEBUG, "change = %s", led_change_repr(change));
+
+  led_state_t prev = self->curr;
+  self->curr = work;
+
+  if( change == CHANGE_TIMING || change == CHANGE_STYLE ) {
+    /* Assumption: Before changing the led state, we need to wait
+     * a bit for kernel side to finish with last change we made and
+     * then possibly reset the blinking status and wait a bit more */
+    sysfs_led_restart(self, &prev);
+    goto cleanup;
+  }
+
+  /* Only color and/or brightness level changes -> the cheaper
+   * in place update can be used */
+  switch( led_state_get_style(&work) ) {
+  case STYLE_STATIC:
+    /* Just the color needs to be updated */
+    sysfs_led_apply(self, false);
+    break;
+
+  case STYLE_BLINK:
+    /* Blink timing stays the same, but backends might need
+     * blinking config to be re-applied along with color. */
+    sysfs_led_apply(self, true);
+    break;
+
+  case STYLE_BREATH:
+    /* Breathing timer keeps the updates far enough from each
+     * other and picks up the changes on the next step. If only
+     * the als-based brightness level changes, we need to adjust
+     * the breathing amplitude without affecting the phase. */
+    if( change != CHANGE_LEVEL )
+      sysfs_led_reset_phase(self, led_util_get_tick());
+    break;
+
+  case STYLE_SEQUENCE:
+    /* Only brightness level can change without restarting the
+     * sequence - it gets picked up on the next step. A finished
+     * sequence does not take further steps, so the final color
+     * needs to be re-applied at the new level. */
+    if( !sysfs_led_timer_is_active(&self->step_timer) &&
+        !sysfs_led_timer_is_active(&self->stop_timer) )
+      sysfs_led_step_cb(self, led_util_get_tick());
+    break;
+
+  default:
+    /* Led stays off */
+    break;
+  }
+
+cleanup:
+
+  return;
+}
+
+/** Wait for kernel side to settle from the last change made
+ *
+ * Blocks only if the backend needs settle time and the last
+ * change was made less than settle time ago - which should be
+ * a rare occurrence during shutdown.
+ */
+static void
+sysfs_led_wait_kernel(sysfs_led_t *self)
+{
+  int delay = sysfs_led_get_settle(self);
+
+  if( delay > 0 ) {
+    mce_log(LL_DEBUG, "wait %d ms for kernel to settle", delay);
+    struct timespec ts = { delay / 1000, (delay % 1000) * 1000000l };
+    TEMP_FAILURE_RETRY(nanosleep(&ts, &ts));
+  }
+}
+
+/** Check if led patterns should be downgraded right now
+ *
+ * @return true if display is off and downgrading is not disabled
+ */
+static bool
+sysfs_led_downgrade_enabled(const sysfs_led_t *self)
+{
+  int policy = QUIRK(QUIRK_DISPLAY_OFF_POLICY, SYSFS_LED_DOWNGRADE_BLINK);
+
+  return self->lowpower && policy != SYSFS_LED_DOWNGRADE_NONE;
+}
+
+/** Get intensity of the brightest color component of a keyframe
+ */
+static int
+sysfs_led_keyframe_peak(const led_keyframe_t *frame)
+{
+  int v = frame->r;
+  if( v < frame->g ) v = frame->g;
+  if( v < frame->b ) v = frame->b;
+  return v;
+}
+
+/** Replace keyframe sequence with blinking of similar appearance
+ *
+ * The brightest keyframe color is used, and keyframes that are at
+ * least half as bright make up the on period.
+ *
+ * @param state led state using keyframe sequence
+ *
+ * @return true if state was changed, false otherwise
+ */
+static bool
+sysfs_led_downgrade_sequence(const sysfs_led_t *self, led_state_t *state)
+{
+  bool                  ack    = false;
+  const led_keyframe_t *frames = self->frames;
+  int                   count  = self->frame_count;
+
+  if( self->stack_top && state->sequence == self->stack_seq ) {
+    frames = self->stack_top->frames;
+    count  = self->stack_top->frame_count;
+  }
+  else if( self->frame_repeat > 0 ) {
+    /* Finite sequences are left to run to completion */
+    goto cleanup;
+  }
+
+  int peak = 0;
+  int best = 0;
+
+  for( int i = 0; i < count; ++i ) {
+    int v = sysfs_led_keyframe_peak(frames + i);
+    if( peak < v )
+      peak = v, best = i;
+  }
+
+  state->r   = state->g = state->b = 0;
+  state->on  = 0;
+  state->off = 0;
+
+  for( int i = 0; peak > 0 && i < count; ++i ) {
+    int v = sysfs_led_keyframe_peak(frames + i);
+    if( 2 * v >= peak )
+      state->on  += frames[i].duration;
+    else
+      state->off += frames[i].duration;
+  }
+
+  if( peak > 0 ) {
+    state->r = frames[best].r;
+    state->g = frames[best].g;
+    state->b = frames[best].b;
+  }
+
+  state->breathe  = false;
+  state->sequence = 0;
+
+  ack = true;
+
+cleanup:
+
+  return ack;
+}
+
+/** Replace led pattern with one that does not need timer wakeups
+ *
+ * Breathing and keyframe sequences are turned into hw blinking, or
+ * into static color if the backend can't blink by itself. Backends
+ * that emulate blinking via hard step breathing keep doing that, as
+ * it takes only two wakeups per cycle.
+ *
+ * @param state sanitized led state
+ *
+ * @return true if state was changed, false otherwise
+ */
+static bool
+sysfs_led_downgrade(const sysfs_led_t *self, led_state_t *state)
+{
+  bool ack    = false;
+  int  policy = QUIRK(QUIRK_DISPLAY_OFF_POLICY, SYSFS_LED_DOWNGRADE_BLINK);
+
+  if( !sysfs_led_downgrade_enabled(self) ) {
+    goto cleanup;
+  }
+
+  bool hw_blink = (policy == SYSFS_LED_DOWNGRADE_BLINK &&
+                   self->control.blink != 0);
+  bool sw_blink = (policy == SYSFS_LED_DOWNGRADE_BLINK &&
+                   led_control_breath_type(&self->control) == LED_RAMP_HARD_STEP);
+
+  switch( led_state_get_style(state) ) {
+  case STYLE_BREATH:
+    if( sw_blink && !hw_blink )
+      goto cleanup;
+    break;
+
+  case STYLE_SEQUENCE:
+    if( !sysfs_led_downgrade_sequence(self, state) )
+      goto cleanup;
+    break;
+
+  default:
+    goto cleanup;
+  }
+
+  if( hw_blink ) {
+    state->breathe = false;
+  }
+  else if( sw_blink ) {
+    state->breathe = true;
+  }
+  else {
+    state->on      = 0;
+    state->off     = 0;
+    state->breathe = false;
+  }
+
+  ack = true;
+
+cleanup:
+
+  return ack;
+}
+
+/** Update counters tracking time spent with downgraded patterns
+ *
+ * @param downgraded true if downgraded pattern is being shown
+ */
+static void
+sysfs_led_downgrade_account(sysfs_led_t *self, bool downgraded)
+{
+  int64_t now = led_util_get_tick();
+
+  if( downgraded && !self->downgrade_start ) {
+    mce_log(LL_DEBUG, "led pattern downgraded");
+    self->downgrade_start = now;
+    self->downgrade_count += 1;
+  }
+  else if( !downgraded && self->downgrade_start ) {
+    mce_log(LL_DEBUG, "led pattern restored");
+    self->downgrade_time += now - self->downgrade_start;
+    self->downgrade_start = 0;
+  }
+}
+
+/** Allocate id for a new keyframe sequence
+ *
+ * A new id makes the sequence restart even if the keyframes
+ * are the same as before.
+ */
+static unsigned
+sysfs_led_next_sequence(sysfs_led_t *self)
+{
+  if( ++self->sequence_id == 0 )
+    ++self->sequence_id;
+
+  return self->sequence_id;
+}
+
+/** Lookup stacked pattern by name
+ *
+ * @return pattern, or NULL if not registered
+ */
+static sysfs_led_pattern_t *
+sysfs_led_stack_find(sysfs_led_t *self, const char *name)
+{
+  sysfs_led_pattern_t *pattern = self->stack;
+
+  while( pattern && strcmp(pattern->name, name) )
+    pattern = pattern->next;
+
+  return pattern;
+}
+
+/** Choose stacked pattern to show
+ *
+ * Active patterns with the highest priority are shown. If there
+ * are several of those, they take turns in registration order.
+ *
+ * @param rotate true to move on to the next pattern in turn
+ * @param peers  where to store number of patterns taking turns
+ *
+ * @return pattern to show, or NULL if no patterns are active
+ */
+static sysfs_led_pattern_t *
+sysfs_led_stack_pick(sysfs_led_t *self, bool rotate, int *peers)
+{
+  sysfs_led_pattern_t *first   = 0;
+  sysfs_led_pattern_t *after   = 0;
+  bool                 current = false;
+  bool                 have    = false;
+  int                  top     = 0;
+
+  *peers = 0;
+
+  for( sysfs_led_pattern_t *iter = self->stack; iter; iter = iter->next ) {
+    if( iter->active && (!have || top < iter->priority) )
+      top = iter->priority, have = true;
+  }
+
+  for( sysfs_led_pattern_t *iter = self->stack; iter; iter = iter->next ) {
+    if( !iter->active || iter->priority != top )
+      continue;
+
+    *peers += 1;
+
+    if( !first )
+      first = iter;
+
+    if( iter == self->stack_top )
+      current = true;
+    else if( current && !after )
+      after = iter;
+  }
+
+  if( !current )
+    return first;
+
+  if( !rotate )
+    return self->stack_top;
+
+  return after ? after : first;
+}
+
+/** Switch to showing another stacked pattern
+ *
+ * The precompiled table is taken in use without going through
+ * led stop / kernel settle / restart, and the change is smoothed
+ * with a cross-fade from the color that is currently shown.
+ */
+static void
+sysfs_led_stack_switch(sysfs_led_t *self)
+{
+  int64_t now = led_util_get_tick();
+
+  for( size_t i = 0; i < G_N_ELEMENTS(self->fade_from); ++i )
+    self->fade_from[i] = self->shown[i];
+
+  self->fade_start = now;
+  self->fade_len   = 0;
+
+  if( led_control_can_breathe(&self->control) )
+    self->fade_len = SYSFS_LED_CROSSFADE_TIME;
+
+  self->breathe = self->stack_top->table;
+  sysfs_led_reset_phase(self, now);
+
+  sysfs_led_timer_start(&self->step_timer, now, sysfs_led_step_cb, false);
+}
+
+/** Re-evaluate what the led should show
+ *
+ * @param rotate true if time slice of the current pattern has ended
+ */
+static void
+sysfs_led_stack_select(sysfs_led_t *self, bool rotate)
+{
+  int                  peers = 0;
+  sysfs_led_pattern_t *prev  = self->stack_top;
+  sysfs_led_pattern_t *next  = sysfs_led_stack_pick(self, rotate, &peers);
+
+  if( !next ) {
+    /* Nothing stacked -> show the plain pattern */
+    self->stack_top = 0;
+    sysfs_led_timer_stop(&self->slice_timer);
+    sysfs_led_start(self, &self->base);
+    goto cleanup;
+  }
+
+  if( next == prev ) {
+    /* Keep showing the same pattern, but follow brightness level */
+    led_state_t req = self->want;
+    req.level = self->base.level;
+    sysfs_led_start(self, &req);
+  }
+  else if( prev && self->curr.sequence == self->stack_seq ) {
+    /* From one stacked pattern to another */
+    mce_log(LL_DEBUG, "switch to pattern: %s", next->name);
+    self->stack_top = next;
+    sysfs_led_stack_switch(self);
+    sysfs_led_timer_stop(&self->slice_timer);
+  }
+  else {
+    /* From plain pattern to stacked pattern */
+    mce_log(LL_DEBUG, "start pattern: %s", next->name);
+    self->stack_top = next;
+    self->stack_seq = sysfs_led_next_sequence(self);
+
+    led_state_t req = self->base;
+    req.on       = 0;
+    req.off      = 0;
+    req.sequence = self->stack_seq;
+    sysfs_led_start(self, &req);
+    sysfs_led_timer_stop(&self->slice_timer);
+  }
+
+  if( peers < 2 || sysfs_led_downgrade_enabled(self) ) {
+    /* No rotation needed, or not worth the wakeups */
+    sysfs_led_timer_stop(&self->slice_timer);
+  }
+  else if( !sysfs_led_timer_is_active(&self->slice_timer) ) {
+    sysfs_led_timer_start(&self->slice_timer,
+                          led_util_get_tick() + next->slice,
+                          sysfs_led_stack_slice_cb, false);
+  }
+
+cleanup:
+
+  return;
+}
+
+/** Timer callback for rotating stacked patterns of equal priority
+ */
+static void
+sysfs_led_stack_slice_cb(sysfs_led_t *self, int64_t now)
+{
+  (void) now;
+
+  sysfs_led_stack_select(self, true);
+}
+
+/** Move stacked patterns from one led engine instance to another
+ *
+ * Used when a led backend gets replaced, so that patterns registered
+ * via the old instance remain available. Step tables depend on the
+ * led control backend and are compiled again from the keyframes.
+ *
+ * @param self instance to move patterns to
+ * @param from instance to move patterns from
+ */
+static void
+sysfs_led_stack_adopt(sysfs_led_t *self, sysfs_led_t *from)
+{
+  sysfs_led_pattern_t **tail = &self->stack;
+
+  while( *tail )
+    tail = &(*tail)->next;
+
+  *tail = from->stack;
+  from->stack     = 0;
+  from->stack_top = 0;
+  sysfs_led_timer_stop(&from->slice_timer);
+
+  for( sysfs_led_pattern_t *iter = *tail; iter; iter = iter->next ) {
+    sysfs_led_compile_sequence(self, &iter->table,
+                               iter->frames, iter->frame_count, 0);
+  }
+
+  sysfs_led_stack_select(self, false);
+}
+
+/** Read led energy model value from config
+ *
+ * @param key   config key
+ * @param def   default value
+ * @param scale multiplier for converting to integer units
+ *
+ * @return configured value scaled to integer, or def if not set
+ */
+static int
+sysfs_led_energy_config(const char *key, int def, double scale)
+{
+  int    res = def;
+  gchar *val = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                        key, 0);
+
+  if( val ) {
+    char  *end = 0;
+    double num = strtod(val, &end);
+
+    if( end > val && num >= 0 )
+      res = (int)(num * scale + 0.5);
+    else
+      mce_log(LL_WARN, "%s: invalid value '%s'", key, val);
+  }
+
+  g_free(val);
+
+  return res;
+}
+
+/** Load optional led energy model from config
+ */
+static void
+sysfs_led_energy_init(sysfs_led_t *self)
+{
+  static const char * const keys[3] =
+  {
+    MCE_CONF_LED_CONFIG_HYBRIS_RED_CURRENT,
+    MCE_CONF_LED_CONFIG_HYBRIS_GREEN_CURRENT,
+    MCE_CONF_LED_CONFIG_HYBRIS_BLUE_CURRENT,
+  };
+
+  for( size_t i = 0; i < G_N_ELEMENTS(keys); ++i )
+    self->current[i] = sysfs_led_energy_config(keys[i], 0, 1000.0);
+
+  self->wakeup_charge =
+    sysfs_led_energy_config(MCE_CONF_LED_CONFIG_HYBRIS_WAKEUP_CHARGE,
+                            SYSFS_LED_WAKEUP_CHARGE, 1.0);
+}
+
+/** Estimate led current while showing given color
+ *
+ * Assumes that current is proportional to channel intensity.
+ *
+ * @param r red intensity, scaled by brightness level
+ * @param g green intensity, scaled by brightness level
+ * @param b blue intensity, scaled by brightness level
+ *
+ * @return led current [uA]
+ */
+static int64_t
+sysfs_led_energy_color(const sysfs_led_t *self, int r, int g, int b)
+{
+  return ((int64_t)self->current[0] * r +
+          (int64_t)self->current[1] * g +
+          (int64_t)self->current[2] * b) / 255;
+}
+
+/** Estimate average currents of a pattern driven from step table
+ *
+ * @param ramp   compiled step table
+ * @param state  led state using the table
+ * @param led_ua where to store average led current [uA]
+ * @param cpu_ua where to store average cpu wakeup current [uA]
+ */
+static void
+sysfs_led_energy_ramp(const sysfs_led_t *self, const sysfs_led_ramp_t *ramp,
+                      const led_state_t *state, int *led_ua, int *cpu_ua)
+{
+  int64_t charge = 0; // [uA * ms]
+
+  *led_ua = 0;
+  *cpu_ua = 0;
+
+  if( ramp->cycle <= 0 ) {
+    goto cleanup;
+  }
+
+  for( size_t i = 0; i < ramp->steps; ++i ) {
+    int r = state->r;
+    int g = state->g;
+    int b = state->b;
+
+    if( ramp->colored ) {
+      r = ramp->color[i][0];
+      g = ramp->color[i][1];
+      b = ramp->color[i][2];
+    }
+
+    int v = led_util_scale_value(ramp->value[i], state->level);
+
+    charge += ramp->duration[i] *
+      sysfs_led_energy_color(self,
+                             led_util_scale_value(r, v),
+                             led_util_scale_value(g, v),
+                             led_util_scale_value(b, v));
+  }
+
+  *led_ua = (int)(charge / ramp->cycle);
+  *cpu_ua = (int)((int64_t)ramp->steps * self->wakeup_charge * 1000 /
+                  ramp->cycle);
+
+cleanup:
+
+  return;
+}
+
+/** Estimate average currents needed for showing led state
+ *
+ * @param state  led state
+ * @param table  precompiled step table, or NULL to compile on demand
+ * @param led_ua where to store average led current [uA]
+ * @param cpu_ua where to store average cpu wakeup current [uA]
+ */
+static void
+sysfs_led_energy_estimate(sysfs_led_t *self, const led_state_t *state,
+                          const sysfs_led_ramp_t *table,
+                          int *led_ua, int *cpu_ua)
+{
+  sysfs_led_ramp_t *ramp = 0;
+
+  int r = led_util_scale_value(state->r, state->level);
+  int g = led_util_scale_value(state->g, state->level);
+  int b = led_util_scale_value(state->b, state->level);
+
+  *led_ua = 0;
+  *cpu_ua = 0;
+
+  switch( led_state_get_style(state) ) {
+  case STYLE_STATIC:
+    *led_ua = (int)sysfs_led_energy_color(self, r, g, b);
+    break;
+
+  case STYLE_BLINK:
+    /* Without hw blinking the led stays on */
+    *led_ua = (int)sysfs_led_energy_color(self, r, g, b);
+    if( self->control.blink )
+      *led_ua = (int)((int64_t)*led_ua * state->on /
+                      (state->on + state->off));
+    break;
+
+  case STYLE_BREATH:
+    if( !(ramp = calloc(1, sizeof *ramp)) )
+      break;
+    sysfs_led_generate_ramp(self, ramp, state->on, state->off);
+    sysfs_led_energy_ramp(self, ramp, state, led_ua, cpu_ua);
+    break;
+
+  case STYLE_SEQUENCE:
+    if( table )
+      sysfs_led_energy_ramp(self, table, state, led_ua, cpu_ua);
+    break;
+
+  default:
+    break;
+  }
+
+  free(ramp);
+}
+
+/** Create led engine instance
+ *
+ * The led control object is copied and owned by the instance from
+ * now on, i.e. it gets closed when the instance is deleted. The led
+ * is initially turned off.
+ *
+ * @param control probed led control backend
+ *
+ * @return led engine instance, or NULL on failure
+ */
+sysfs_led_t *
+sysfs_led_create(const led_control_t *control)
+{
+  sysfs_led_lock();
+
+  sysfs_led_t *self = calloc(1, sizeof *self);
+
+  if( !self ) {
+    goto cleanup;
+  }
+
+  self->control        = *control;
+  self->curr           = sysfs_led_initial;
+  self->base           = sysfs_led_initial;
+  self->breathe.step   = SYSFS_LED_NO_STEP;
+  self->reset_blinking = true;
+
+  sysfs_led_energy_init(self);
+
+  /* append to scheduler list */
+  sysfs_led_t **tail = &sysfs_led_instances;
+  while( *tail )
+    tail = &(*tail)->next;
+  *tail = self;
+
+  /* adjust current state to: color=black */
+  self->base.r = 0;
+  self->base.g = 0;
+  self->base.b = 0;
+  sysfs_led_start(self, &self->base);
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return self;
+}
+
+/** Delete led engine instance
+ *
+ * The led is turned off and the led control backend is closed.
+ *
+ * Waiting for kernel side to settle and closing the backend - which
+ * can involve joining the writer thread - are done only after the
+ * instance has been detached from the scheduler and the engine lock
+ * has been released, so that other instances are not stalled.
+ *
+ * @param self led engine instance, or NULL
+ */
+void
+sysfs_led_delete(sysfs_led_t *self)
+{
+  if( !self ) {
+    goto cleanup;
+  }
+
+  sysfs_led_lock();
+
+  // cancel timers
+  self->stop_timer.func  = 0;
+  self->step_timer.func  = 0;
+  self->slice_timer.func = 0;
+
+  // remove from scheduler list
+  for( sysfs_led_t **pos = &sysfs_led_instances; *pos; pos = &(*pos)->next ) {
+    if( *pos == self ) {
+      *pos = self->next;
+      break;
+    }
+  }
+
+  sysfs_led_sched_rethink();
+
+  sysfs_led_unlock();
+
+  // allow kernel side to settle down
+  sysfs_led_wait_kernel(self);
+
+  // blink off
+  sysfs_led_set_rgb_blink(self, 0, 0);
+
+  // zero brightness
+  sysfs_led_set_rgb_value(self, 0, 0, 0);
+
+  // close sysfs files
+  sysfs_led_close_files(&self->control);
+
+  // release stacked patterns
+  while( self->stack ) {
+    sysfs_led_pattern_t *pattern = self->stack;
+    self->stack = pattern->next;
+    free(pattern->name);
+    free(pattern);
+  }
+
+  free(self);
+
+cleanup:
+
+  return;
+}
+
+/** Set led engine instance color and timing
+ */
+void
+sysfs_led_object_set_pattern(sysfs_led_t *self, int r, int g, int b,
+                             int ms_on, int ms_off)
+{
+  sysfs_led_lock();
+
+  /* adjust requested state to: color & timing as requested */
+  self->base.r   = r;
+  self->base.g   = g;
+  self->base.b   = b;
+  self->base.on  = ms_on;
+  self->base.off = ms_off;
+  self->base.sequence = 0;
+  sysfs_led_stack_select(self, false);
+
+  sysfs_led_unlock();
+}
+
+/** Start keyframe sequence on led engine instance
+ *
+ * The keyframes are compiled into breathing step table once, after
+ * which the sequence runs without further requests.
+ *
+ * @param frames keyframes, colors in [0, 255] range
+ * @param count  number of keyframes
+ * @param repeat number of times to play the sequence, or 0 for forever
+ */
+void
+sysfs_led_object_set_sequence(sysfs_led_t *self, const led_keyframe_t *frames,
+                              int count, int repeat)
+{
+  sysfs_led_lock();
+
+  if( count > SYSFS_LED_KEYFRAMES_MAX )
+    count = SYSFS_LED_KEYFRAMES_MAX;
+
+  if( count < 1 ) {
+    /* empty sequence -> led off */
+    sysfs_led_object_set_pattern(self, 0, 0, 0, 0, 0);
+    goto cleanup;
+  }
+
+  for( int i = 0; i < count; ++i )
+    self->frames[i] = frames[i];
+
+  self->frame_count  = count;
+  self->frame_repeat = repeat > 0 ? repeat : 0;
+
+  /* adjust requested state to: sequence as requested */
+  self->base.on  = 0;
+  self->base.off = 0;
+  self->base.sequence = sysfs_led_next_sequence(self);
+  sysfs_led_stack_select(self, false);
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return;
+}
+
+/** Check if led engine instance supports sw breathing
+ */
+bool
+sysfs_led_object_can_breathe(const sysfs_led_t *self)
+{
+  return led_control_can_breathe(&self->control);
+}
+
+/** Enable/disable sw breathing of led engine instance
+ */
+void
+sysfs_led_object_set_breathing(sysfs_led_t *self, bool enable)
+{
+  sysfs_led_lock();
+
+  if( sysfs_led_object_can_breathe(self) ) {
+    /* adjust requested state to: breathing as requested */
+    self->base.breathe = enable;
+    sysfs_led_stack_select(self, false);
+  }
+
+  sysfs_led_unlock();
+}
+
+/** Set brightness level of led engine instance
+ */
+void
+sysfs_led_object_set_brightness(sysfs_led_t *self, int level)
+{
+  sysfs_led_lock();
+
+  /* adjust requested state to: brightness as requested */
+  self->base.level = level;
+  sysfs_led_stack_select(self, false);
+
+  sysfs_led_unlock();
+}
+
+/** Inform led engine instance about display power state
+ *
+ * While display is off, patterns that need frequent timer wakeups
+ * are downgraded according to QuirkDisplayOffPolicy. The requested
+ * patterns are restored when display is powered on again.
+ *
+ * @param on true if display is powered on, false otherwise
+ */
+void
+sysfs_led_object_set_display_state(sysfs_led_t *self, bool on)
+{
+  sysfs_led_lock();
+
+  if( self->lowpower == !on ) {
+    goto cleanup;
+  }
+
+  mce_log(LL_DEBUG, "display %s", on ? "on" : "off");
+  self->lowpower = !on;
+  sysfs_led_stack_select(self, false);
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return;
+}
+
+/** Estimate battery cost of a plain led pattern
+ *
+ * The pattern is evaluated at the current brightness level, as if
+ * it were set via sysfs_led_object_set_pattern(). Breathing curves
+ * are compiled the same way as when actually shown.
+ *
+ * @param breathe true to evaluate sw breathing instead of blinking
+ * @param led_ua  where to store average led current [uA], or -1 if
+ *                led currents are not configured
+ * @param cpu_ua  where to store average cpu current spent on led
+ *                timer wakeups [uA]
+ *
+ * @return true on success, false on failure
+ */
+bool
+sysfs_led_object_estimate_pattern(sysfs_led_t *self, int r, int g, int b,
+                                  int ms_on, int ms_off, bool breathe,
+                                  int *led_ua, int *cpu_ua)
+{
+  sysfs_led_lock();
+
+  led_state_t state = self->base;
+
+  state.r        = r;
+  state.g        = g;
+  state.b        = b;
+  state.on       = ms_on;
+  state.off      = ms_off;
+  state.breathe  = breathe && sysfs_led_object_can_breathe(self);
+  state.sequence = 0;
+
+  led_state_sanitize(&state, self->control.step_delay);
+  sysfs_led_energy_estimate(self, &state, 0, led_ua, cpu_ua);
+
+  if( !self->current[0] && !self->current[1] && !self->current[2] )
+    *led_ua = -1;
+
+  sysfs_led_unlock();
+
+  return true;
+}
+
+/** Estimate battery cost of a registered stacked pattern
+ *
+ * @param name    pattern name
+ * @param led_ua  where to store average led current [uA], or -1 if
+ *                led currents are not configured
+ * @param cpu_ua  where to store average cpu current spent on led
+ *                timer wakeups [uA]
+ *
+ * @return true on success, false if pattern is not registered
+ */
+bool
+sysfs_led_object_estimate_named(sysfs_led_t *self, const char *name,
+                                int *led_ua, int *cpu_ua)
+{
+  sysfs_led_lock();
+
+  bool                 ack     = false;
+  sysfs_led_pattern_t *pattern = sysfs_led_stack_find(self, name);
+
+  if( !pattern ) {
+    goto cleanup;
+  }
+
+  led_state_t state = self->base;
+
+  state.on       = 0;
+  state.off      = 0;
+  state.sequence = 1;
+
+  sysfs_led_energy_estimate(self, &state, &pattern->table, led_ua, cpu_ua);
+
+  if( !self->current[0] && !self->current[1] && !self->current[2] )
+    *led_ua = -1;
+
+  ack = true;
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return ack;
+}
+
+/** Register named pattern to the pattern stack
+ *
+ * The keyframes are compiled into a step table right away, so that
+ * activating the pattern later on is just a table switch. Registering
+ * an existing name replaces the pattern, but retains activity state.
+ *
+ * Active patterns preempt plain patterns and lower priority patterns.
+ * Active patterns of equal priority take turns, each one shown for
+ * its time slice before moving to the next.
+ *
+ * @param name     pattern name
+ * @param priority pattern priority, higher values win
+ * @param slice_ms time slice [ms], or 0 for default
+ * @param frames   keyframes, colors in [0, 255] range
+ * @param count    number of keyframes
+ *
+ * @return true on success, false on failure
+ */
+bool
+sysfs_led_object_pattern_register(sysfs_led_t *self, const char *name,
+                                  int priority, int slice_ms,
+                                  const led_keyframe_t *frames, int count)
+{
+  sysfs_led_lock();
+
+  bool                 ack     = false;
+  sysfs_led_pattern_t *pattern = 0;
+
+  if( !name || count < 1 || count > SYSFS_LED_KEYFRAMES_MAX ) {
+    goto cleanup;
+  }
+
+  if( !(pattern = sysfs_led_stack_find(self, name)) ) {
+    if( !(pattern = calloc(1, sizeof *pattern)) )
+      goto cleanup;
+
+    if( !(pattern->name = strdup(name)) ) {
+      free(pattern);
+      goto cleanup;
+    }
+
+    sysfs_led_pattern_t **tail = &self->stack;
+    while( *tail )
+      tail = &(*tail)->next;
+    *tail = pattern;
+  }
+
+  pattern->priority = priority;
+  pattern->slice    = slice_ms > 0 ? slice_ms : SYSFS_LED_DEFAULT_SLICE;
+  sysfs_led_compile_sequence(self, &pattern->table, frames, count, 0);
+
+  for( int i = 0; i < count; ++i )
+    pattern->frames[i] = frames[i];
+  pattern->frame_count = count;
+
+  if( pattern == self->stack_top && self->curr.sequence == self->stack_seq ) {
+    /* replaced while shown -> take the new table in use */
+    sysfs_led_stack_switch(self);
+  }
+
+  sysfs_led_stack_select(self, false);
+
+  ack = true;
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return ack;
+}
+
+/** Remove named pattern from the pattern stack
+ *
+ * @param name pattern name
+ *
+ * @return true on success, false if pattern was not registered
+ */
+bool
+sysfs_led_object_pattern_unregister(sysfs_led_t *self, const char *name)
+{
+  sysfs_led_lock();
+
+  bool ack = false;
+
+  for( sysfs_led_pattern_t **pos = &self->stack; *pos; pos = &(*pos)->next ) {
+    sysfs_led_pattern_t *pattern = *pos;
+
+    if( strcmp(pattern->name, name) )
+      continue;
+
+    *pos = pattern->next;
+
+    /* Move on to another pattern before releasing */
+    pattern->active = false;
+    sysfs_led_stack_select(self, false);
+
+    free(pattern->name);
+    free(pattern);
+
+    ack = true;
+    break;
+  }
+
+  sysfs_led_unlock();
+
+  return ack;
+}
+
+/** Activate/deactivate named pattern in the pattern stack
+ *
+ * @param name   pattern name
+ * @param active true to make the pattern a candidate for showing
+ *
+ * @return true on success, false if pattern was not registered
+ */
+bool
+sysfs_led_object_pattern_activate(sysfs_led_t *self, const char *name,
+                                  bool active)
+{
+  sysfs_led_lock();
+
+  bool                 ack     = false;
+  sysfs_led_pattern_t *pattern = sysfs_led_stack_find(self, name);
+
+  if( !pattern ) {
+    goto cleanup;
   }
 
-  sysfs_led_breathe.delay = s;
-  sysfs_led_breathe.steps = k;
+  if( pattern->active != active ) {
+    mce_log(LL_DEBUG, "pattern %s: %s", name,
+            active ? "activate" : "deactivate");
+    pattern->active = active;
+    sysfs_led_stack_select(self, false);
+  }
 
-  mce_log(LL_DEBUG, "delay=%d, steps_on=%d, steps_off=%d",
-          sysfs_led_breathe.delay, steps_on, steps_off);
+  ack = true;
+
+cleanup:
+
+  sysfs_led_unlock();
+
+  return ack;
 }
 
-/** Generate hard step intensity curve for use from breathing timer
+/* ========================================================================= *
+ * EXTRA_LEDS
+ *
+ * Devices can have separate leds for e.g. charging and buttons in
+ * addition to the indicator led. These are listed in config like
+ *
+ *   [LEDConfigHybris]
+ *   ExtraLeds=charging;button
+ *
+ * and each of them needs a config group of its own that defines
+ * backend and control file paths, e.g.
+ *
+ *   [LEDConfigHybris.button]
+ *   BackEnd=white
+ *   LedDirectory=/sys/class/leds/button-backlight
+ *
+ * Extra leds are probed once during initialization and driven via
+ * led engine instances of their own.
+ * ========================================================================= */
+
+/** Extra leds found during initialization */
+static sysfs_led_extra_t sysfs_led_extra[SYSFS_LED_EXTRA_MAX];
+
+/** Probe and create led engine instances for configured extra leds
  */
 static void
-sysfs_led_generate_ramp_hard_step(int ms_on, int ms_off)
+sysfs_led_extra_init(void)
 {
-  /* Calculate ramp duration - round up given on/off lengths
-   * to avoid totally bizarre values that could cause excessive
-   * number of timer wakeups.
-   */
-  ms_on  = led_util_roundup(ms_on,  100);
-  ms_off = led_util_roundup(ms_off, 100);
-
-  int ms_tot = ms_on + ms_off;
+  gchar  *names = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                           MCE_CONF_LED_CONFIG_HYBRIS_EXTRA_LEDS,
+                                           0);
+  gchar **vec   = names ? g_strsplit(names, ";", 0) : 0;
+  size_t  count = 0;
 
-  /* Ideally we would want to wake up only to flip the led
-   * on/off. But to keep using the existing ramp timer logic,
-   * we wake up in pace of the greatest common divisor for on
-   * and off periods.
-   */
-  int ms_step = led_util_gcd(ms_on, ms_off);
+  for( size_t i = 0; vec && vec[i]; ++i ) {
+    const char *name = vec[i];
 
-  if( ms_step < SYSFS_LED_STEP_DELAY ) {
-    ms_step = SYSFS_LED_STEP_DELAY;
-  }
+    if( !*name || sysfs_led_lookup(name) )
+      continue;
 
-  /* Calculate number of steps we need and make sure it does
-   * not exceed the defined maximum value.
-   */
-  int steps_tot = (ms_tot + ms_step - 1) / ms_step;
+    if( count >= SYSFS_LED_EXTRA_MAX ) {
+      mce_log(LL_WARN, "%s: too many extra leds, ignored", name);
+      continue;
+    }
 
-  if( steps_tot > SYSFS_LED_MAX_STEPS ) {
-    steps_tot = SYSFS_LED_MAX_STEPS;
-    ms_step = (ms_tot + steps_tot - 1) / steps_tot;
+    gchar        *group = g_strdup_printf("%s.%s",
+                                          MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                          name);
+    led_control_t control;
+    sysfs_led_t  *led   = 0;
 
-    if( ms_step < SYSFS_LED_STEP_DELAY ) {
-      ms_step = SYSFS_LED_STEP_DELAY;
+    if( sysfs_led_probe_files(&control, group) ) {
+      if( !(led = sysfs_led_create(&control)) )
+        sysfs_led_close_files(&control);
     }
-  }
-
-  int steps_on  = (ms_on + ms_step - 1 ) / ms_step;
-  int steps_off = steps_tot - steps_on;
 
-  /* Set intensity value for each step on the ramp.
-   */
-  int i = 0;
+    g_free(group);
 
-  while( i < steps_on  ) sysfs_led_breathe.value[i++] = 255;
-  while( i < steps_tot ) sysfs_led_breathe.value[i++] = 0;
+    if( !led )
+      continue;
 
-  sysfs_led_breathe.delay = ms_step;
-  sysfs_led_breathe.steps = steps_tot;
+    sysfs_led_extra[count].name = g_strdup(name);
+    sysfs_led_extra[count].led  = led;
+    ++count;
+  }
 
-  mce_log(LL_DEBUG, "delay=%d, steps_on=%d, steps_off=%d",
-          sysfs_led_breathe.delay, steps_on, steps_off);
+  g_strfreev(vec);
+  g_free(names);
 }
 
-/** Invalidate sw breathing intensity curve
+/** Delete led engine instances of extra leds
  */
 static void
-sysfs_led_generate_ramp_dummy(void)
+sysfs_led_extra_quit(void)
 {
-  sysfs_led_breathe.delay = 0;
-  sysfs_led_breathe.steps = 0;
+  for( size_t i = 0; i < SYSFS_LED_EXTRA_MAX; ++i ) {
+    sysfs_led_delete(sysfs_led_extra[i].led), sysfs_led_extra[i].led = 0;
+    g_free(sysfs_led_extra[i].name), sysfs_led_extra[i].name = 0;
+  }
 }
 
-/** Generate intensity curve for use from breathing timer
+/** Lookup led engine instance of an extra led
+ *
+ * @param name led name as used in ExtraLeds setting
+ *
+ * @return led engine instance, or NULL if not available
  */
-static void
-sysfs_led_generate_ramp(int ms_on, int ms_off)
+sysfs_led_t *
+sysfs_led_lookup(const char *name)
 {
-  switch( led_control_breath_type(&led_control) ) {
-  case LED_RAMP_HARD_STEP:
-    sysfs_led_generate_ramp_hard_step(ms_on, ms_off);
-    break;
-
-  case LED_RAMP_HALF_SINE:
-    sysfs_led_generate_ramp_half_sin(ms_on, ms_off);
-    break;
+  sysfs_led_t *led = 0;
 
-  default:
-    sysfs_led_generate_ramp_dummy();
-    break;
+  for( size_t i = 0; name && i < SYSFS_LED_EXTRA_MAX; ++i ) {
+    if( !g_strcmp0(sysfs_led_extra[i].name, name) ) {
+      led = sysfs_led_extra[i].led;
+      break;
+    }
   }
+
+  return led;
 }
 
-/** Timer id for stopping led */
-static guint sysfs_led_stop_id = 0;
+/* ========================================================================= *
+ * LATE_PROBING
+ *
+ * Initial probing is done synchronously during init. If no backend is
+ * found, probing is retried on led class uevents so that led drivers
+ * that get loaded after mce are picked up too. Such late probing is
+ * done from a worker thread so that mainloop does not get blocked.
+ *
+ * Extra leds can be active while the worker thread is probing, so:
+ * - sysfsval registry and object pool are protected by a mutex
+ *   within sysfsval, and writes made to active led controls use
+ *   only already opened file descriptors
+ * - led index and objconf group are used only by probing, which is
+ *   never done concurrently: extra leds are probed synchronously
+ *   during init before mainloop can start the worker thread, and
+ *   there is at most one worker thread at a time
+ * - probing results are handed over via idle callback, and the
+ *   worker thread is joined before they are used in mainloop
+ * ========================================================================= */
 
-/** Timer id for breathing/setting led */
-static guint sysfs_led_step_id = 0;
+/** Flag for: backend has been found and led control is active */
+static bool                sysfs_led_active = false;
 
-/** Timer callback for setting led
- */
-static gboolean
-sysfs_led_static_cb(gpointer aptr)
-{
-  (void) aptr;
+/** Probing worker thread, or 0 when not probing */
+static pthread_t           sysfs_led_probe_tid = 0;
 
-  if( !sysfs_led_step_id ) {
-    goto cleanup;
-  }
+/** Result of the latest probing round */
+static bool                sysfs_led_probe_ack = false;
 
-  sysfs_led_step_id = 0;
+/** Flag for: another probing round is needed after the current one */
+static bool                sysfs_led_probe_again = false;
 
-  // get configured color
-  int r = sysfs_led_curr.r;
-  int g = sysfs_led_curr.g;
-  int b = sysfs_led_curr.b;
+/** Idle callback id for handling probing results
+ *
+ * Set from worker thread, accessed atomically.
+ */
+static guint               sysfs_led_probe_done_id = 0;
 
-  // adjust by brightness level
-  int l = sysfs_led_curr.level;
+/** Timer id for delayed re-probing */
+static guint               sysfs_led_reprobe_id = 0;
 
-  r = led_util_scale_value(r, l);
-  g = led_util_scale_value(g, l);
-  b = led_util_scale_value(b, l);
+/** Function to call after each probing round */
+static sysfs_led_probed_fn sysfs_led_probed_cb = 0;
 
-  // set led blinking and color
-  sysfs_led_set_rgb_blink(sysfs_led_curr.on, sysfs_led_curr.off);
-  sysfs_led_set_rgb_value(r, g, b);
+/** Led control filled in by probing */
+static led_control_t       sysfs_led_probed;
 
-cleanup:
+/** Led engine instance used via the plugin api */
+static sysfs_led_t        *sysfs_led_default = 0;
 
-  return FALSE;
-}
+/** Latest display power state, applied also to late led instances */
+static bool                sysfs_led_display_on = true;
 
-/** Timer callback for taking a led breathing step
+/** Start using led backend that has been found
  */
-static gboolean
-sysfs_led_step_cb(gpointer aptr)
+static void
+sysfs_led_activate(void)
 {
-  (void)aptr;
+  /* No need to track uevents anymore */
+  sysfs_led_uevent_stop();
 
-  if( !sysfs_led_step_id ) {
-    goto cleanup;
+  if( sysfs_led_reprobe_id ) {
+    g_source_remove(sysfs_led_reprobe_id), sysfs_led_reprobe_id = 0;
   }
 
-  if( sysfs_led_breathe.step >= sysfs_led_breathe.steps ) {
-    sysfs_led_breathe.step = 0;
-  }
+  sysfs_led_lock();
+  sysfs_led_wakeups.started = led_util_get_tick();
+  sysfs_led_wakeups.count   = 0;
+  sysfs_led_unlock();
 
-  // get configured color
-  int r = sysfs_led_curr.r;
-  int g = sysfs_led_curr.g;
-  int b = sysfs_led_curr.b;
+  sysfs_led_t *led = sysfs_led_create(&sysfs_led_probed);
 
-  // adjust by brightness level
-  int l = sysfs_led_curr.level;
+  if( !led ) {
+    sysfs_led_close_files(&sysfs_led_probed);
+    goto cleanup;
+  }
 
-  r = led_util_scale_value(r, l);
-  g = led_util_scale_value(g, l);
-  b = led_util_scale_value(b, l);
+  /* Sysfs controls replace possibly attached non-sysfs backend,
+   * registered patterns are carried over */
+  if( sysfs_led_default ) {
+    sysfs_led_lock();
+    sysfs_led_stack_adopt(led, sysfs_led_default);
+    sysfs_led_unlock();
+    sysfs_led_delete(sysfs_led_default);
+  }
 
-  // adjust by curve position
-  size_t i = sysfs_led_breathe.step++;
-  int    v = sysfs_led_breathe.value[i];
+  sysfs_led_default = led;
 
-  r = led_util_scale_value(r, v);
-  g = led_util_scale_value(g, v);
-  b = led_util_scale_value(b, v);
+  sysfs_led_object_set_display_state(sysfs_led_default,
+                                     sysfs_led_display_on);
 
-  // set led color
-  sysfs_led_set_rgb_value(r, g, b);
+  sysfs_led_active = true;
 
 cleanup:
 
-  return sysfs_led_step_id != 0;
+  return;
 }
 
-static bool sysfs_led_reset_blinking = true;
+/** Probing worker thread
+ *
+ * @param aptr unused
+ *
+ * @return 0 on thread exit - via pthread_join()
+ */
+static void *
+sysfs_led_probe_thread_cb(void *aptr)
+{
+  (void) aptr;
+
+  sysfs_led_probe_ack = sysfs_led_probe_files(&sysfs_led_probed, 0);
 
-/** Timer callback from stopping/restarting led
+  /* Handle results in mainloop */
+  guint id = g_idle_add(sysfs_led_probe_done_cb, 0);
+  __atomic_store_n(&sysfs_led_probe_done_id, id, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/** Idle callback for handling probing results
+ *
+ * @param aptr unused
+ *
+ * @return FALSE to stop idle callback from repeating
  */
 static gboolean
-sysfs_led_stop_cb(gpointer aptr)
+sysfs_led_probe_done_cb(gpointer aptr)
 {
   (void) aptr;
 
-  if( !sysfs_led_stop_id ) {
-    goto cleanup;
-  }
-  sysfs_led_stop_id = 0;
-
-  if( sysfs_led_reset_blinking ) {
-    // blinking off - must be followed by rgb set to have an effect
-    sysfs_led_set_rgb_blink(0, 0);
-  }
+  /* Worker thread is exiting, collect it */
+  sysfs_led_probe_join();
+  __atomic_store_n(&sysfs_led_probe_done_id, 0, __ATOMIC_RELEASE);
 
-  if( !led_state_has_color(&sysfs_led_curr) ) {
-    // set rgb to black before returning
-    sysfs_led_reset_blinking = true;
+  if( sysfs_led_probe_ack ) {
+    sysfs_led_activate();
   }
-  else {
-    if( sysfs_led_breathe.delay > 0 ) {
-      // start breathing timer
-      sysfs_led_step_id = g_timeout_add(sysfs_led_breathe.delay,
-                                        sysfs_led_step_cb, 0);
-    }
-    else {
-      // set rgb to target after timer delay
-      sysfs_led_step_id = g_timeout_add(SYSFS_LED_KERNEL_DELAY,
-                                        sysfs_led_static_cb, 0);
-    }
+  else if( sysfs_led_probe_again ) {
+    sysfs_led_probe_again = false;
+    sysfs_led_probe_start();
   }
 
-  if( sysfs_led_reset_blinking ) {
-    // set rgb to black
-    sysfs_led_set_rgb_value(0, 0, 0);
-    sysfs_led_reset_blinking = false;
+  if( sysfs_led_probed_cb ) {
+    sysfs_led_probed_cb(sysfs_led_active);
   }
 
-cleanup:
-
   return FALSE;
 }
 
-/** Start static/blinking/breathing led
+/** Wait for probing worker thread to exit
  */
 static void
-sysfs_led_start(const led_state_t *next)
+sysfs_led_probe_join(void)
 {
-  led_state_t work = *next;
+  if( sysfs_led_probe_tid ) {
+    pthread_join(sysfs_led_probe_tid, 0);
+    sysfs_led_probe_tid = 0;
+  }
+}
 
-  led_state_sanitize(&work);
+/** Start probing for led backend in a worker thread
+ *
+ * If probing is already in progress, another round is done
+ * after the current one finishes.
+ *
+ * @return true if probing was started, false otherwise
+ */
+static bool
+sysfs_led_probe_start(void)
+{
+  bool ack = false;
 
-  if( led_state_is_equal(&sysfs_led_curr, &work) ) {
+  if( sysfs_led_active ) {
     goto cleanup;
   }
 
-  /* Assumption: Before changing the led state, we need to wait a bit
-   * for kernel side to finish with last change we made and then possibly
-   * reset the blinking status and wait a bit more */
-  bool restart = true;
+  if( sysfs_led_probe_tid ) {
+    sysfs_led_probe_again = true;
+    ack = true;
+    goto cleanup;
+  }
 
-  led_style_t old_style = led_state_get_style(&sysfs_led_curr);
-  led_style_t new_style = led_state_get_style(&work);
+  mce_log(LL_DEBUG, "re-probing led backends");
 
-  /* Exception: When we are already breathing and continue to
-   * breathe, the blinking is not in use and the breathing timer
-   * is keeping the updates far enough from each other */
-  if( old_style == STYLE_BREATH && new_style == STYLE_BREATH &&
-      led_state_has_equal_timing(&sysfs_led_curr, &work) ) {
-    restart = false;
+  if( pthread_create(&sysfs_led_probe_tid, 0,
+                     sysfs_led_probe_thread_cb, 0) != 0 ) {
+    mce_log(LL_ERR, "could not start led probing thread");
+    /* content of tid is undefined on failure, force to zero */
+    sysfs_led_probe_tid = 0;
+    goto cleanup;
   }
 
-  /* If only the als-based brightness level changes, we need to
-   * adjust the breathing amplitude without affecting the phase.
-   * Otherwise assume that the pattern has been changed and the
-   * breathing step counter needs to be reset. */
-  sysfs_led_curr.level = work.level;
-  if( !led_state_is_equal(&sysfs_led_curr, &work) ) {
-    sysfs_led_breathe.step = 0;
-  }
+  ack = true;
 
-  sysfs_led_curr = work;
+cleanup:
 
-  if( restart ) {
-    // stop existing breathing timer
-    if( sysfs_led_step_id ) {
-      g_source_remove(sysfs_led_step_id), sysfs_led_step_id = 0;
-    }
+  return ack;
+}
 
-    // re-evaluate breathing constants
-    sysfs_led_breathe.delay = 0;
-    if( new_style == STYLE_BREATH ) {
-      sysfs_led_generate_ramp(work.on, work.off);
-    }
+/** Timer callback for re-probing after led uevents
+ *
+ * @param aptr unused
+ *
+ * @return FALSE to stop timer from repeating
+ */
+static gboolean
+sysfs_led_reprobe_cb(gpointer aptr)
+{
+  (void) aptr;
 
-    if( old_style == STYLE_BLINK || new_style == STYLE_BLINK )
-      sysfs_led_reset_blinking = true;
+  if( sysfs_led_reprobe_id ) {
+    sysfs_led_reprobe_id = 0;
+    sysfs_led_probe_start();
+  }
 
-    /* Schedule led off after kernel settle timeout; once that
-     * is done, new led color/blink/breathing will be started */
-    if( !sysfs_led_stop_id ) {
-      sysfs_led_stop_id = g_timeout_add(SYSFS_LED_KERNEL_DELAY,
-                                        sysfs_led_stop_cb, 0);
-    }
+  return FALSE;
+}
+
+/** Callback for led class devices added after initial probing
+ */
+static void
+sysfs_led_probe_uevent_cb(void)
+{
+  if( sysfs_led_active ) {
+    goto cleanup;
+  }
+
+  /* Restart delay so that bursts of uevents cause only one
+   * probing round */
+  if( sysfs_led_reprobe_id ) {
+    g_source_remove(sysfs_led_reprobe_id);
   }
 
+  sysfs_led_reprobe_id = g_timeout_add(SYSFS_LED_REPROBE_DELAY,
+                                       sysfs_led_reprobe_cb, 0);
+
 cleanup:
 
   return;
 }
 
-/** Nanosleep helper
+/** Probe and start using led backends
+ *
+ * Initial probing is done synchronously, so that the backend and its
+ * capabilities are known when this function returns.
+ *
+ * If nothing is found, probing is retried in a worker thread when
+ * led class devices are added. The callback function is called from
+ * mainloop after each such late probing round - with found=true when
+ * a backend has been taken in use.
+ *
+ * @param cb function to call after late probing, or NULL
+ *
+ * @return true if led backend was found, false otherwise
  */
-static void
-sysfs_led_wait_kernel(void)
+bool
+sysfs_led_init(sysfs_led_probed_fn cb)
 {
-  struct timespec ts = { 0, SYSFS_LED_KERNEL_DELAY * 1000000l };
-  TEMP_FAILURE_RETRY(nanosleep(&ts, &ts));
+  bool ack = false;
+
+  sysfs_led_probed_cb = cb;
+
+  /* Probing can happen in worker threads - make configuration
+   * and quirks available without accessing mce config from them */
+  plugin_config_preload(MCE_CONF_LED_CONFIG_HYBRIS_GROUP);
+  quirk_preload();
+
+  gchar *root = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                         MCE_CONF_LED_CONFIG_HYBRIS_SYSFS_ROOT,
+                                         0);
+  const char *env = getenv(SYSFS_LED_ROOT_ENV);
+  led_util_set_root(env ? env : root);
+  g_free(root);
+
+  sysfsval_set_resolver(sysfs_led_resolve_path);
+
+  gchar *timer = plugin_config_get_string(MCE_CONF_LED_CONFIG_HYBRIS_GROUP,
+                                          MCE_CONF_LED_CONFIG_HYBRIS_TIMER_BACKEND,
+                                          0);
+  sysfs_led_sched_select(led_timer_parse_type(timer));
+  g_free(timer);
+
+  /* Start monitoring before probing to avoid missing
+   * devices that appear while probing */
+  if( !sysfs_led_uevent_start(sysfs_led_probe_uevent_cb) ) {
+    mce_log(LL_WARN, "late led probing not available");
+  }
+
+  mce_log(LL_DEBUG, "probing led backends");
+
+  if( sysfs_led_probe_files(&sysfs_led_probed, 0) ) {
+    sysfs_led_activate();
+  }
+
+  sysfs_led_extra_init();
+
+  ack = sysfs_led_active;
+
+  return ack;
 }
 
+/** Let led engine drive a led control backend that is not using sysfs
+ *
+ * Write latency of the backend is measured, and it is taken in use
+ * only if it is fast enough for sw breathing - so that breathing step
+ * tables and wakeup budget apply just like with sysfs backends.
+ *
+ * Probing for sysfs backends is not stopped; if one is found later
+ * on, it replaces the attached backend.
+ *
+ * @param control led control backend, copied on success
+ *
+ * @return true if backend was taken in use, false otherwise
+ */
 bool
-sysfs_led_init(void)
+sysfs_led_attach(const led_control_t *control)
 {
-  bool ack = false;
+  bool          ack   = false;
+  led_control_t probe = *control;
 
-  if( !sysfs_led_probe_files() ) {
+  if( sysfs_led_active || sysfs_led_default ) {
     goto cleanup;
   }
 
-  /* adjust current state to: color=black */
-  led_state_t req = sysfs_led_curr;
-  req.r = 0;
-  req.g = 0;
-  req.b = 0;
-  sysfs_led_start(&req);
+  led_control_calibrate(&probe, false);
+
+  if( !QUIRK(QUIRK_BREATHING, probe.can_breathe) ) {
+    mce_log(LL_NOTICE, "%s: not used for led engine", probe.name);
+    goto cleanup;
+  }
+  probe.can_breathe = true;
+
+  sysfs_led_lock();
+  sysfs_led_wakeups.started = led_util_get_tick();
+  sysfs_led_wakeups.count   = 0;
+  sysfs_led_unlock();
+
+  if( !(sysfs_led_default = sysfs_led_create(&probe)) ) {
+    goto cleanup;
+  }
+
+  sysfs_led_object_set_display_state(sysfs_led_default,
+                                     sysfs_led_display_on);
 
   ack = true;
 
@@ -877,65 +3689,188 @@ cleanup:
 void
 sysfs_led_quit(void)
 {
-  // cancel timers
-  if( sysfs_led_step_id ) {
-    g_source_remove(sysfs_led_step_id), sysfs_led_step_id = 0;
+  // stop probing
+  sysfs_led_probed_cb = 0;
+  sysfs_led_uevent_stop();
+  if( sysfs_led_reprobe_id ) {
+    g_source_remove(sysfs_led_reprobe_id), sysfs_led_reprobe_id = 0;
   }
-  if( sysfs_led_stop_id ) {
-    g_source_remove(sysfs_led_stop_id), sysfs_led_stop_id = 0;
+  sysfs_led_probe_join();
+  guint done_id = __atomic_exchange_n(&sysfs_led_probe_done_id, 0,
+                                      __ATOMIC_ACQUIRE);
+  if( done_id ) {
+    g_source_remove(done_id);
   }
 
-  // allow kernel side to settle down
-  sysfs_led_wait_kernel();
+  if( !sysfs_led_active ) {
+    // close files possibly left open by unhandled probing result
+    sysfs_led_close_files(&sysfs_led_probed);
+  }
+  sysfs_led_active = false;
 
-  // blink off
-  sysfs_led_set_rgb_blink(0, 0);
+  // delete sysfs or attached led instance
+  sysfs_led_delete(sysfs_led_default), sysfs_led_default = 0;
 
-  // zero brightness
-  sysfs_led_set_rgb_value(0, 0, 0);
+  // delete extra led instances
+  sysfs_led_extra_quit();
 
-  // close sysfs files
-  sysfs_led_close_files();
+  // stop timer backend - after the last instance is gone
+  if( !sysfs_led_instances )
+    led_timer_quit();
+
+  sysfsval_set_resolver(0);
+
+  // worker threads are gone, release configuration snapshot
+  plugin_config_unload();
+
+  return;
 }
 
 bool
 sysfs_led_set_pattern(int r, int g, int b,
                       int ms_on, int ms_off)
 {
-  /* adjust current state to: color & timing as requested */
-  led_state_t req = sysfs_led_curr;
-  req.r   = r;
-  req.g   = g;
-  req.b   = b;
-  req.on  = ms_on;
-  req.off = ms_off;
-  sysfs_led_start(&req);
+  if( sysfs_led_default )
+    sysfs_led_object_set_pattern(sysfs_led_default, r, g, b, ms_on, ms_off);
 
   return true;
 }
 
+bool
+sysfs_led_set_sequence(const led_keyframe_t *frames, int count, int repeat)
+{
+  if( sysfs_led_default )
+    sysfs_led_object_set_sequence(sysfs_led_default, frames, count, repeat);
+
+  return true;
+}
+
+bool
+sysfs_led_pattern_register(const char *name, int priority, int slice_ms,
+                           const led_keyframe_t *frames, int count)
+{
+  return (sysfs_led_default &&
+          sysfs_led_object_pattern_register(sysfs_led_default, name,
+                                            priority, slice_ms,
+                                            frames, count));
+}
+
+bool
+sysfs_led_pattern_unregister(const char *name)
+{
+  return (sysfs_led_default &&
+          sysfs_led_object_pattern_unregister(sysfs_led_default, name));
+}
+
+bool
+sysfs_led_pattern_activate(const char *name, bool active)
+{
+  return (sysfs_led_default &&
+          sysfs_led_object_pattern_activate(sysfs_led_default, name,
+                                            active));
+}
+
 bool
 sysfs_led_can_breathe(void)
 {
-  return led_control_can_breathe(&led_control);
+  return (sysfs_led_default &&
+          sysfs_led_object_can_breathe(sysfs_led_default));
 }
 
 void
 sysfs_led_set_breathing(bool enable)
 {
-  if( sysfs_led_can_breathe() ) {
-    /* adjust current state to: breathing as requested */
-    led_state_t work = sysfs_led_curr;
-    work.breathe = enable;
-    sysfs_led_start(&work);
-  }
+  if( sysfs_led_default )
+    sysfs_led_object_set_breathing(sysfs_led_default, enable);
 }
 
 void
 sysfs_led_set_brightness(int level)
 {
-  /* adjust current state to: brightness as requested */
-  led_state_t work = sysfs_led_curr;
-  work.level = level;
-  sysfs_led_start(&work);
+  if( sysfs_led_default )
+    sysfs_led_object_set_brightness(sysfs_led_default, level);
+}
+
+void
+sysfs_led_get_wakeup_rate(int *curr, int *avg)
+{
+  sysfs_led_lock();
+
+  /* Rate implied by currently active breathing curve */
+  int rate_curr = 0;
+
+  for( sysfs_led_t *self = sysfs_led_instances; self; self = self->next ) {
+    if( sysfs_led_timer_is_active(&self->step_timer) &&
+        self->breathe.delay > 0 && self->breathe.cycle > 0 ) {
+      rate_curr += (int)(self->breathe.steps * SYSFS_LED_BUDGET_PERIOD /
+                         self->breathe.cycle);
+    }
+  }
+
+  /* Rate of actually made wakeups since initialization */
+  int     rate_avg = 0;
+  int64_t elapsed  = led_util_get_tick() - sysfs_led_wakeups.started;
+
+  if( sysfs_led_wakeups.started > 0 && elapsed > 0 ) {
+    rate_avg = (int)(sysfs_led_wakeups.count * SYSFS_LED_BUDGET_PERIOD /
+                     (uint64_t)elapsed);
+  }
+
+  if( curr ) *curr = rate_curr;
+  if( avg  ) *avg  = rate_avg;
+
+  sysfs_led_unlock();
+}
+
+void
+sysfs_led_set_display_state(bool on)
+{
+  sysfs_led_lock();
+
+  sysfs_led_display_on = on;
+
+  for( sysfs_led_t *self = sysfs_led_instances; self; self = self->next )
+    sysfs_led_object_set_display_state(self, on);
+
+  sysfs_led_unlock();
+}
+
+void
+sysfs_led_get_downgrade_stats(int *count, int *secs)
+{
+  sysfs_led_lock();
+
+  int     total_count = 0;
+  int64_t total_time  = 0;
+  int64_t now         = led_util_get_tick();
+
+  for( sysfs_led_t *self = sysfs_led_instances; self; self = self->next ) {
+    total_count += self->downgrade_count;
+    total_time  += self->downgrade_time;
+    if( self->downgrade_start )
+      total_time += now - self->downgrade_start;
+  }
+
+  if( count ) *count = total_count;
+  if( secs  ) *secs  = (int)(total_time / 1000);
+
+  sysfs_led_unlock();
+}
+
+bool
+sysfs_led_estimate_pattern(int r, int g, int b, int ms_on, int ms_off,
+                           bool breathe, int *led_ua, int *cpu_ua)
+{
+  return (sysfs_led_default &&
+          sysfs_led_object_estimate_pattern(sysfs_led_default, r, g, b,
+                                            ms_on, ms_off, breathe,
+                                            led_ua, cpu_ua));
+}
+
+bool
+sysfs_led_estimate_named(const char *name, int *led_ua, int *cpu_ua)
+{
+  return (sysfs_led_default &&
+          sysfs_led_object_estimate_named(sysfs_led_default, name,
+                                          led_ua, cpu_ua));
 }
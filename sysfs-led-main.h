@@ -24,7 +24,10 @@
 #ifndef  SYSFS_LED_MAIN_H_
 # define SYSFS_LED_MAIN_H_
 
+# include "sysfs-led-timer.h"
+
 # include <stdbool.h>
+# include <stdint.h>
 
 /* ------------------------------------------------------------------------- *
  * LED_CONTROL - Common RGB LED control API
@@ -43,30 +46,108 @@ typedef enum {
   LED_RAMP_HARD_STEP = 2,
 } led_ramp_t;
 
+/** Kernel side settle time requirements of led backend
+ */
+typedef enum {
+  /** Changes can be made back to back */
+  LED_SETTLE_NONE  = 0,
+
+  /** Settle time is needed only after blink config changes */
+  LED_SETTLE_BLINK = 1,
+
+  /** Settle time is needed after every change */
+  LED_SETTLE_FIXED = 2,
+} led_settle_t;
+
+/** How keyframe color changes towards the next keyframe
+ */
+typedef enum {
+  /** Color stays the same for the whole keyframe duration */
+  LED_INTERP_HOLD   = 0,
+
+  /** Color fades linearly to the color of the next keyframe */
+  LED_INTERP_LINEAR = 1,
+} led_interp_t;
+
+/** Maximum number of keyframes in a sequence */
+# define SYSFS_LED_KEYFRAMES_MAX 32
+
+/** Keyframe of led sequence
+ */
+typedef struct
+{
+  int           r, g, b;  // color [0 ... 255]
+  int           duration; // [ms]
+  led_interp_t  interp;
+} led_keyframe_t;
+
 typedef struct led_control_t led_control_t;
 
 /** Led control backend
  */
 struct led_control_t
 {
-  const char *name;
-  void       *data;
-  bool        can_breathe;
-  bool        use_config;
-  led_ramp_t  breath_type;
-  void      (*enable)(void *data, bool enable);
-  void      (*blink) (void *data, int on_ms, int off_ms);
-  void      (*value) (void *data, int r, int g, int b);
-  void      (*close) (void *data);
+  const char   *name;
+  void         *data;
+  bool          can_breathe;
+  bool          blocking;
+  bool          use_config;
+  bool          config_only;
+  led_ramp_t    breath_type;
+  led_settle_t  settle_type;
+  int           settle_ms;
+  int           step_delay;
+  int           max_steps;
+  void        (*enable)(void *data, bool enable);
+  void        (*blink) (void *data, int on_ms, int off_ms);
+  void        (*value) (void *data, int r, int g, int b);
+  void        (*close) (void *data);
 };
 
-bool sysfs_led_init           (void);
+/** Callback for notifying about led backend probing results */
+typedef void (*sysfs_led_probed_fn)(bool found);
+
+/** Led engine instance driving one led control backend */
+typedef struct sysfs_led_t sysfs_led_t;
+
+sysfs_led_t *sysfs_led_create              (const led_control_t *control);
+void         sysfs_led_delete              (sysfs_led_t *self);
+void         sysfs_led_object_set_pattern  (sysfs_led_t *self, int r, int g, int b, int ms_on, int ms_off);
+void         sysfs_led_object_set_sequence (sysfs_led_t *self, const led_keyframe_t *frames, int count, int repeat);
+bool         sysfs_led_object_can_breathe  (const sysfs_led_t *self);
+void         sysfs_led_object_set_breathing(sysfs_led_t *self, bool enable);
+void         sysfs_led_object_set_brightness(sysfs_led_t *self, int level);
+void         sysfs_led_object_set_display_state(sysfs_led_t *self, bool on);
+bool         sysfs_led_object_estimate_pattern(sysfs_led_t *self, int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool         sysfs_led_object_estimate_named(sysfs_led_t *self, const char *name, int *led_ua, int *cpu_ua);
+bool         sysfs_led_object_pattern_register(sysfs_led_t *self, const char *name, int priority, int slice_ms, const led_keyframe_t *frames, int count);
+bool         sysfs_led_object_pattern_unregister(sysfs_led_t *self, const char *name);
+bool         sysfs_led_object_pattern_activate(sysfs_led_t *self, const char *name, bool active);
+
+bool sysfs_led_init           (sysfs_led_probed_fn cb);
 void sysfs_led_quit           (void);
+bool sysfs_led_attach         (const led_control_t *control);
+sysfs_led_t *sysfs_led_lookup (const char *name);
 bool sysfs_led_set_pattern    (int r, int g, int b, int ms_on, int ms_off);
+bool sysfs_led_set_sequence   (const led_keyframe_t *frames, int count, int repeat);
 bool sysfs_led_can_breathe    (void);
+bool sysfs_led_pattern_register(const char *name, int priority, int slice_ms, const led_keyframe_t *frames, int count);
+bool sysfs_led_pattern_unregister(const char *name);
+bool sysfs_led_pattern_activate(const char *name, bool active);
 void sysfs_led_set_breathing  (bool enable);
 void sysfs_led_set_brightness (int level);
+void sysfs_led_get_wakeup_rate(int *curr, int *avg);
+void sysfs_led_set_display_state(bool on);
+void sysfs_led_get_downgrade_stats(int *count, int *secs);
+bool sysfs_led_estimate_pattern(int r, int g, int b, int ms_on, int ms_off, bool breathe, int *led_ua, int *cpu_ua);
+bool sysfs_led_estimate_named(const char *name, int *led_ua, int *cpu_ua);
+
+bool sysfs_led_sched_select   (led_timer_type_t type);
+void sysfs_led_lock           (void);
+void sysfs_led_unlock         (void);
 
+void led_control_blink        (led_control_t *self, int on_ms, int off_ms);
+void led_control_value        (led_control_t *self, int r, int g, int b);
 void led_control_close        (led_control_t *self);
 
 #endif /* SYSFS_LED_MAIN_H_ */
@@ -0,0 +1,463 @@
+/** @file sysfs-led-multicolor.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * RGB led control: Linux multicolor led class backend
+ *
+ * One led directory, which:
+ * - must have 'brightness' control file
+ * - must have 'max_brightness' control file
+ * - must have 'multi_index' file listing the color channels
+ * - must have 'multi_intensity' file for setting all channels at once
+ *
+ * Assumptions built into code:
+ * - Color is set via single 'multi_intensity' write and overall
+ *   brightness is kept at maximum - which means color changes need
+ *   just one write instead of one per channel, and there is no
+ *   tearing between channel updates.
+ * - Turning led off is done via 'brightness' only, so that the
+ *   color does not need to be rewritten when led is turned back on.
+ * ========================================================================= */
+
+#include "sysfs-led-multicolor.h"
+
+#include "sysfs-led-util.h"
+#include "sysfs-led-index.h"
+#include "sysfs-val.h"
+#include "plugin-config.h"
+#include "plugin-logging.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+/** Maximum number of color channels supported in 'multi_index' */
+#define MULTICOLOR_MAX_SLOTS 8
+
+/** Color channel types that can be listed in 'multi_index' */
+typedef enum
+{
+    MULTICOLOR_UNKNOWN,
+    MULTICOLOR_RED,
+    MULTICOLOR_GREEN,
+    MULTICOLOR_BLUE,
+    MULTICOLOR_WHITE,
+} led_color_multicolor_t;
+
+typedef struct
+{
+    const char *max_brightness;   // R
+    const char *brightness;       // W
+    const char *multi_index;      // R
+    const char *multi_intensity;  // W
+} led_paths_multicolor_t;
+
+typedef struct
+{
+    sysfsval_t             *cached_max_brightness;
+    sysfsval_t             *cached_brightness;
+    sysfsval_t             *cached_multi_intensity;
+    size_t                  slots;
+    led_color_multicolor_t  slot_color[MULTICOLOR_MAX_SLOTS];
+} led_channel_multicolor_t;
+
+/* ------------------------------------------------------------------------- *
+ * ONE_CHANNEL
+ * ------------------------------------------------------------------------- */
+
+static led_color_multicolor_t led_channel_multicolor_parse_color(const char *name);
+static bool led_channel_multicolor_read_index (led_channel_multicolor_t *self, const char *path);
+static void led_channel_multicolor_init       (led_channel_multicolor_t *self);
+static void led_channel_multicolor_close      (led_channel_multicolor_t *self);
+static bool led_channel_multicolor_probe      (led_channel_multicolor_t *self, const led_paths_multicolor_t *path);
+static void led_channel_multicolor_set_color  (led_channel_multicolor_t *self, int r, int g, int b);
+
+/* ------------------------------------------------------------------------- *
+ * ALL_CHANNELS
+ * ------------------------------------------------------------------------- */
+
+static void led_control_multicolor_value_cb   (void *data, int r, int g, int b);
+static void led_control_multicolor_close_cb   (void *data);
+
+bool        led_control_multicolor_probe      (led_control_t *self);
+
+/* ========================================================================= *
+ * ONE_CHANNEL
+ * ========================================================================= */
+
+static led_color_multicolor_t
+led_channel_multicolor_parse_color(const char *name)
+{
+    static const struct
+    {
+        const char             *name;
+        led_color_multicolor_t  color;
+    } lut[] =
+    {
+        { "red",   MULTICOLOR_RED   },
+        { "green", MULTICOLOR_GREEN },
+        { "blue",  MULTICOLOR_BLUE  },
+        { "white", MULTICOLOR_WHITE },
+    };
+
+    for( size_t i = 0; i < G_N_ELEMENTS(lut); ++i ) {
+        if( !strcmp(lut[i].name, name) )
+            return lut[i].color;
+    }
+
+    return MULTICOLOR_UNKNOWN;
+}
+
+static bool
+led_channel_multicolor_read_index(led_channel_multicolor_t *self,
+                                  const char *path)
+{
+    bool  res  = false;
+    int   fd   = -1;
+    bool  rgb  = false;
+    char *real = 0;
+
+    char data[256];
+
+    self->slots = 0;
+
+    if( !path || !sysfs_led_index_exists(path) )
+        goto cleanup;
+
+    if( !(real = led_util_root_path(path)) )
+        goto cleanup;
+
+    if( (fd = open(real, O_RDONLY)) == -1 )
+        goto cleanup;
+
+    int done = read(fd, data, sizeof data - 1);
+
+    if( done <= 0 ) {
+        mce_log(LOG_ERR, "%s: read: %m", path);
+        goto cleanup;
+    }
+
+    data[done] = 0;
+
+    char *save = 0;
+    for( char *tok = strtok_r(data, " \t\n", &save); tok;
+         tok = strtok_r(0, " \t\n", &save) ) {
+        if( self->slots >= MULTICOLOR_MAX_SLOTS ) {
+            mce_log(LOG_WARNING, "%s: too many channels", path);
+            goto cleanup;
+        }
+
+        led_color_multicolor_t color = led_channel_multicolor_parse_color(tok);
+
+        if( color != MULTICOLOR_UNKNOWN && color != MULTICOLOR_WHITE )
+            rgb = true;
+
+        self->slot_color[self->slots++] = color;
+    }
+
+    /* Require at least one of the rgb channels to be present */
+    if( !rgb )
+        goto cleanup;
+
+    mce_log(LOG_DEBUG, "%s: %zu channels", path, self->slots);
+
+    res = true;
+
+cleanup:
+
+    if( fd != -1 )
+        close(fd);
+
+    free(real);
+
+    return res;
+}
+
+static void
+led_channel_multicolor_init(led_channel_multicolor_t *self)
+{
+    self->cached_max_brightness = sysfsval_create();
+    self->cached_brightness      = sysfsval_create();
+    self->cached_multi_intensity = sysfsval_create();
+    self->slots                  = 0;
+}
+
+static void
+led_channel_multicolor_close(led_channel_multicolor_t *self)
+{
+    sysfsval_delete(self->cached_max_brightness),
+        self->cached_max_brightness = 0;
+
+    sysfsval_delete(self->cached_brightness),
+        self->cached_brightness = 0;
+
+    sysfsval_delete(self->cached_multi_intensity),
+        self->cached_multi_intensity = 0;
+}
+
+static bool
+led_channel_multicolor_probe(led_channel_multicolor_t *self,
+                             const led_paths_multicolor_t *path)
+{
+    bool res = false;
+
+    if( !led_channel_multicolor_read_index(self, path->multi_index) )
+        goto cleanup;
+
+    if( !sysfsval_open_rw(self->cached_brightness, path->brightness) )
+        goto cleanup;
+
+    if( !sysfsval_open_wo(self->cached_multi_intensity, path->multi_intensity) )
+        goto cleanup;
+
+    if( !sysfsval_open_ro(self->cached_max_brightness, path->max_brightness) )
+        goto cleanup;
+
+    sysfsval_refresh(self->cached_max_brightness);
+
+    if( sysfsval_get(self->cached_max_brightness) <= 0 )
+        goto cleanup;
+
+    res = true;
+
+cleanup:
+
+    /* Always close the max_brightness file */
+    sysfsval_close(self->cached_max_brightness);
+
+    /* On failure close the other files too */
+    if( !res )
+    {
+        sysfsval_close(self->cached_brightness);
+        sysfsval_close(self->cached_multi_intensity);
+    }
+
+    return res;
+}
+
+static void
+led_channel_multicolor_set_color(led_channel_multicolor_t *self,
+                                 int r, int g, int b)
+{
+    int max_brightness = sysfsval_get(self->cached_max_brightness);
+
+    if( r <= 0 && g <= 0 && b <= 0 ) {
+        /* Leave color as is, just turn the led off */
+        sysfsval_set(self->cached_brightness, 0);
+        return;
+    }
+
+    /* If there is a white channel, it shows the common part of
+     * requested rgb color and only the remainder goes to rgb */
+    int w = 0;
+
+    for( size_t i = 0; i < self->slots; ++i ) {
+        if( self->slot_color[i] == MULTICOLOR_WHITE ) {
+            w = r;
+            if( w > g ) w = g;
+            if( w > b ) w = b;
+            break;
+        }
+    }
+
+    /* Intensity values are listed in 'multi_index' order */
+    char   data[64];
+    size_t used = 0;
+
+    for( size_t i = 0; i < self->slots; ++i ) {
+        int value = 0;
+
+        switch( self->slot_color[i] ) {
+        case MULTICOLOR_RED:   value = r - w; break;
+        case MULTICOLOR_GREEN: value = g - w; break;
+        case MULTICOLOR_BLUE:  value = b - w; break;
+        case MULTICOLOR_WHITE: value = w;     break;
+        default:
+            break;
+        }
+
+        value = led_util_scale_value(value, max_brightness);
+        used += snprintf(data + used, sizeof data - used, "%s%d",
+                         i ? " " : "", value);
+        if( used >= sizeof data )
+            return;
+    }
+
+    /* Write is skipped if color does not change */
+    sysfsval_set_text(self->cached_multi_intensity, data);
+
+    sysfsval_set(self->cached_brightness, max_brightness);
+}
+
+/* ========================================================================= *
+ * ALL_CHANNELS
+ * ========================================================================= */
+
+#define MULTICOLOR_CHANNELS 1
+
+static void
+led_control_multicolor_value_cb(void *data, int r, int g, int b)
+{
+    led_channel_multicolor_t *channel = data;
+
+    led_channel_multicolor_set_color(channel + 0, r, g, b);
+}
+
+static void
+led_control_multicolor_close_cb(void *data)
+{
+    led_channel_multicolor_t *channel = data;
+    led_channel_multicolor_close(channel + 0);
+    free(channel);
+}
+
+static bool
+led_control_multicolor_static_probe(led_channel_multicolor_t *channel)
+{
+    /** Sysfs control paths for multicolor class leds */
+    static const led_paths_multicolor_t paths[][MULTICOLOR_CHANNELS] =
+    {
+        {
+            {
+                .max_brightness  = "/sys/class/leds/rgb:status/max_brightness",
+                .brightness      = "/sys/class/leds/rgb:status/brightness",
+                .multi_index     = "/sys/class/leds/rgb:status/multi_index",
+                .multi_intensity = "/sys/class/leds/rgb:status/multi_intensity",
+            },
+        },
+        {
+            {
+                .max_brightness  = "/sys/class/leds/multicolor:status/max_brightness",
+                .brightness      = "/sys/class/leds/multicolor:status/brightness",
+                .multi_index     = "/sys/class/leds/multicolor:status/multi_index",
+                .multi_intensity = "/sys/class/leds/multicolor:status/multi_intensity",
+            },
+        },
+        {
+            {
+                .max_brightness  = "/sys/class/leds/rgb:indicator/max_brightness",
+                .brightness      = "/sys/class/leds/rgb:indicator/brightness",
+                .multi_index     = "/sys/class/leds/rgb:indicator/multi_index",
+                .multi_intensity = "/sys/class/leds/rgb:indicator/multi_intensity",
+            },
+        },
+    };
+
+    bool ack = false;
+
+    for( size_t i = 0; i < G_N_ELEMENTS(paths); ++i ) {
+        if( (ack = led_channel_multicolor_probe(channel+0, &paths[i][0])) )
+            break;
+    }
+
+    return ack;
+}
+
+static bool
+led_control_multicolor_dynamic_probe(led_channel_multicolor_t *channel)
+{
+    /* See inifiles/60-multicolor.ini for example */
+    static const objconf_t multicolor_conf[] =
+    {
+        OBJCONF_FILE(led_paths_multicolor_t, brightness,      Brightness),
+        OBJCONF_FILE(led_paths_multicolor_t, max_brightness,  MaxBrightness),
+        OBJCONF_FILE(led_paths_multicolor_t, multi_index,     MultiIndex),
+        OBJCONF_FILE(led_paths_multicolor_t, multi_intensity, MultiIntensity),
+        OBJCONF_STOP
+    };
+
+    static const char * const pfix[MULTICOLOR_CHANNELS] =
+    {
+        "Led",
+    };
+
+    bool ack = false;
+
+    led_paths_multicolor_t paths[MULTICOLOR_CHANNELS];
+
+    memset(paths, 0, sizeof paths);
+    for( size_t i = 0; i < MULTICOLOR_CHANNELS; ++i )
+        objconf_init(multicolor_conf, &paths[i]);
+
+    for( size_t i = 0; i < MULTICOLOR_CHANNELS; ++i ) {
+        if( !objconf_parse(multicolor_conf, &paths[i], pfix[i]) )
+            goto cleanup;
+
+        if( !led_channel_multicolor_probe(channel+i, &paths[i]) )
+            goto cleanup;
+    }
+
+    ack = true;
+
+cleanup:
+
+    for( size_t i = 0; i < MULTICOLOR_CHANNELS; ++i )
+        objconf_quit(multicolor_conf, &paths[i]);
+
+    return ack;
+}
+
+bool
+led_control_multicolor_probe(led_control_t *self)
+{
+    led_channel_multicolor_t *channel = calloc(MULTICOLOR_CHANNELS, sizeof *channel);
+
+    if( !channel )
+        return false;
+
+    bool res = false;
+
+    led_channel_multicolor_init(channel + 0);
+
+    self->name   = "multicolor";
+    self->data   = channel;
+    self->enable = 0;
+    self->blink  = 0;
+    self->value  = led_control_multicolor_value_cb;
+    self->close  = led_control_multicolor_close_cb;
+
+    /* We can use sw breathing logic */
+    self->can_breathe = true;
+
+    /* Brightness changes do not need kernel settle time */
+    self->settle_type = LED_SETTLE_NONE;
+
+    if( self->use_config )
+        res = led_control_multicolor_dynamic_probe(channel);
+
+    if( !res && !self->config_only )
+        res = led_control_multicolor_static_probe(channel);
+
+    if( !res )
+        led_control_close(self);
+
+    return res;
+}
@@ -36,10 +36,12 @@
 #include "sysfs-led-redgreen.h"
 
 #include "sysfs-led-util.h"
+#include "sysfs-led-colormap.h"
 #include "sysfs-val.h"
 #include "plugin-config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -60,6 +62,14 @@ typedef struct
     sysfsval_t *cached_brightness;
 } led_channel_redgreen_t;
 
+#define REDGREEN_CHANNELS 2
+
+typedef struct
+{
+    led_channel_redgreen_t channel[REDGREEN_CHANNELS];
+    led_colormap_t         colormap;
+} led_data_redgreen_t;
+
 /* ------------------------------------------------------------------------- *
  * ONE_CHANNEL
  * ------------------------------------------------------------------------- */
@@ -73,7 +83,6 @@ static void        led_channel_redgreen_set_value   (const led_channel_redgreen_
  * ALL_CHANNELS
  * ------------------------------------------------------------------------- */
 
-static void        led_control_redgreen_map_color   (int r, int g, int b, int *red, int *green);
 static void        led_control_redgreen_value_cb    (void *data, int r, int g, int b);
 static void        led_control_redgreen_close_cb    (void *data);
 
@@ -143,45 +152,29 @@ led_channel_redgreen_set_value(const led_channel_redgreen_t *self, int value)
  * ALL_CHANNELS
  * ========================================================================= */
 
-#define REDGREEN_CHANNELS 2
-
-static void
-led_control_redgreen_map_color(int r, int g, int b, int *red, int *green)
-{
-    /* If the pattern defines red and/or green intensities, those should
-     * be used. Otherwise make sure that requesting for blue only colour
-     * does not result in the led being turned off. */
-    if( r || g )
-    {
-        *red   = r;
-        *green = g;
-    }
-    else
-    {
-        *red   = b;
-        *green = b;
-    }
-}
-
 static void
 led_control_redgreen_value_cb(void *data, int r, int g, int b)
 {
-    const led_channel_redgreen_t *channel = data;
+    const led_data_redgreen_t    *self    = data;
+    const led_channel_redgreen_t *channel = self->channel;
 
-    int red   = 0;
-    int green = 0;
-    led_control_redgreen_map_color(r, g, b, &red, &green);
+    /* Note that requesting for blue only colour maps to both
+     * channels instead of turning the led off */
+    int value[REDGREEN_CHANNELS];
+    led_colormap_map(&self->colormap, r, g, b, value);
 
-    led_channel_redgreen_set_value(channel + 0, red);
-    led_channel_redgreen_set_value(channel + 1, green);
+    led_channel_redgreen_set_value(channel + 0, value[0]);
+    led_channel_redgreen_set_value(channel + 1, value[1]);
 }
 
 static void
 led_control_redgreen_close_cb(void *data)
 {
-    led_channel_redgreen_t *channel = data;
+    led_data_redgreen_t    *self    = data;
+    led_channel_redgreen_t *channel = self->channel;
     led_channel_redgreen_close(channel + 0);
     led_channel_redgreen_close(channel + 1);
+    free(self);
 }
 
 static bool
@@ -262,7 +255,12 @@ cleanup:
 bool
 led_control_redgreen_probe(led_control_t *self)
 {
-    static led_channel_redgreen_t channel[REDGREEN_CHANNELS];
+    led_data_redgreen_t *data = calloc(1, sizeof *data);
+
+    if( !data )
+        return false;
+
+    led_channel_redgreen_t *channel = data->channel;
 
     bool res = false;
 
@@ -270,7 +268,7 @@ led_control_redgreen_probe(led_control_t *self)
     led_channel_redgreen_init(channel + 1);
 
     self->name   = "redgreen";
-    self->data   = channel;
+    self->data   = data;
     self->enable = 0;
     self->value  = led_control_redgreen_value_cb;
     self->close  = led_control_redgreen_close_cb;
@@ -279,14 +277,30 @@ led_control_redgreen_probe(led_control_t *self)
     self->can_breathe = true;
     self->breath_type = LED_RAMP_HARD_STEP;
 
+    /* Brightness changes do not need kernel settle time */
+    self->settle_type = LED_SETTLE_NONE;
+
     if( self->use_config )
         res = led_control_redgreen_dynamic_probe(channel);
 
-    if( !res )
+    if( !res && !self->config_only )
         res = led_control_redgreen_static_probe(channel);
 
-    if( !res )
+    if( res ) {
+        static const char * const names[REDGREEN_CHANNELS] =
+        {
+            "Red", "Green",
+        };
+        static const int colors[REDGREEN_CHANNELS][3] =
+        {
+            { 255, 0, 0 }, { 0, 255, 0 },
+        };
+        led_colormap_init(&data->colormap, REDGREEN_CHANNELS,
+                          names, colors, false);
+    }
+    else {
         led_control_close(self);
+    }
 
     return res;
 }
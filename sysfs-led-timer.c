@@ -0,0 +1,593 @@
+/** @file sysfs-led-timer.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Led engine timer backends
+ *
+ * The led engine uses one shared timer for all of its step/stop/slice
+ * timeouts. This module provides that timer via interchangeable
+ * backends:
+ *
+ * - glib: timeouts dispatched from mce mainloop, subject to mainloop
+ *   latency and stalls
+ *
+ * - thread: absolute timerfd deadlines waited on from a dedicated
+ *   epoll thread, with small timer slack for low jitter stepping
+ *
+ * - virtual: nothing fires by itself; the driver queries the deadline,
+ *   advances its virtual clock and calls led_timer_run()
+ *
+ * Deadlines are expressed in the led_util_get_tick() time domain.
+ * ========================================================================= */
+
+#include "sysfs-led-timer.h"
+
+#include "sysfs-led-util.h"
+#include "plugin-logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Timer slack used by the timer thread */
+#define LED_TIMER_THREAD_SLACK 50000 // [ns]
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Timer backend operations */
+typedef struct
+{
+  const char *name;
+  bool      (*init)  (void);
+  void      (*quit)  (void);
+  void      (*arm)   (int64_t due);
+  void      (*disarm)(void);
+} led_timer_backend_t;
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * GLIB
+ * ------------------------------------------------------------------------- */
+
+static gboolean  led_timer_glib_cb        (gpointer aptr);
+static bool      led_timer_glib_init      (void);
+static void      led_timer_glib_quit      (void);
+static void      led_timer_glib_arm       (int64_t due);
+static void      led_timer_glib_disarm    (void);
+
+/* ------------------------------------------------------------------------- *
+ * THREAD
+ * ------------------------------------------------------------------------- */
+
+static void     *led_timer_thread_cb      (void *aptr);
+static bool      led_timer_thread_init    (void);
+static void      led_timer_thread_quit    (void);
+static void      led_timer_thread_arm     (int64_t due);
+static void      led_timer_thread_disarm  (void);
+
+/* ------------------------------------------------------------------------- *
+ * VIRTUAL
+ * ------------------------------------------------------------------------- */
+
+static bool      led_timer_virtual_init   (void);
+static void      led_timer_virtual_quit   (void);
+static void      led_timer_virtual_arm    (int64_t due);
+static void      led_timer_virtual_disarm (void);
+
+/* ------------------------------------------------------------------------- *
+ * LED_TIMER
+ * ------------------------------------------------------------------------- */
+
+static void      led_timer_fire           (void);
+
+bool             led_timer_init           (led_timer_type_t type, led_timer_fire_fn fire);
+void             led_timer_quit           (void);
+bool             led_timer_is_ready       (void);
+led_timer_type_t led_timer_get_type       (void);
+led_timer_type_t led_timer_parse_type     (const char *name);
+void             led_timer_arm            (int64_t due);
+void             led_timer_disarm         (void);
+bool             led_timer_get_due        (int64_t *due);
+void             led_timer_run            (void);
+
+/* ========================================================================= *
+ * GLIB
+ * ========================================================================= */
+
+/** Glib timeout id */
+static guint   led_timer_glib_id  = 0;
+
+/** Time stamp [ms] the glib timeout is due at */
+static int64_t led_timer_glib_due = 0;
+
+static gboolean
+led_timer_glib_cb(gpointer aptr)
+{
+  (void) aptr;
+
+  if( led_timer_glib_id ) {
+    led_timer_glib_id = 0;
+    led_timer_fire();
+  }
+
+  return FALSE;
+}
+
+static bool
+led_timer_glib_init(void)
+{
+  return true;
+}
+
+static void
+led_timer_glib_quit(void)
+{
+  led_timer_glib_disarm();
+}
+
+static void
+led_timer_glib_arm(int64_t due)
+{
+  if( led_timer_glib_id ) {
+    if( due == led_timer_glib_due )
+      goto cleanup;
+    g_source_remove(led_timer_glib_id), led_timer_glib_id = 0;
+  }
+
+  int64_t now = led_util_get_tick();
+  guint   ms  = due > now ? (guint)(due - now) : 0;
+
+  led_timer_glib_due = due;
+  led_timer_glib_id  = g_timeout_add(ms, led_timer_glib_cb, 0);
+
+cleanup:
+
+  return;
+}
+
+static void
+led_timer_glib_disarm(void)
+{
+  if( led_timer_glib_id ) {
+    g_source_remove(led_timer_glib_id), led_timer_glib_id = 0;
+  }
+}
+
+/* ========================================================================= *
+ * THREAD
+ * ========================================================================= */
+
+/** Timerfd used for waiting the deadline */
+static int       led_timer_thread_tfd = -1;
+
+/** Eventfd used for waking up the thread for exit */
+static int       led_timer_thread_efd = -1;
+
+/** Timer thread, or 0 if not running */
+static pthread_t led_timer_thread_tid = 0;
+
+/** Timer thread main loop
+ *
+ * @param aptr unused
+ *
+ * @return 0 on thread exit - via pthread_join()
+ */
+static void *
+led_timer_thread_cb(void *aptr)
+{
+  (void) aptr;
+
+  int epfd = -1;
+
+  /* Leave signal handling to the mainloop thread */
+  sigset_t ss;
+  sigfillset(&ss);
+  pthread_sigmask(SIG_BLOCK, &ss, 0);
+
+  /* Keep the kernel from deferring our wakeups */
+  if( prctl(PR_SET_TIMERSLACK, LED_TIMER_THREAD_SLACK) == -1 )
+    mce_log(LL_WARN, "could not set timer slack: %m");
+
+  if( (epfd = epoll_create1(EPOLL_CLOEXEC)) == -1 ) {
+    mce_log(LL_ERR, "epoll_create: %m");
+    goto cleanup;
+  }
+
+  int fds[] = { led_timer_thread_tfd, led_timer_thread_efd };
+
+  for( size_t i = 0; i < G_N_ELEMENTS(fds); ++i ) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fds[i] };
+    if( epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) == -1 ) {
+      mce_log(LL_ERR, "epoll_ctl: %m");
+      goto cleanup;
+    }
+  }
+
+  for( ;; ) {
+    struct epoll_event ev[2];
+    int n = epoll_wait(epfd, ev, G_N_ELEMENTS(ev), -1);
+
+    if( n == -1 ) {
+      if( errno == EINTR )
+        continue;
+      mce_log(LL_ERR, "epoll_wait: %m");
+      goto cleanup;
+    }
+
+    bool fire = false;
+
+    for( int i = 0; i < n; ++i ) {
+      uint64_t cnt = 0;
+
+      if( ev[i].data.fd == led_timer_thread_efd )
+        goto cleanup;
+
+      if( read(led_timer_thread_tfd, &cnt, sizeof cnt) == sizeof cnt )
+        fire = true;
+    }
+
+    if( fire )
+      led_timer_fire();
+  }
+
+cleanup:
+
+  if( epfd != -1 )
+    close(epfd);
+
+  return 0;
+}
+
+static bool
+led_timer_thread_init(void)
+{
+  bool ack = false;
+
+  led_timer_thread_tfd = timerfd_create(CLOCK_MONOTONIC,
+                                        TFD_NONBLOCK | TFD_CLOEXEC);
+  if( led_timer_thread_tfd == -1 ) {
+    mce_log(LL_ERR, "timerfd_create: %m");
+    goto cleanup;
+  }
+
+  led_timer_thread_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if( led_timer_thread_efd == -1 ) {
+    mce_log(LL_ERR, "eventfd: %m");
+    goto cleanup;
+  }
+
+  if( pthread_create(&led_timer_thread_tid, 0,
+                     led_timer_thread_cb, 0) != 0 ) {
+    mce_log(LL_ERR, "could not start led timer thread");
+    /* content of tid is undefined on failure, force to zero */
+    led_timer_thread_tid = 0;
+    goto cleanup;
+  }
+
+  ack = true;
+
+cleanup:
+
+  if( !ack )
+    led_timer_thread_quit();
+
+  return ack;
+}
+
+static void
+led_timer_thread_quit(void)
+{
+  if( led_timer_thread_tid ) {
+    uint64_t cnt = 1;
+    if( write(led_timer_thread_efd, &cnt, sizeof cnt) == -1 )
+      mce_log(LL_ERR, "eventfd write: %m");
+    pthread_join(led_timer_thread_tid, 0);
+    led_timer_thread_tid = 0;
+  }
+
+  led_util_close_file(&led_timer_thread_efd);
+  led_util_close_file(&led_timer_thread_tfd);
+}
+
+static void
+led_timer_thread_arm(int64_t due)
+{
+  /* Note: all zero it_value would disarm the timer */
+  if( due < 1 )
+    due = 1;
+
+  struct itimerspec its;
+  memset(&its, 0, sizeof its);
+  its.it_value.tv_sec  = (time_t)(due / 1000);
+  its.it_value.tv_nsec = (long)(due % 1000) * 1000000;
+
+  if( timerfd_settime(led_timer_thread_tfd, TFD_TIMER_ABSTIME, &its, 0) == -1 )
+    mce_log(LL_ERR, "timerfd_settime: %m");
+}
+
+static void
+led_timer_thread_disarm(void)
+{
+  struct itimerspec its;
+  memset(&its, 0, sizeof its);
+
+  if( timerfd_settime(led_timer_thread_tfd, 0, &its, 0) == -1 )
+    mce_log(LL_ERR, "timerfd_settime: %m");
+}
+
+/* ========================================================================= *
+ * VIRTUAL
+ * ========================================================================= */
+
+/** Flag for: deadline is set */
+static bool    led_timer_virtual_pending = false;
+
+/** Time stamp [ms] the virtual timer is due at */
+static int64_t led_timer_virtual_due     = 0;
+
+static bool
+led_timer_virtual_init(void)
+{
+  led_timer_virtual_pending = false;
+  return true;
+}
+
+static void
+led_timer_virtual_quit(void)
+{
+  led_timer_virtual_pending = false;
+}
+
+static void
+led_timer_virtual_arm(int64_t due)
+{
+  led_timer_virtual_pending = true;
+  led_timer_virtual_due     = due;
+}
+
+static void
+led_timer_virtual_disarm(void)
+{
+  led_timer_virtual_pending = false;
+}
+
+/* ========================================================================= *
+ * LED_TIMER
+ * ========================================================================= */
+
+/** Lookup table for timer backends */
+static const led_timer_backend_t led_timer_backend_lut[] =
+{
+  [LED_TIMER_GLIB] =
+  {
+    .name   = "glib",
+    .init   = led_timer_glib_init,
+    .quit   = led_timer_glib_quit,
+    .arm    = led_timer_glib_arm,
+    .disarm = led_timer_glib_disarm,
+  },
+  [LED_TIMER_THREAD] =
+  {
+    .name   = "thread",
+    .init   = led_timer_thread_init,
+    .quit   = led_timer_thread_quit,
+    .arm    = led_timer_thread_arm,
+    .disarm = led_timer_thread_disarm,
+  },
+  [LED_TIMER_VIRTUAL] =
+  {
+    .name   = "virtual",
+    .init   = led_timer_virtual_init,
+    .quit   = led_timer_virtual_quit,
+    .arm    = led_timer_virtual_arm,
+    .disarm = led_timer_virtual_disarm,
+  },
+};
+
+/** Backend in use, or NULL if not initialized */
+static const led_timer_backend_t *led_timer_backend = 0;
+
+/** Function to call when timer expires */
+static led_timer_fire_fn led_timer_fire_cb = 0;
+
+/** Handle timer expiry from backend
+ */
+static void
+led_timer_fire(void)
+{
+  if( led_timer_fire_cb )
+    led_timer_fire_cb();
+}
+
+/** Take timer backend in use
+ *
+ * Backend that might be already in use is released first.
+ *
+ * @param type backend to use
+ * @param fire function to call when timer expires
+ *
+ * @return true on success, false on failure
+ */
+bool
+led_timer_init(led_timer_type_t type, led_timer_fire_fn fire)
+{
+  bool ack = false;
+
+  led_timer_quit();
+
+  if( (size_t)type >= G_N_ELEMENTS(led_timer_backend_lut) ) {
+    mce_log(LL_ERR, "invalid led timer backend: %d", type);
+    goto cleanup;
+  }
+
+  const led_timer_backend_t *backend = &led_timer_backend_lut[type];
+
+  led_timer_fire_cb = fire;
+
+  if( !backend->init() ) {
+    led_timer_fire_cb = 0;
+    goto cleanup;
+  }
+
+  mce_log(LL_DEBUG, "using %s led timer", backend->name);
+  led_timer_backend = backend;
+  ack = true;
+
+cleanup:
+
+  return ack;
+}
+
+/** Release timer backend
+ *
+ * Note: If the backend uses a thread, it is joined - which must
+ * not be done while holding locks the fire callback needs.
+ */
+void
+led_timer_quit(void)
+{
+  if( led_timer_backend ) {
+    led_timer_backend->quit();
+    led_timer_backend = 0;
+  }
+
+  led_timer_fire_cb = 0;
+}
+
+/** Check if a timer backend is in use
+ */
+bool
+led_timer_is_ready(void)
+{
+  return led_timer_backend != 0;
+}
+
+/** Get type of timer backend in use
+ *
+ * @return backend type, or LED_TIMER_GLIB if not initialized
+ */
+led_timer_type_t
+led_timer_get_type(void)
+{
+  led_timer_type_t type = LED_TIMER_GLIB;
+
+  if( led_timer_backend )
+    type = (led_timer_type_t)(led_timer_backend - led_timer_backend_lut);
+
+  return type;
+}
+
+/** Map backend name used in config to backend type
+ *
+ * @param name backend name, or NULL
+ *
+ * @return backend type, or LED_TIMER_GLIB if name is not recognized
+ */
+led_timer_type_t
+led_timer_parse_type(const char *name)
+{
+  led_timer_type_t type = LED_TIMER_GLIB;
+
+  for( size_t i = 0; name && i < G_N_ELEMENTS(led_timer_backend_lut); ++i ) {
+    if( !strcmp(led_timer_backend_lut[i].name, name) ) {
+      type = (led_timer_type_t)i;
+      break;
+    }
+  }
+
+  return type;
+}
+
+/** Set timer to expire at given time
+ *
+ * @param due time stamp [ms] in led_util_get_tick() time domain
+ */
+void
+led_timer_arm(int64_t due)
+{
+  if( led_timer_backend )
+    led_timer_backend->arm(due);
+}
+
+/** Cancel pending timer
+ */
+void
+led_timer_disarm(void)
+{
+  if( led_timer_backend )
+    led_timer_backend->disarm();
+}
+
+/** Get time stamp when virtual timer is due
+ *
+ * @param due where to store time stamp [ms]
+ *
+ * @return true if virtual timer is in use and armed, false otherwise
+ */
+bool
+led_timer_get_due(int64_t *due)
+{
+  bool ack = false;
+
+  if( led_timer_backend == &led_timer_backend_lut[LED_TIMER_VIRTUAL] &&
+      led_timer_virtual_pending ) {
+    *due = led_timer_virtual_due;
+    ack = true;
+  }
+
+  return ack;
+}
+
+/** Expire virtual timer
+ *
+ * Should be called after advancing virtual clock to the time
+ * returned by led_timer_get_due().
+ */
+void
+led_timer_run(void)
+{
+  if( led_timer_backend == &led_timer_backend_lut[LED_TIMER_VIRTUAL] &&
+      led_timer_virtual_pending ) {
+    led_timer_virtual_pending = false;
+    led_timer_fire();
+  }
+}
@@ -0,0 +1,68 @@
+/** @file sysfs-led-timer.h
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef  SYSFS_LED_TIMER_H_
+# define SYSFS_LED_TIMER_H_
+
+# include <stdbool.h>
+# include <stdint.h>
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Available led engine timer backends
+ */
+typedef enum
+{
+  /** Glib timeouts dispatched from mce mainloop */
+  LED_TIMER_GLIB    = 0,
+
+  /** Timerfd dispatched from a dedicated thread */
+  LED_TIMER_THREAD  = 1,
+
+  /** Manually driven, for use together with a virtual clock */
+  LED_TIMER_VIRTUAL = 2,
+} led_timer_type_t;
+
+/** Function called when the timer expires
+ *
+ * Note: Can be called from a worker thread, depending on backend.
+ */
+typedef void (*led_timer_fire_fn)(void);
+
+/* ========================================================================= *
+ * FUNCTIONS
+ * ========================================================================= */
+
+bool             led_timer_init      (led_timer_type_t type, led_timer_fire_fn fire);
+void             led_timer_quit      (void);
+bool             led_timer_is_ready  (void);
+led_timer_type_t led_timer_get_type  (void);
+led_timer_type_t led_timer_parse_type(const char *name);
+void             led_timer_arm       (int64_t due);
+void             led_timer_disarm    (void);
+bool             led_timer_get_due   (int64_t *due);
+void             led_timer_run       (void);
+
+#endif /* SYSFS_LED_TIMER_H_ */
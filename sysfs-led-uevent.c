@@ -0,0 +1,271 @@
+/** @file sysfs-led-uevent.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Kernel uevent monitoring for led class devices
+ *
+ * Led drivers that are built as modules can get loaded after mce has
+ * already started and failed to find a suitable led backend. Kernel
+ * uevents are received via netlink socket and "add" events from the
+ * "leds" subsystem are passed to a callback so that probing can be
+ * retried when something relevant has changed.
+ * ========================================================================= */
+
+#include "sysfs-led-uevent.h"
+
+#include "plugin-logging.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Netlink multicast group for events sent directly by kernel */
+#define SYSFS_LED_UEVENT_KERNEL_GROUP 1
+
+/** Subsystem we are interested in */
+#define SYSFS_LED_UEVENT_SUBSYSTEM "leds"
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+static bool     sysfs_led_uevent_parse (const char *data, size_t size);
+static gboolean sysfs_led_uevent_rx_cb (GIOChannel *chn, GIOCondition cnd, gpointer aptr);
+
+bool            sysfs_led_uevent_start (sysfs_led_uevent_fn cb);
+void            sysfs_led_uevent_stop  (void);
+
+/* ========================================================================= *
+ * STATE
+ * ========================================================================= */
+
+/** Netlink socket */
+static int                 sysfs_led_uevent_fd = -1;
+
+/** Glib io watch for the netlink socket */
+static guint               sysfs_led_uevent_id = 0;
+
+/** Function to call when led class devices are added */
+static sysfs_led_uevent_fn sysfs_led_uevent_cb = 0;
+
+/* ========================================================================= *
+ * FUNCTIONS
+ * ========================================================================= */
+
+/** Check if uevent message is about added led class device
+ *
+ * Kernel uevent messages consist of "action@devpath" header followed
+ * by "KEY=value" properties, all separated by nul characters.
+ *
+ * @param data message content
+ * @param size message size
+ *
+ * @return true if message is relevant, false otherwise
+ */
+static bool
+sysfs_led_uevent_parse(const char *data, size_t size)
+{
+    const char *action    = 0;
+    const char *subsystem = 0;
+    const char *devpath   = 0;
+
+    const char *end = data + size;
+
+    /* Skip header, all information is available as properties */
+    for( const char *pos = data + strnlen(data, size) + 1; pos < end;
+         pos += strnlen(pos, end - pos) + 1 ) {
+        if( !strncmp(pos, "ACTION=", 7) )
+            action = pos + 7;
+        else if( !strncmp(pos, "SUBSYSTEM=", 10) )
+            subsystem = pos + 10;
+        else if( !strncmp(pos, "DEVPATH=", 8) )
+            devpath = pos + 8;
+    }
+
+    if( !action || !subsystem )
+        return false;
+
+    if( strcmp(subsystem, SYSFS_LED_UEVENT_SUBSYSTEM) )
+        return false;
+
+    if( strcmp(action, "add") )
+        return false;
+
+    mce_log(LOG_DEBUG, "led added: %s", devpath ?: "unknown");
+    return true;
+}
+
+/** Glib io watch callback for receiving uevents
+ *
+ * @param chn  io channel (unused)
+ * @param cnd  io condition
+ * @param aptr user data (unused)
+ *
+ * @return TRUE to keep the watch alive, FALSE to remove it
+ */
+static gboolean
+sysfs_led_uevent_rx_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
+{
+    (void)chn;
+    (void)aptr;
+
+    gboolean            keep  = FALSE;
+    bool                added = false;
+    sysfs_led_uevent_fn cb    = sysfs_led_uevent_cb;
+
+    if( !sysfs_led_uevent_id )
+        goto EXIT;
+
+    if( cnd & ~G_IO_IN ) {
+        mce_log(LOG_ERR, "uevent socket: unexpected poll condition 0x%x",
+                (unsigned)cnd);
+        goto EXIT;
+    }
+
+    /* Drain all queued messages */
+    for( ;; ) {
+        char data[8192];
+
+        ssize_t done = recv(sysfs_led_uevent_fd, data, sizeof data - 1, 0);
+
+        if( done == -1 ) {
+            if( errno == EINTR )
+                continue;
+
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                break;
+
+            /* Events were lost, assume something relevant happened */
+            if( errno == ENOBUFS ) {
+                mce_log(LOG_WARNING, "uevent socket: overflow");
+                added = true;
+                continue;
+            }
+
+            mce_log(LOG_ERR, "uevent socket: recv: %m");
+            goto EXIT;
+        }
+
+        data[done] = 0;
+
+        if( sysfs_led_uevent_parse(data, done) )
+            added = true;
+    }
+
+    keep = TRUE;
+
+EXIT:
+    if( !keep && sysfs_led_uevent_id ) {
+        sysfs_led_uevent_id = 0;
+        sysfs_led_uevent_stop();
+    }
+
+    if( added && cb )
+        cb();
+
+    return keep;
+}
+
+/** Start listening to led class uevents
+ *
+ * @param cb function to call when led class devices are added
+ *
+ * @return true if monitoring was started, false otherwise
+ */
+bool
+sysfs_led_uevent_start(sysfs_led_uevent_fn cb)
+{
+    bool        ack = false;
+    GIOChannel *chn = 0;
+
+    sysfs_led_uevent_stop();
+
+    sysfs_led_uevent_fd = socket(AF_NETLINK,
+                                 SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                 NETLINK_KOBJECT_UEVENT);
+    if( sysfs_led_uevent_fd == -1 ) {
+        mce_log(LOG_ERR, "uevent socket: %m");
+        goto EXIT;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof addr);
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = SYSFS_LED_UEVENT_KERNEL_GROUP;
+
+    if( bind(sysfs_led_uevent_fd, (struct sockaddr *)&addr, sizeof addr) == -1 ) {
+        mce_log(LOG_ERR, "uevent socket: bind: %m");
+        goto EXIT;
+    }
+
+    if( !(chn = g_io_channel_unix_new(sysfs_led_uevent_fd)) )
+        goto EXIT;
+
+    g_io_channel_set_close_on_unref(chn, FALSE);
+
+    sysfs_led_uevent_id = g_io_add_watch(chn, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                         sysfs_led_uevent_rx_cb, 0);
+    if( !sysfs_led_uevent_id )
+        goto EXIT;
+
+    sysfs_led_uevent_cb = cb;
+
+    mce_log(LOG_DEBUG, "monitoring led uevents");
+
+    ack = true;
+
+EXIT:
+    /* The watch holds a reference to the channel */
+    if( chn )
+        g_io_channel_unref(chn);
+
+    if( !ack )
+        sysfs_led_uevent_stop();
+
+    return ack;
+}
+
+/** Stop listening to led class uevents
+ */
+void
+sysfs_led_uevent_stop(void)
+{
+    if( sysfs_led_uevent_id ) {
+        mce_log(LOG_DEBUG, "stop monitoring led uevents");
+        g_source_remove(sysfs_led_uevent_id), sysfs_led_uevent_id = 0;
+    }
+
+    if( sysfs_led_uevent_fd != -1 )
+        close(sysfs_led_uevent_fd), sysfs_led_uevent_fd = -1;
+
+    sysfs_led_uevent_cb = 0;
+}
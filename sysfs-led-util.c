@@ -26,20 +26,28 @@
 #include "plugin-logging.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 /* ========================================================================= *
  * PROTOTYPES
  * ========================================================================= */
 
-int  led_util_read_number(const char *path);
-void led_util_close_file (int *fd_ptr);
-bool led_util_open_file  (int *fd_ptr, const char *path);
-int  led_util_scale_value(int in, int max);
-int  led_util_gcd        (int a, int b);
-int  led_util_roundup    (int val, int range);
+int     led_util_read_number(const char *path);
+void    led_util_close_file (int *fd_ptr);
+bool    led_util_open_file  (int *fd_ptr, const char *path);
+int     led_util_scale_value(int in, int max);
+int     led_util_gcd        (int a, int b);
+int     led_util_roundup    (int val, int range);
+int64_t led_util_get_tick_us(void);
+int64_t led_util_get_tick   (void);
+void    led_util_set_clock  (led_util_clock_fn fn);
+void    led_util_set_root   (const char *root);
+char   *led_util_root_path  (const char *path);
 
 /* ========================================================================= *
  * FUNCTIONS
@@ -54,7 +62,9 @@ led_util_read_number(const char *path)
   int fd  = -1;
   char tmp[64];
 
-  if( (fd = open(path, O_RDONLY)) == -1 ) {
+  char *real = led_util_root_path(path);
+
+  if( !real || (fd = open(real, O_RDONLY)) == -1 ) {
     goto cleanup;
   }
   int rc = read(fd, tmp, sizeof tmp - 1);
@@ -68,6 +78,8 @@ cleanup:
 
   if( fd != -1 ) close(fd);
 
+  free(real);
+
   return res;
 }
 
@@ -93,7 +105,9 @@ led_util_open_file(int *fd_ptr, const char *path)
 
   if( fd_ptr && path )
   {
-    if( (*fd_ptr = open(path, O_WRONLY|O_APPEND)) != -1 )
+    char *real = led_util_root_path(path);
+
+    if( real && (*fd_ptr = open(real, O_WRONLY|O_APPEND)) != -1 )
     {
       res = true;
     }
@@ -101,6 +115,8 @@ led_util_open_file(int *fd_ptr, const char *path)
     {
       mce_log(LL_WARN, "%s: %s: %m", path, "open");
     }
+
+    free(real);
   }
 
   return res;
@@ -145,3 +161,102 @@ led_util_roundup(int val, int range)
   if( extra ) extra = range - extra;
   return val + extra;
 }
+
+/** Replacement clock function, or NULL to use CLOCK_MONOTONIC */
+static led_util_clock_fn led_util_clock = 0;
+
+/** Get monotonic time stamp in microseconds
+ */
+int64_t
+led_util_get_tick_us(void)
+{
+  int64_t res = 0;
+  struct timespec ts;
+
+  if( led_util_clock ) {
+    res = led_util_clock();
+  }
+  else if( clock_gettime(CLOCK_MONOTONIC, &ts) == 0 ) {
+    res = ts.tv_sec;
+    res *= 1000000;
+    res += ts.tv_nsec / 1000;
+  }
+
+  return res;
+}
+
+/** Get monotonic time stamp in milliseconds
+ */
+int64_t
+led_util_get_tick(void)
+{
+  return led_util_get_tick_us() / 1000;
+}
+
+/** Replace the clock used for led timelines
+ *
+ * Allows running led engine against a virtual clock, so that
+ * timing behavior can be evaluated without real hardware.
+ *
+ * @param fn clock function, or NULL to use CLOCK_MONOTONIC
+ */
+void
+led_util_set_clock(led_util_clock_fn fn)
+{
+  led_util_clock = fn;
+}
+
+/** Root directory prepended to sysfs paths, or NULL for real sysfs */
+static char *led_util_root = 0;
+
+/** Redirect sysfs accesses to a directory tree
+ *
+ * Allows probing led backends and making writes against a fake
+ * sysfs tree, e.g. "/tmp/fake" makes "/sys/class/leds/red/brightness"
+ * to be accessed as "/tmp/fake/sys/class/leds/red/brightness".
+ *
+ * Must not be called while led probing or writes are in progress.
+ *
+ * @param root root directory, or NULL / empty string for real sysfs
+ */
+void
+led_util_set_root(const char *root)
+{
+  free(led_util_root), led_util_root = 0;
+
+  if( root && *root && strcmp(root, "/") ) {
+    led_util_root = strdup(root);
+    mce_log(LL_NOTICE, "sysfs root: %s", root);
+  }
+}
+
+/** Map sysfs path to the path that should actually be accessed
+ *
+ * Paths used in backends, configuration and led class index always
+ * refer to real sysfs; this should be used only when opening files
+ * and directories.
+ *
+ * @param path absolute sysfs path
+ *
+ * @return path under configured root, to be released with free()
+ */
+char *
+led_util_root_path(const char *path)
+{
+  char *res = 0;
+
+  if( !path ) {
+    goto cleanup;
+  }
+
+  if( !led_util_root || *path != '/' ) {
+    res = strdup(path);
+  }
+  else if( asprintf(&res, "%s%s", led_util_root, path) < 0 ) {
+    res = 0;
+  }
+
+cleanup:
+
+  return res;
+}
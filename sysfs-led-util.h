@@ -25,12 +25,21 @@
 # define SYSFS_LED_UTIL_H_
 
 # include <stdbool.h>
+# include <stdint.h>
 
-int  led_util_read_number (const char *path);
-void led_util_close_file  (int *fd_ptr);
-bool led_util_open_file   (int *fd_ptr, const char *path);
-int  led_util_scale_value (int in, int max);
-int  led_util_gcd         (int a, int b);
-int  led_util_roundup     (int val, int range);
+/** Clock function returning monotonic time stamp in microseconds */
+typedef int64_t (*led_util_clock_fn)(void);
+
+int     led_util_read_number (const char *path);
+void    led_util_close_file  (int *fd_ptr);
+bool    led_util_open_file   (int *fd_ptr, const char *path);
+int     led_util_scale_value (int in, int max);
+int     led_util_gcd         (int a, int b);
+int     led_util_roundup     (int val, int range);
+int64_t led_util_get_tick_us (void);
+int64_t led_util_get_tick    (void);
+void    led_util_set_clock   (led_util_clock_fn fn);
+void    led_util_set_root    (const char *root);
+char   *led_util_root_path   (const char *path);
 
 #endif /* SYSFS_LED_UTIL_H_ */
@@ -48,9 +48,13 @@
 #include "sysfs-led-vanilla.h"
 #include "sysfs-led-util.h"
 #include "sysfs-val.h"
+#include "sysfs-val-group.h"
 #include "plugin-config.h"
+#include "plugin-quirks.h"
+#include "plugin-logging.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -76,6 +80,8 @@ typedef struct
   sysfsval_t *cached_blink_delay_on;
   sysfsval_t *cached_blink_delay_off;
   sysfsval_t *cached_blink;
+  sysfsval_t *cached_hw_changed;
+  sysfsvalgroup_t *group;
 } led_channel_vanilla_t;
 
 /* ------------------------------------------------------------------------- *
@@ -87,6 +93,8 @@ static void        led_channel_vanilla_close         (led_channel_vanilla_t *sel
 static bool        led_channel_vanilla_probe         (led_channel_vanilla_t *self, const led_paths_vanilla_t *path);
 static void        led_channel_vanilla_set_value     (led_channel_vanilla_t *self, int value);
 static void        led_channel_vanilla_set_blink     (led_channel_vanilla_t *self, int on_ms, int off_ms);
+static void        led_channel_vanilla_changed_cb    (sysfsval_t *value, void *aptr);
+static void        led_channel_vanilla_watch         (led_channel_vanilla_t *self);
 
 /* ------------------------------------------------------------------------- *
  * ALL_CHANNELS
@@ -95,6 +103,7 @@ static void        led_channel_vanilla_set_blink     (led_channel_vanilla_t *sel
 static void        led_control_vanilla_blink_cb      (void *data, int on_ms, int off_ms);
 static void        led_control_vanilla_value_cb      (void *data, int r, int g, int b);
 static void        led_control_vanilla_close_cb      (void *data);
+static bool        led_control_vanilla_can_watch     (void);
 
 bool               led_control_vanilla_probe         (led_control_t *self);
 
@@ -110,11 +119,30 @@ led_channel_vanilla_init(led_channel_vanilla_t *self)
   self->cached_blink_delay_on  = sysfsval_create();
   self->cached_blink_delay_off = sysfsval_create();
   self->cached_blink               = sysfsval_create();
+  self->cached_hw_changed      = sysfsval_create();
+
+  /* Blinking config is taken in use when brightness sysfs is
+   * written to, and blinking enabled/disabled needs to happen
+   * after the brightness has been set */
+  self->group = sysfsvalgroup_create();
+  sysfsvalgroup_invalidates(self->group, self->cached_blink_delay_on,
+                            self->cached_brightness);
+  sysfsvalgroup_invalidates(self->group, self->cached_blink_delay_on,
+                            self->cached_blink);
+  sysfsvalgroup_invalidates(self->group, self->cached_blink_delay_off,
+                            self->cached_brightness);
+  sysfsvalgroup_invalidates(self->group, self->cached_blink_delay_off,
+                            self->cached_blink);
+  sysfsvalgroup_precedes(self->group, self->cached_brightness,
+                         self->cached_blink);
 }
 
 static void
 led_channel_vanilla_close(led_channel_vanilla_t *self)
 {
+  sysfsvalgroup_delete(self->group),
+    self->group = 0;
+
   sysfsval_delete(self->cached_max_brightness),
     self->cached_max_brightness = 0;
 
@@ -129,6 +157,9 @@ led_channel_vanilla_close(led_channel_vanilla_t *self)
 
   sysfsval_delete(self->cached_blink),
     self->cached_blink = 0;
+
+  sysfsval_delete(self->cached_hw_changed),
+    self->cached_hw_changed = 0;
 }
 
 static bool
@@ -184,30 +215,58 @@ led_channel_vanilla_set_value(led_channel_vanilla_t *self, int value)
 {
   value = led_util_scale_value(value,
                                sysfsval_get(self->cached_max_brightness));
-  sysfsval_set(self->cached_brightness, value);
+  sysfsvalgroup_set(self->group, self->cached_brightness, value);
 
   value = (sysfsval_get(self->cached_blink_delay_on) &&
            sysfsval_get(self->cached_blink_delay_off));
-  sysfsval_set(self->cached_blink, value);
+  sysfsvalgroup_set(self->group, self->cached_blink, value);
 
+  sysfsvalgroup_commit(self->group);
 }
 static void
 led_channel_vanilla_set_blink(led_channel_vanilla_t *self,
                               int on_ms, int off_ms)
 {
-  /* Note: Blinking config is taken in use when brightness
-   *       sysfs is written to -> we need to invalidate
-   *       cached brightness value if blinking changes
-   *       are made.
+  /* Note: Cached brightness and blink values get invalidated
+   *       by the group if blinking changes are actually made,
+   *       see led_channel_vanilla_init().
    */
-  sysfsval_set(self->cached_blink_delay_on,   on_ms);
-  sysfsval_set(self->cached_blink_delay_off, off_ms);
+  sysfsvalgroup_set(self->group, self->cached_blink_delay_on,   on_ms);
+  sysfsvalgroup_set(self->group, self->cached_blink_delay_off, off_ms);
+  sysfsvalgroup_commit(self->group);
+}
+
+static void
+led_channel_vanilla_changed_cb(sysfsval_t *value, void *aptr)
+{
+  led_channel_vanilla_t *self = aptr;
+
+  mce_log(LL_DEBUG, "%s: changed by hw to %d",
+          sysfsval_path(value), sysfsval_get(value));
+
+  /* Brightness is no longer what we wrote last - make sure the
+   * next write is not skipped. The cache is shared with led
+   * engine timer callbacks, so the engine lock is needed. */
+  sysfs_led_lock();
   sysfsval_invalidate(self->cached_brightness);
+  sysfs_led_unlock();
+}
 
-  /* Note: Blinking enabled/disabled needs to happen
-   *       after the brightness has been set
-   */
-  sysfsval_invalidate(self->cached_blink);
+static void
+led_channel_vanilla_watch(led_channel_vanilla_t *self)
+{
+  /* Writes to "brightness" are not sysfs_notify()ed, changes made
+   * by hardware are signaled via "brightness_hw_changed" instead */
+  gchar *dir  = g_path_get_dirname(sysfsval_path(self->cached_brightness));
+  gchar *path = g_strconcat(dir, "/brightness_hw_changed", NULL);
+
+  if( sysfsval_open_ro(self->cached_hw_changed, path) &&
+      !sysfsval_watch(self->cached_hw_changed,
+                      led_channel_vanilla_changed_cb, self) )
+    sysfsval_close(self->cached_hw_changed);
+
+  g_free(path);
+  g_free(dir);
 }
 
 /* ========================================================================= *
@@ -241,6 +300,39 @@ led_control_vanilla_close_cb(void *data)
   led_channel_vanilla_close(channel + 0);
   led_channel_vanilla_close(channel + 1);
   led_channel_vanilla_close(channel + 2);
+  free(channel);
+}
+
+/** Check if sysfs change notifications can be used
+ *
+ * Notifications are handled in mainloop. Writes made from led writer
+ * thread are not done under the engine lock, and sysfsval objects are
+ * not thread safe otherwise either - so notifications are used only
+ * when all sysfs access happens from mainloop.
+ */
+static bool
+led_control_vanilla_can_watch(void)
+{
+  bool ack = false;
+
+  if( !QUIRK(QUIRK_SYSFS_NOTIFY, false) )
+    goto cleanup;
+
+  if( QUIRK(QUIRK_WRITER_THREAD, false) ) {
+    mce_log(LL_WARN, "sysfs notify quirk ignored: writer thread in use");
+    goto cleanup;
+  }
+
+  if( led_timer_get_type() == LED_TIMER_THREAD ) {
+    mce_log(LL_WARN, "sysfs notify quirk ignored: thread timer in use");
+    goto cleanup;
+  }
+
+  ack = true;
+
+cleanup:
+
+  return ack;
 }
 
 static bool
@@ -398,7 +490,10 @@ bool
 led_control_vanilla_probe(led_control_t *self)
 {
 
-  static led_channel_vanilla_t channel[VANILLA_CHANNELS];
+  led_channel_vanilla_t *channel = calloc(VANILLA_CHANNELS, sizeof *channel);
+
+  if( !channel )
+    return false;
 
   bool res = false;
 
@@ -413,14 +508,24 @@ led_control_vanilla_probe(led_control_t *self)
   self->value  = led_control_vanilla_value_cb;
   self->close  = led_control_vanilla_close_cb;
 
+  /* Intensity changes can be made back to back, but kernel
+   * needs some time to deal with blink config changes */
+  self->settle_type = LED_SETTLE_BLINK;
+
   if( self->use_config )
     res = led_control_vanilla_dynamic_probe(channel);
 
-  if( !res )
+  if( !res && !self->config_only )
     res = led_control_vanilla_static_probe(channel);
 
   if( !res )
     led_control_close(self);
+  else if( led_control_vanilla_can_watch() ) {
+    // keep cached brightness in sync with hw initiated changes
+    led_channel_vanilla_watch(channel+0);
+    led_channel_vanilla_watch(channel+1);
+    led_channel_vanilla_watch(channel+2);
+  }
 
   return res;
 }
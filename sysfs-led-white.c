@@ -32,10 +32,12 @@
 #include "sysfs-led-white.h"
 
 #include "sysfs-led-util.h"
+#include "sysfs-led-colormap.h"
 #include "sysfs-val.h"
 #include "plugin-config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
@@ -56,6 +58,14 @@ typedef struct
     sysfsval_t *cached_brightness;
 } led_channel_white_t;
 
+#define WHITE_CHANNELS 1
+
+typedef struct
+{
+    led_channel_white_t channel[WHITE_CHANNELS];
+    led_colormap_t      colormap;
+} led_data_white_t;
+
 /* ------------------------------------------------------------------------- *
  * ONE_CHANNEL
  * ------------------------------------------------------------------------- */
@@ -69,7 +79,6 @@ static void led_channel_white_set_value (const led_channel_white_t *self, int va
  * ALL_CHANNELS
  * ------------------------------------------------------------------------- */
 
-static void led_control_white_map_color (int r, int g, int b, int *white);
 static void led_control_white_value_cb  (void *data, int r, int g, int b);
 static void led_control_white_close_cb  (void *data);
 
@@ -141,33 +150,25 @@ led_channel_white_set_value(const led_channel_white_t *self, int value)
  * ALL_CHANNELS
  * ========================================================================= */
 
-#define WHITE_CHANNELS 1
-
-static void
-led_control_white_map_color(int r, int g, int b, int *white)
-{
-    /* Use maximum value from requested RGB value */
-    if( r < g ) r = g;
-    if( r < b ) r = b;
-    *white = r;
-}
-
 static void
 led_control_white_value_cb(void *data, int r, int g, int b)
 {
-    const led_channel_white_t *channel = data;
+    const led_data_white_t    *self    = data;
+    const led_channel_white_t *channel = self->channel;
 
-    int white = 0;
-    led_control_white_map_color(r, g, b, &white);
+    int value[WHITE_CHANNELS];
+    led_colormap_map(&self->colormap, r, g, b, value);
 
-    led_channel_white_set_value(channel + 0, white);
+    led_channel_white_set_value(channel + 0, value[0]);
 }
 
 static void
 led_control_white_close_cb(void *data)
 {
-    led_channel_white_t *channel = data;
+    led_data_white_t    *self    = data;
+    led_channel_white_t *channel = self->channel;
     led_channel_white_close(channel + 0);
+    free(self);
 }
 static bool
 led_control_white_static_probe(led_channel_white_t *channel)
@@ -239,14 +240,19 @@ bool
 led_control_white_probe(led_control_t *self)
 {
 
-    static led_channel_white_t channel[WHITE_CHANNELS];
+    led_data_white_t *data = calloc(1, sizeof *data);
+
+    if( !data )
+        return false;
+
+    led_channel_white_t *channel = data->channel;
 
     bool res = false;
 
     led_channel_white_init(channel + 0);
 
     self->name   = "white";
-    self->data   = channel;
+    self->data   = data;
     self->enable = 0;
     self->value  = led_control_white_value_cb;
     self->close  = led_control_white_close_cb;
@@ -254,14 +260,31 @@ led_control_white_probe(led_control_t *self)
     /* We can use sw breathing logic */
     self->can_breathe = true;
 
+    /* Brightness changes do not need kernel settle time */
+    self->settle_type = LED_SETTLE_NONE;
+
     if( self->use_config )
         res = led_control_white_dynamic_probe(channel);
 
-    if( !res )
+    if( !res && !self->config_only )
         res = led_control_white_static_probe(channel);
 
-    if( !res )
+    if( res ) {
+        /* Single channel: brightness follows the dominant component */
+        static const char * const names[WHITE_CHANNELS] =
+        {
+            "Led",
+        };
+        static const int colors[WHITE_CHANNELS][3] =
+        {
+            { 255, 255, 255 },
+        };
+        led_colormap_init(&data->colormap, WHITE_CHANNELS,
+                          names, colors, true);
+    }
+    else {
         led_control_close(self);
+    }
 
     return res;
 }
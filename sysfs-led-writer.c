@@ -0,0 +1,450 @@
+/** @file sysfs-led-writer.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Led writer thread
+ *
+ * Takes over the callbacks of a led control backend so that the actual
+ * sysfs writes are made from a dedicated worker thread.
+ *
+ * - The mainloop side just queues the requested blink and color
+ *   settings and wakes up the worker -> mce mainloop does not get
+ *   blocked even if the backend writes do.
+ *
+ * - Intermediate states that have been superseded before the worker
+ *   gets to them are skipped. Otherwise writes are made in request
+ *   order. Resets to blink off / black act as barriers, i.e. they are
+ *   never skipped and nothing is superseded across them.
+ *
+ * - Latency of each backend write is recorded and slow writes are
+ *   logged so that problematic led channels can be identified.
+ * ========================================================================= */
+
+#include "sysfs-led-writer.h"
+
+#include "sysfs-led-util.h"
+#include "plugin-logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Backend writes taking longer than this are logged */
+#define LED_WRITER_SLOW_WRITE 20000 // [us]
+
+/** Maximum number of queued backend writes */
+#define LED_WRITER_QUEUE_MAX 16
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Types of backend writes */
+typedef enum
+{
+  LED_WRITE_BLINK,
+  LED_WRITE_VALUE,
+
+  LED_WRITE_COUNT
+} led_write_t;
+
+/** Queued backend write */
+typedef struct
+{
+  led_write_t type;
+  int         arg[3];
+} led_request_t;
+
+/** Latency statistics for one type of backend writes */
+typedef struct
+{
+  unsigned count;
+  unsigned slow;
+  int64_t  total_us;
+  int64_t  max_us;
+} led_latency_t;
+
+/** Writer thread state */
+typedef struct
+{
+  /** The backend that does the actual writing */
+  led_control_t   backend;
+
+  pthread_t       thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  pthread_cond_t  space;
+  bool            running;
+  bool            exiting;
+
+  /** Pending backend writes, in request order */
+  led_request_t   queue[LED_WRITER_QUEUE_MAX];
+  size_t          queued;
+
+  /** Write latency statistics */
+  led_latency_t   latency[LED_WRITE_COUNT];
+} led_writer_t;
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+static const char   *led_write_repr          (led_write_t type);
+
+static bool          led_request_is_reset    (const led_request_t *self);
+
+static led_writer_t *led_writer_create       (const led_control_t *backend);
+static void          led_writer_delete       (led_writer_t *self);
+static void          led_writer_record       (led_writer_t *self, led_write_t type, int64_t us);
+static void          led_writer_log_stats    (const led_writer_t *self);
+static void          led_writer_push         (led_writer_t *self, const led_request_t *req);
+static void         *led_writer_thread_cb    (void *aptr);
+static bool          led_writer_start        (led_writer_t *self);
+static void          led_writer_stop         (led_writer_t *self);
+
+static void          led_writer_blink_cb     (void *data, int on_ms, int off_ms);
+static void          led_writer_value_cb     (void *data, int r, int g, int b);
+static void          led_writer_close_cb     (void *data);
+
+bool                 led_writer_attach       (led_control_t *control);
+
+/* ========================================================================= *
+ * LED_WRITE
+ * ========================================================================= */
+
+static const char *
+led_write_repr(led_write_t type)
+{
+  static const char * const lut[LED_WRITE_COUNT] =
+  {
+    [LED_WRITE_BLINK] = "blink",
+    [LED_WRITE_VALUE] = "value",
+  };
+
+  return lut[type];
+}
+
+/* ========================================================================= *
+ * LED_REQUEST
+ * ========================================================================= */
+
+/** Check if write request resets led to blink off / black state
+ */
+static bool
+led_request_is_reset(const led_request_t *self)
+{
+  bool reset = false;
+
+  switch( self->type ) {
+  case LED_WRITE_BLINK:
+    reset = (self->arg[0] <= 0 || self->arg[1] <= 0);
+    break;
+  case LED_WRITE_VALUE:
+    reset = (self->arg[0] | self->arg[1] | self->arg[2]) == 0;
+    break;
+  default:
+    break;
+  }
+
+  return reset;
+}
+
+/* ========================================================================= *
+ * LED_WRITER
+ * ========================================================================= */
+
+/** Create writer object for given backend
+ *
+ * @param backend  probed led control backend
+ *
+ * @return writer object, or NULL on failure
+ */
+static led_writer_t *
+led_writer_create(const led_control_t *backend)
+{
+  led_writer_t *self = calloc(1, sizeof *self);
+
+  if( self ) {
+    self->backend = *backend;
+    pthread_mutex_init(&self->mutex, 0);
+    pthread_cond_init(&self->cond, 0);
+    pthread_cond_init(&self->space, 0);
+  }
+
+  return self;
+}
+
+/** Delete writer object
+ *
+ * Note: The worker thread must be stopped before calling this.
+ *
+ * @param self writer object, or NULL
+ */
+static void
+led_writer_delete(led_writer_t *self)
+{
+  if( self ) {
+    pthread_cond_destroy(&self->space);
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->mutex);
+    free(self);
+  }
+}
+
+/** Update write latency statistics
+ *
+ * Note: Must be called with writer mutex locked.
+ */
+static void
+led_writer_record(led_writer_t *self, led_write_t type, int64_t us)
+{
+  led_latency_t *stats = &self->latency[type];
+
+  stats->count    += 1;
+  stats->total_us += us;
+
+  if( stats->max_us < us )
+    stats->max_us = us;
+
+  if( us >= LED_WRITER_SLOW_WRITE ) {
+    stats->slow += 1;
+    mce_log(LL_WARN, "%s: slow %s write: %lld us", self->backend.name,
+            led_write_repr(type), (long long)us);
+  }
+}
+
+/** Log write latency statistics
+ */
+static void
+led_writer_log_stats(const led_writer_t *self)
+{
+  for( led_write_t type = 0; type < LED_WRITE_COUNT; ++type ) {
+    const led_latency_t *stats = &self->latency[type];
+
+    if( !stats->count )
+      continue;
+
+    mce_log(LL_DEBUG, "%s: %s writes: count=%u avg=%lld us max=%lld us"
+            " slow=%u", self->backend.name, led_write_repr(type),
+            stats->count, (long long)(stats->total_us / stats->count),
+            (long long)stats->max_us, stats->slow);
+  }
+}
+
+/** Queue backend write request
+ *
+ * A pending request of the same type is dropped, unless there is
+ * a reset request between them - or the pending request is a reset
+ * itself. The new request is always added to the tail of the queue,
+ * so that it does not get written before requests made earlier.
+ *
+ * If the queue is full of resets, waits until the worker thread has
+ * made room for the request.
+ *
+ * Note: Must be called with writer mutex locked.
+ */
+static void
+led_writer_push(led_writer_t *self, const led_request_t *req)
+{
+  for( size_t i = self->queued; i-- > 0; ) {
+    led_request_t *old = &self->queue[i];
+
+    if( led_request_is_reset(old) )
+      break;
+
+    if( old->type == req->type ) {
+      self->queued -= 1;
+      memmove(old, old + 1, (self->queued - i) * sizeof *old);
+      break;
+    }
+  }
+
+  while( self->queued >= LED_WRITER_QUEUE_MAX )
+    pthread_cond_wait(&self->space, &self->mutex);
+
+  self->queue[self->queued++] = *req;
+
+  pthread_cond_signal(&self->cond);
+}
+
+/** Writer thread main loop
+ */
+static void *
+led_writer_thread_cb(void *aptr)
+{
+  led_writer_t *self = aptr;
+
+  /* Leave signal handling to the mainloop thread */
+  sigset_t ss;
+  sigfillset(&ss);
+  pthread_sigmask(SIG_BLOCK, &ss, 0);
+
+  pthread_mutex_lock(&self->mutex);
+
+  for( ;; ) {
+    if( self->queued > 0 ) {
+      led_request_t req = self->queue[0];
+      self->queued -= 1;
+      memmove(self->queue, self->queue + 1,
+              self->queued * sizeof *self->queue);
+      pthread_cond_signal(&self->space);
+      pthread_mutex_unlock(&self->mutex);
+
+      int64_t t = led_util_get_tick_us();
+      if( req.type == LED_WRITE_BLINK )
+        led_control_blink(&self->backend, req.arg[0], req.arg[1]);
+      else
+        led_control_value(&self->backend, req.arg[0], req.arg[1],
+                          req.arg[2]);
+      t = led_util_get_tick_us() - t;
+
+      pthread_mutex_lock(&self->mutex);
+      led_writer_record(self, req.type, t);
+      continue;
+    }
+
+    /* Exit only after pending writes have been flushed */
+    if( self->exiting )
+      break;
+
+    pthread_cond_wait(&self->cond, &self->mutex);
+  }
+
+  pthread_mutex_unlock(&self->mutex);
+
+  return 0;
+}
+
+/** Start writer thread
+ *
+ * @return true if thread was started, false otherwise
+ */
+static bool
+led_writer_start(led_writer_t *self)
+{
+  if( pthread_create(&self->thread, 0, led_writer_thread_cb, self) != 0 )
+    mce_log(LL_ERR, "could not start led writer thread");
+  else
+    self->running = true;
+
+  return self->running;
+}
+
+/** Stop writer thread after flushing pending writes
+ */
+static void
+led_writer_stop(led_writer_t *self)
+{
+  if( self->running ) {
+    pthread_mutex_lock(&self->mutex);
+    self->exiting = true;
+    pthread_cond_signal(&self->cond);
+    pthread_mutex_unlock(&self->mutex);
+
+    pthread_join(self->thread, 0);
+    self->running = false;
+
+    led_writer_log_stats(self);
+  }
+}
+
+/* ========================================================================= *
+ * LED_CONTROL
+ * ========================================================================= */
+
+static void
+led_writer_blink_cb(void *data, int on_ms, int off_ms)
+{
+  led_writer_t  *self = data;
+  led_request_t  req  = { LED_WRITE_BLINK, { on_ms, off_ms, 0 } };
+
+  pthread_mutex_lock(&self->mutex);
+  led_writer_push(self, &req);
+  pthread_mutex_unlock(&self->mutex);
+}
+
+static void
+led_writer_value_cb(void *data, int r, int g, int b)
+{
+  led_writer_t  *self = data;
+  led_request_t  req  = { LED_WRITE_VALUE, { r, g, b } };
+
+  pthread_mutex_lock(&self->mutex);
+  led_writer_push(self, &req);
+  pthread_mutex_unlock(&self->mutex);
+}
+
+static void
+led_writer_close_cb(void *data)
+{
+  led_writer_t *self = data;
+
+  led_writer_stop(self);
+  led_control_close(&self->backend);
+  led_writer_delete(self);
+}
+
+/** Move backend writes to a worker thread
+ *
+ * On success the control object callbacks are replaced with ones
+ * that pass the requests to the worker thread.
+ *
+ * @param control  successfully probed led control object
+ *
+ * @return true if writer thread is in use, false otherwise
+ */
+bool
+led_writer_attach(led_control_t *control)
+{
+  bool          ack  = false;
+  led_writer_t *self = led_writer_create(control);
+
+  if( !self )
+    goto cleanup;
+
+  if( !led_writer_start(self) )
+    goto cleanup;
+
+  /* Note: enable/disable toggling is done by the worker thread
+   *       as a part of blink and value changes */
+  control->data   = self;
+  control->enable = 0;
+  control->blink  = self->backend.blink ? led_writer_blink_cb : 0;
+  control->value  = self->backend.value ? led_writer_value_cb : 0;
+  control->close  = led_writer_close_cb;
+
+  mce_log(LL_DEBUG, "%s: using led writer thread", control->name);
+
+  self = 0, ack = true;
+
+cleanup:
+
+  led_writer_delete(self);
+
+  return ack;
+}
@@ -0,0 +1,285 @@
+/** @file sysfs-val-group.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Group of related sysfs values
+ *
+ * Some led drivers have control files where writing one changes the
+ * value of another, and/or the writes need to be made in specific
+ * order. Instead of hand coding the cache invalidation into each
+ * backend, the relations are declared once and the group then
+ * decides what needs to be written and in what order:
+ *
+ * - writes are staged with sysfsvalgroup_set()
+ * - sysfsvalgroup_commit() writes staged values that differ from
+ *   cached ones or were invalidated by earlier writes in the commit
+ * - cached values affected by actually made writes are invalidated
+ * - staged writes are ordered so that declared predecessors and
+ *   invalidating writes come first, otherwise staging order is used
+ * ========================================================================= */
+
+#include "sysfs-val-group.h"
+
+#include "plugin-logging.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Maximum number of sysfs values in one group */
+#define SYSFSVALGROUP_MAX_MEMBERS 16
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+struct sysfsvalgroup_t
+{
+    int          sg_count;
+    sysfsval_t  *sg_member[SYSFSVALGROUP_MAX_MEMBERS];
+
+    /* Bitmasks of: members affected by writing member N */
+    uint32_t     sg_invalidates[SYSFSVALGROUP_MAX_MEMBERS];
+
+    /* Bitmasks of: members that must be written before member N */
+    uint32_t     sg_after[SYSFSVALGROUP_MAX_MEMBERS];
+
+    /* Staged values, bitmask and staging order */
+    uint32_t     sg_staged;
+    int          sg_value[SYSFSVALGROUP_MAX_MEMBERS];
+    int          sg_order[SYSFSVALGROUP_MAX_MEMBERS];
+    int          sg_pending;
+};
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+static int         sysfsvalgroup_lookup     (sysfsvalgroup_t *self, sysfsval_t *member);
+static int         sysfsvalgroup_next       (const sysfsvalgroup_t *self, uint32_t todo);
+
+sysfsvalgroup_t   *sysfsvalgroup_create     (void);
+void               sysfsvalgroup_delete     (sysfsvalgroup_t *self);
+void               sysfsvalgroup_invalidates(sysfsvalgroup_t *self, sysfsval_t *written, sysfsval_t *affected);
+void               sysfsvalgroup_precedes   (sysfsvalgroup_t *self, sysfsval_t *first, sysfsval_t *second);
+void               sysfsvalgroup_set        (sysfsvalgroup_t *self, sysfsval_t *member, int value);
+bool               sysfsvalgroup_commit     (sysfsvalgroup_t *self);
+
+/* ========================================================================= *
+ * CODE
+ * ========================================================================= */
+
+/** Lookup member index, add to group if needed
+ *
+ * @param self   sysfsvalgroup_t object pointer
+ * @param member sysfsval_t object pointer
+ *
+ * @return member index, or -1 if group is full
+ */
+static int
+sysfsvalgroup_lookup(sysfsvalgroup_t *self, sysfsval_t *member)
+{
+    for( int i = 0; i < self->sg_count; ++i ) {
+        if( self->sg_member[i] == member )
+            return i;
+    }
+
+    if( self->sg_count >= SYSFSVALGROUP_MAX_MEMBERS ) {
+        mce_log(LOG_ERR, "%s: too many group members",
+                sysfsval_path(member));
+        return -1;
+    }
+
+    self->sg_member[self->sg_count] = member;
+    return self->sg_count++;
+}
+
+/** Choose the next staged member to write
+ *
+ * @param self sysfsvalgroup_t object pointer
+ * @param todo bitmask of staged members not written yet
+ *
+ * @return member index
+ */
+static int
+sysfsvalgroup_next(const sysfsvalgroup_t *self, uint32_t todo)
+{
+    int fallback = -1;
+
+    for( int k = 0; k < self->sg_pending; ++k ) {
+        int i = self->sg_order[k];
+
+        if( !(todo & (1u << i)) )
+            continue;
+
+        if( fallback == -1 )
+            fallback = i;
+
+        /* Must come after some other pending write? */
+        if( self->sg_after[i] & todo & ~(1u << i) )
+            continue;
+
+        return i;
+    }
+
+    /* Conflicting rules - use staging order */
+    return fallback;
+}
+
+/** Allocate and initialize a sysfsvalgroup_t object
+ *
+ * @return sysfsvalgroup_t object pointer
+ */
+sysfsvalgroup_t *
+sysfsvalgroup_create(void)
+{
+    sysfsvalgroup_t *self = calloc(1, sizeof *self);
+    return self;
+}
+
+/** Release sysfsvalgroup_t object
+ *
+ * Note: The member sysfsval_t objects are not owned by the group.
+ *
+ * @param self sysfsvalgroup_t object pointer, or NULL
+ */
+void
+sysfsvalgroup_delete(sysfsvalgroup_t *self)
+{
+    free(self);
+}
+
+/** Declare that writing one sysfs value changes another one
+ *
+ * The affected value is also ordered to be written after the
+ * written one, if both are staged in the same commit.
+ *
+ * @param self     sysfsvalgroup_t object pointer
+ * @param written  sysfsval_t object that is written
+ * @param affected sysfsval_t object whose value changes
+ */
+void
+sysfsvalgroup_invalidates(sysfsvalgroup_t *self, sysfsval_t *written,
+                          sysfsval_t *affected)
+{
+    int w = sysfsvalgroup_lookup(self, written);
+    int a = sysfsvalgroup_lookup(self, affected);
+
+    if( w < 0 || a < 0 )
+        return;
+
+    self->sg_invalidates[w] |= 1u << a;
+    self->sg_after[a]       |= 1u << w;
+}
+
+/** Declare that one sysfs value must be written before another one
+ *
+ * @param self   sysfsvalgroup_t object pointer
+ * @param first  sysfsval_t object to write first
+ * @param second sysfsval_t object to write after the first one
+ */
+void
+sysfsvalgroup_precedes(sysfsvalgroup_t *self, sysfsval_t *first,
+                       sysfsval_t *second)
+{
+    int f = sysfsvalgroup_lookup(self, first);
+    int s = sysfsvalgroup_lookup(self, second);
+
+    if( f < 0 || s < 0 )
+        return;
+
+    self->sg_after[s] |= 1u << f;
+}
+
+/** Stage value to be written on the next commit
+ *
+ * @param self   sysfsvalgroup_t object pointer
+ * @param member sysfsval_t object
+ * @param value  number to write to sysfs file
+ */
+void
+sysfsvalgroup_set(sysfsvalgroup_t *self, sysfsval_t *member, int value)
+{
+    int i = sysfsvalgroup_lookup(self, member);
+
+    if( i < 0 ) {
+        /* Not manageable via group, write immediately */
+        sysfsval_set(member, value);
+        return;
+    }
+
+    if( !(self->sg_staged & (1u << i)) ) {
+        self->sg_staged |= 1u << i;
+        self->sg_order[self->sg_pending++] = i;
+    }
+
+    self->sg_value[i] = value;
+}
+
+/** Write staged values to sysfs
+ *
+ * @param self sysfsvalgroup_t object pointer
+ *
+ * @return true if all writes succeeded, false otherwise
+ */
+bool
+sysfsvalgroup_commit(sysfsvalgroup_t *self)
+{
+    bool     ack  = true;
+    uint32_t todo = self->sg_staged;
+
+    while( todo ) {
+        int i = sysfsvalgroup_next(self, todo);
+        todo &= ~(1u << i);
+
+        sysfsval_t *member = self->sg_member[i];
+        int         value  = self->sg_value[i];
+
+        /* Note: Elision is left to sysfsval_set() so that
+         *       avoided writes get accounted for */
+        bool changed = (sysfsval_get(member) != value);
+
+        if( !sysfsval_set(member, value) )
+            ack = false;
+
+        /* Skip if value was already there, or if the file
+         * is optional and not open */
+        if( !changed || !sysfsval_is_open(member) )
+            continue;
+
+        /* Forget values that the write changed */
+        for( int a = 0; a < self->sg_count; ++a ) {
+            if( self->sg_invalidates[i] & (1u << a) )
+                sysfsval_invalidate(self->sg_member[a]);
+        }
+    }
+
+    self->sg_staged  = 0;
+    self->sg_pending = 0;
+
+    return ack;
+}
@@ -0,0 +1,46 @@
+/** @file sysfs-val-group.h
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef  SYSFS_VAL_GROUP_H_
+# define SYSFS_VAL_GROUP_H_
+
+# include "sysfs-val.h"
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+typedef struct sysfsvalgroup_t sysfsvalgroup_t;
+
+/* ========================================================================= *
+ * PROTOS
+ * ========================================================================= */
+
+sysfsvalgroup_t   *sysfsvalgroup_create     (void);
+void               sysfsvalgroup_delete     (sysfsvalgroup_t *self);
+void               sysfsvalgroup_invalidates(sysfsvalgroup_t *self, sysfsval_t *written, sysfsval_t *affected);
+void               sysfsvalgroup_precedes   (sysfsvalgroup_t *self, sysfsval_t *first, sysfsval_t *second);
+void               sysfsvalgroup_set        (sysfsvalgroup_t *self, sysfsval_t *member, int value);
+bool               sysfsvalgroup_commit     (sysfsvalgroup_t *self);
+
+#endif /* SYSFS_VAL_GROUP_H_ */
@@ -27,40 +27,491 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/** Number of preallocated sysfsval_t objects */
+#define SYSFSVAL_POOL_SIZE 48
+
+/** Number of distinct file access modes: O_RDONLY, O_WRONLY, O_RDWR */
+#define SYSFSVAL_MODES 3
+
+/** Maximum length of text values, including the terminating nul */
+#define SYSFSVAL_TEXT_MAX 64
 
 /* ========================================================================= *
  * TYPES
  * ========================================================================= */
 
+/** Registry entry for a sysfs file path
+ *
+ * Paths are interned, and file descriptors are shared between all
+ * sysfsval_t objects using the same path and access mode. Unused
+ * descriptors - and failed open attempts - are retained until
+ * sysfsval_registry_flush() is called, so that repeated probing of
+ * the same files does not need to make repeated system calls.
+ */
+typedef struct
+{
+    char *sn_path;
+    int   sn_file[SYSFSVAL_MODES];
+    int   sn_users[SYSFSVAL_MODES];
+    int   sn_error[SYSFSVAL_MODES];
+} sysfsval_node_t;
+
 struct sysfsval_t
 {
-    char *sv_path;
-    int   sv_file;
-    int   sv_curr;
+    const char         *sv_path;
+    sysfsval_node_t    *sv_node;
+    int                 sv_mode;
+    int                 sv_file;
+    int                 sv_curr;
+    sysfsval_t         *sv_pool_next;
+
+    /* Cached content of multi-token / text attributes, empty if unknown */
+    char                sv_text[SYSFSVAL_TEXT_MAX];
+
+    /* Kernel side change notification via POLLPRI */
+    guint               sv_watch_id;
+    sysfsval_notify_fn  sv_notify_cb;
+    void               *sv_notify_aptr;
 };
 
 /* ========================================================================= *
  * PROTOS
  * ========================================================================= */
 
+static int         sysfsval_format_int(char *data, int value);
+static int         sysfsval_parse_int (const char *data);
+static bool        sysfsval_write     (const sysfsval_t *self, const char *data, int todo);
+static bool        sysfsval_report    (const sysfsval_t *self, int todo, int done, int err);
+static void        sysfsval_count     (bool written);
+void               sysfsval_get_stats (unsigned *written, unsigned *elided);
+
+static void        sysfsval_registry_lock   (void);
+static void        sysfsval_registry_unlock (void);
+static void        sysfsval_node_delete    (gpointer aptr);
+static sysfsval_node_t *sysfsval_registry_intern (const char *path);
+static int         sysfsval_registry_acquire(sysfsval_node_t *node, int mode);
+static void        sysfsval_registry_release(sysfsval_node_t *node, int mode);
+void               sysfsval_registry_flush  (void);
+void               sysfsval_set_resolver    (sysfsval_resolve_fn cb);
+
 static void        sysfsval_ctor      (sysfsval_t *self);
+static bool        sysfsval_in_pool   (const sysfsval_t *self);
 static void        sysfsval_dtor      (sysfsval_t *self);
 
 sysfsval_t        *sysfsval_create    (void);
 void               sysfsval_delete    (sysfsval_t *self);
 bool               sysfsval_open_rw   (sysfsval_t *self, const char *path);
 bool               sysfsval_open_ro   (sysfsval_t *self, const char *path);
+bool               sysfsval_open_wo   (sysfsval_t *self, const char *path);
 static bool        sysfsval_open_ex   (sysfsval_t *self, const char *path, mode_t mode);
 void               sysfsval_close     (sysfsval_t *self);
 const char        *sysfsval_path      (const sysfsval_t *self);
+bool               sysfsval_is_open   (const sysfsval_t *self);
 int                sysfsval_get       (const sysfsval_t *self);
 bool               sysfsval_set       (sysfsval_t *self, int value);
+const char        *sysfsval_get_text  (const sysfsval_t *self);
+bool               sysfsval_set_text  (sysfsval_t *self, const char *text);
+bool               sysfsval_set_pair  (sysfsval_t *self, int first, int second);
+void               sysfsval_assume    (sysfsval_t *self, int value);
 void               sysfsval_invalidate(sysfsval_t *self);
 bool               sysfsval_refresh   (sysfsval_t *self);
+static gboolean    sysfsval_watch_cb  (GIOChannel *chn, GIOCondition cnd, gpointer aptr);
+bool               sysfsval_watch     (sysfsval_t *self, sysfsval_notify_fn cb, void *aptr);
+void               sysfsval_unwatch   (sysfsval_t *self);
+
+/* ========================================================================= *
+ * FORMAT
+ * ========================================================================= */
+
+/** Format integer as decimal string
+ *
+ * Faster alternative for snprintf("%d") for use in led update paths.
+ *
+ * @param data buffer of at least 12 bytes
+ * @param value integer to format
+ *
+ * @return length of formatted string
+ */
+static int
+sysfsval_format_int(char *data, int value)
+{
+    char tmp[12];
+    int  len = 0;
+
+    /* Note: Negate as unsigned to handle INT_MIN */
+    unsigned num = (value < 0) ? 0u - (unsigned)value : (unsigned)value;
+
+    do
+        tmp[len++] = (char)('0' + num % 10);
+    while( num /= 10 );
+
+    int pos = 0;
+
+    if( value < 0 )
+        data[pos++] = '-';
+
+    while( len > 0 )
+        data[pos++] = tmp[--len];
+
+    data[pos] = 0;
+    return pos;
+}
+
+/** Parse integer from sysfs file content
+ *
+ * Decimal numbers - which is what sysfs files generally contain -
+ * are parsed directly. Anything else is passed to strtol() so that
+ * hexadecimal and octal values are handled as before.
+ *
+ * @param data nul terminated string
+ *
+ * @return parsed integer value
+ */
+static int
+sysfsval_parse_int(const char *data)
+{
+    const char *pos = data;
+
+    while( *pos == ' ' || *pos == '\t' )
+        ++pos;
+
+    bool neg = (*pos == '-');
+    if( neg || *pos == '+' )
+        ++pos;
+
+    /* Leading zero means octal / hexadecimal prefix */
+    if( pos[0] == '0' && pos[1] >= '0' )
+        return strtol(data, 0, 0);
+
+    int num = 0;
+
+    while( *pos >= '0' && *pos <= '9' ) {
+        int digit = *pos++ - '0';
+
+        /* Check before multiplying - long can be 32-bit too */
+        if( num > (INT_MAX - digit) / 10 )
+            return strtol(data, 0, 0);
+
+        num = num * 10 + digit;
+    }
+
+    return (int)(neg ? -num : num);
+}
+
+/* ========================================================================= *
+ * WRITE
+ * ========================================================================= */
+
+/** Report outcome of a write made to sysfs file
+ *
+ * @param self sysfsval_t object pointer
+ * @param todo number of bytes that should have been written
+ * @param done number of bytes written, or -1 on failure
+ * @param err  errno value associated with failure
+ *
+ * @return true if everything was written, false otherwise
+ */
+static bool
+sysfsval_report(const sysfsval_t *self, int todo, int done, int err)
+{
+    if( done == todo )
+        return true;
+
+    if( done == -1 )
+        mce_log(LOG_ERR, "%s: write: %s", sysfsval_path(self), strerror(err));
+    else
+        mce_log(LOG_ERR, "%s: write: partial", sysfsval_path(self));
+
+    return false;
+}
+
+/** Write data to sysfs file associated with sysfsval_t object
+ *
+ * The data is always written to the beginning of the file,
+ * so that there is no need to care about file position.
+ *
+ * @param self sysfsval_t object pointer
+ * @param data data to write
+ * @param todo number of bytes to write
+ *
+ * @return true if everything was written, false otherwise
+ */
+static bool
+sysfsval_write(const sysfsval_t *self, const char *data, int todo)
+{
+    int done = TEMP_FAILURE_RETRY(pwrite(self->sv_file, data, todo, 0));
+    return sysfsval_report(self, todo, done, errno);
+}
+
+/* ========================================================================= *
+ * STATS
+ * ========================================================================= */
+
+/** Number of writes made to open sysfs files */
+static unsigned sysfsval_stats_written = 0;
+
+/** Number of writes skipped because the value was already there */
+static unsigned sysfsval_stats_elided = 0;
+
+/** Update write statistics
+ *
+ * Note: Writes can be made from led writer thread while statistics
+ *       are queried from mainloop.
+ *
+ * @param written true if write was made, false if it was elided
+ */
+static void
+sysfsval_count(bool written)
+{
+    __atomic_add_fetch(written ? &sysfsval_stats_written :
+                       &sysfsval_stats_elided, 1, __ATOMIC_RELAXED);
+}
+
+/** Get sysfs write statistics
+ *
+ * @param written where to store number of writes made, or NULL
+ * @param elided  where to store number of writes avoided, or NULL
+ */
+void
+sysfsval_get_stats(unsigned *written, unsigned *elided)
+{
+    if( written )
+        *written = __atomic_load_n(&sysfsval_stats_written, __ATOMIC_RELAXED);
+    if( elided )
+        *elided = __atomic_load_n(&sysfsval_stats_elided, __ATOMIC_RELAXED);
+}
+
+/* ========================================================================= *
+ * REGISTRY
+ * ========================================================================= */
+
+/** Path -> sysfsval_node_t lookup table */
+static GHashTable *sysfsval_registry = 0;
+
+/** Path mapping function, or NULL to open paths as is */
+static sysfsval_resolve_fn sysfsval_resolve_cb = 0;
+
+/** Mutex for registry and object pool
+ *
+ * Led backends can be probed from a worker thread while already
+ * active led controls are opened and closed from mainloop. Writes
+ * and reads use only the file descriptor cached in sysfsval_t
+ * and do not need to take the lock.
+ */
+static pthread_mutex_t sysfsval_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Lock registry and object pool
+ */
+static void
+sysfsval_registry_lock(void)
+{
+    pthread_mutex_lock(&sysfsval_registry_mutex);
+}
+
+/** Unlock registry and object pool
+ */
+static void
+sysfsval_registry_unlock(void)
+{
+    pthread_mutex_unlock(&sysfsval_registry_mutex);
+}
+
+/** Release registry entry
+ *
+ * @param aptr sysfsval_node_t object pointer
+ */
+static void
+sysfsval_node_delete(gpointer aptr)
+{
+    sysfsval_node_t *node = aptr;
+
+    for( int m = 0; m < SYSFSVAL_MODES; ++m ) {
+        if( node->sn_file[m] != -1 )
+            close(node->sn_file[m]);
+    }
+
+    free(node->sn_path);
+    free(node);
+}
+
+/** Lookup registry entry for a path, create if needed
+ *
+ * @param path sysfs file path
+ *
+ * @return registry entry, or NULL on failure
+ */
+static sysfsval_node_t *
+sysfsval_registry_intern(const char *path)
+{
+    sysfsval_node_t *node = 0;
+
+    if( !sysfsval_registry ) {
+        sysfsval_registry = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  0, sysfsval_node_delete);
+    }
+
+    if( (node = g_hash_table_lookup(sysfsval_registry, path)) )
+        goto EXIT;
+
+    if( !(node = calloc(1, sizeof *node)) )
+        goto EXIT;
+
+    if( !(node->sn_path = strdup(path)) ) {
+        free(node), node = 0;
+        goto EXIT;
+    }
+
+    for( int m = 0; m < SYSFSVAL_MODES; ++m )
+        node->sn_file[m] = -1;
+
+    g_hash_table_replace(sysfsval_registry, node->sn_path, node);
+
+EXIT:
+    return node;
+}
+
+/** Get file descriptor for registry entry, open if needed
+ *
+ * @param node registry entry
+ * @param mode O_RDONLY, O_WRONLY or O_RDWR
+ *
+ * @return file descriptor, or -1 on failure
+ */
+static int
+sysfsval_registry_acquire(sysfsval_node_t *node, int mode)
+{
+    char *real = 0;
+
+    if( node->sn_file[mode] != -1 )
+        goto EXIT;
+
+    /* Failed attempts are not repeated until registry flush */
+    if( node->sn_error[mode] ) {
+        mce_log(LOG_DEBUG, "%s: open: %s (cached)", node->sn_path,
+                strerror(node->sn_error[mode]));
+        goto EXIT;
+    }
+
+    /* Map to the file to open - the resolver can also skip
+     * files that are known not to exist */
+    errno = 0;
+    if( sysfsval_resolve_cb )
+        real = sysfsval_resolve_cb(node->sn_path);
+    else
+        real = strdup(node->sn_path);
+
+    if( !real ) {
+        node->sn_error[mode] = errno ?: ENOMEM;
+        goto EXIT;
+    }
+
+    if( (node->sn_file[mode] = open(real, mode)) == -1 ) {
+        node->sn_error[mode] = errno;
+        if( errno == ENOENT )
+            mce_log(LOG_DEBUG, "%s: open: %m", node->sn_path);
+        else
+            mce_log(LOG_ERR, "%s: open: %m", node->sn_path);
+        goto EXIT;
+    }
+
+EXIT:
+    free(real);
+
+    if( node->sn_file[mode] != -1 )
+        node->sn_users[mode] += 1;
+
+    return node->sn_file[mode];
+}
+
+/** Stop using file descriptor for registry entry
+ *
+ * The file is not closed until sysfsval_registry_flush() is called.
+ *
+ * @param node registry entry
+ * @param mode O_RDONLY, O_WRONLY or O_RDWR
+ */
+static void
+sysfsval_registry_release(sysfsval_node_t *node, int mode)
+{
+    if( node->sn_users[mode] > 0 )
+        node->sn_users[mode] -= 1;
+}
+
+/** Close unused files and forget failed open attempts
+ *
+ * Meant to be called after led backend probing is finished and
+ * when led controls are released.
+ */
+void
+sysfsval_registry_flush(void)
+{
+    GHashTableIter iter;
+    gpointer       val;
+
+    sysfsval_registry_lock();
+
+    if( !sysfsval_registry )
+        goto EXIT;
+
+    g_hash_table_iter_init(&iter, sysfsval_registry);
+    while( g_hash_table_iter_next(&iter, 0, &val) ) {
+        sysfsval_node_t *node = val;
+        bool             used = false;
+
+        for( int m = 0; m < SYSFSVAL_MODES; ++m ) {
+            node->sn_error[m] = 0;
+
+            if( node->sn_users[m] > 0 ) {
+                used = true;
+            }
+            else if( node->sn_file[m] != -1 ) {
+                close(node->sn_file[m]), node->sn_file[m] = -1;
+            }
+        }
+
+        /* Paths still in use by sysfsval_t objects must stay */
+        if( !used )
+            g_hash_table_iter_remove(&iter);
+    }
+
+    mce_log(LOG_DEBUG, "%u paths in use",
+            g_hash_table_size(sysfsval_registry));
+
+EXIT:
+    sysfsval_registry_unlock();
+    return;
+}
+
+/** Set function for mapping sysfs paths to files to open
+ *
+ * Allows the users to e.g. redirect paths to a fake sysfs tree,
+ * without sysfsval needing to know about such details.
+ *
+ * Note: Affects only files opened after the call.
+ *
+ * @param cb resolver function, or NULL to open paths as is
+ */
+void
+sysfsval_set_resolver(sysfsval_resolve_fn cb)
+{
+    sysfsval_registry_lock();
+    sysfsval_resolve_cb = cb;
+    sysfsval_registry_unlock();
+}
 
 /* ========================================================================= *
  * CODE
@@ -74,8 +525,16 @@ static void
 sysfsval_ctor(sysfsval_t *self)
 {
     self->sv_path = 0;
+    self->sv_node = 0;
+    self->sv_mode = O_RDONLY;
     self->sv_file = -1;
     self->sv_curr = -1;
+    self->sv_pool_next = 0;
+    self->sv_text[0] = 0;
+
+    self->sv_watch_id    = 0;
+    self->sv_notify_cb   = 0;
+    self->sv_notify_aptr = 0;
 }
 
 /** Release all dynamically allocated resources used by sysfsval_t object
@@ -88,14 +547,56 @@ sysfsval_dtor(sysfsval_t *self)
     sysfsval_close(self);
 }
 
+/** Preallocated sysfsval_t objects */
+static sysfsval_t  sysfsval_pool[SYSFSVAL_POOL_SIZE];
+
+/** Free list of preallocated sysfsval_t objects */
+static sysfsval_t *sysfsval_pool_free = 0;
+
+/** Flag for: sysfsval_pool has been chained to the free list */
+static bool        sysfsval_pool_init = false;
+
+/** Predicate for: sysfsval_t object is from preallocated pool
+ *
+ * @param self sysfsval_t object pointer
+ *
+ * @return true if object was not dynamically allocated
+ */
+static bool
+sysfsval_in_pool(const sysfsval_t *self)
+{
+    return (self >= sysfsval_pool &&
+            self <  sysfsval_pool + SYSFSVAL_POOL_SIZE);
+}
+
 /** Allocate and initialize an sysfsval_t object
+ *
+ * Objects are taken from preallocated pool when possible.
  *
  * @return sysfsval_t object pointer
  */
 sysfsval_t *
 sysfsval_create(void)
 {
-    sysfsval_t *self = calloc(1, sizeof *self);
+    sysfsval_t *self = 0;
+
+    sysfsval_registry_lock();
+
+    if( (self = sysfsval_pool_free) )
+        sysfsval_pool_free = self->sv_pool_next;
+    else if( !sysfsval_pool_init ) {
+        /* Chain all pool objects to free list on first use */
+        sysfsval_pool_init = true;
+        for( size_t i = 1; i < SYSFSVAL_POOL_SIZE; ++i )
+            sysfsval_pool[i].sv_pool_next = sysfsval_pool_free,
+                sysfsval_pool_free = &sysfsval_pool[i];
+        self = &sysfsval_pool[0];
+    }
+    else
+        self = calloc(1, sizeof *self);
+
+    sysfsval_registry_unlock();
+
     sysfsval_ctor(self);
     return self;
 }
@@ -109,7 +610,16 @@ sysfsval_delete(sysfsval_t *self)
 {
     if( self )  {
         sysfsval_dtor(self);
-        free(self);
+
+        if( sysfsval_in_pool(self) ) {
+            sysfsval_registry_lock();
+            self->sv_pool_next = sysfsval_pool_free;
+            sysfsval_pool_free = self;
+            sysfsval_registry_unlock();
+        }
+        else {
+            free(self);
+        }
     }
 }
 
@@ -137,6 +647,21 @@ sysfsval_open_ro(sysfsval_t *self, const char *path)
     return sysfsval_open_ex(self, path, O_RDONLY);
 }
 
+/** Assign path to sysfsval_t object and open the file in write-only mode
+ *
+ * Meant for control files that do not allow reading, or where
+ * reading does not yield the value that was written.
+ *
+ * @param self sysfsval_t object pointer
+ *
+ * @return true if file was opened succesfully, false otherwise
+ */
+bool
+sysfsval_open_wo(sysfsval_t *self, const char *path)
+{
+    return sysfsval_open_ex(self, path, O_WRONLY);
+}
+
 static bool
 sysfsval_open_ex(sysfsval_t *self, const char *path, mode_t mode)
 {
@@ -147,17 +672,21 @@ sysfsval_open_ex(sysfsval_t *self, const char *path, mode_t mode)
     if( !path )
         goto EXIT;
 
-    if( (self->sv_path = strdup(path)) == 0 )
-        goto EXIT;
+    /* Registry entry must not get flushed before it has a user */
+    sysfsval_registry_lock();
 
-    if( (self->sv_file = open(path, mode)) == -1 ) {
-        if( errno == ENOENT )
-            mce_log(LOG_DEBUG, "%s: open: %m", path);
-        else
-            mce_log(LOG_ERR, "%s: open: %m", path);
-        goto EXIT;
+    if( (self->sv_node = sysfsval_registry_intern(path)) ) {
+        self->sv_path = self->sv_node->sn_path;
+        self->sv_mode = mode & O_ACCMODE;
+        self->sv_file = sysfsval_registry_acquire(self->sv_node,
+                                                  self->sv_mode);
     }
 
+    sysfsval_registry_unlock();
+
+    if( self->sv_file == -1 )
+        goto EXIT;
+
     mce_log(LOG_DEBUG, "%s: opened", sysfsval_path(self));
 
     /* Note: Current value is not fetched by default */
@@ -178,12 +707,18 @@ EXIT:
 void
 sysfsval_close(sysfsval_t *self)
 {
+    sysfsval_unwatch(self);
+
     if( self->sv_file != -1 ) {
         mce_log(LOG_DEBUG, "%s: closed", sysfsval_path(self));
-        close(self->sv_file), self->sv_file = -1;
+        sysfsval_registry_lock();
+        sysfsval_registry_release(self->sv_node, self->sv_mode);
+        sysfsval_registry_unlock();
+        self->sv_file = -1;
     }
 
-    free(self->sv_path), self->sv_path = 0;
+    self->sv_node = 0;
+    self->sv_path = 0;
 }
 
 /** Get file path associated with sysfsval_t object
@@ -201,6 +736,18 @@ sysfsval_path(const sysfsval_t *self)
     return self->sv_path ?: "unset";
 }
 
+/** Check if sysfs file associated with sysfsval_t object is open
+ *
+ * @param self sysfsval_t object pointer
+ *
+ * @return true if writes are made to the file, false otherwise
+ */
+bool
+sysfsval_is_open(const sysfsval_t *self)
+{
+    return self->sv_file != -1;
+}
+
 /** Get integer value associated with sysfsval_t object
  *
  * @param self sysfsval_t object pointer
@@ -227,37 +774,119 @@ sysfsval_set(sysfsval_t *self, int value)
 
     int prev = self->sv_curr;
     self->sv_curr = value;
-
-    if( prev == self->sv_curr )
-        goto EXIT;
+    self->sv_text[0] = 0;
 
     /* If file is closed: assume it was optional and do not
      * spam journal with transitions related to it */
     if( self->sv_file == -1 )
         goto EXIT;
 
+    if( prev == self->sv_curr ) {
+        sysfsval_count(false);
+        goto EXIT;
+    }
+
     mce_log(LOG_DEBUG, "%s: write: %d -> %d", sysfsval_path(self),
             prev, self->sv_curr);
 
-    char data[256];
+    char data[16];
 
-    int todo = snprintf(data, sizeof data, "%d", value);
-    int done = write(self->sv_file, data, todo);
+    int todo = sysfsval_format_int(data, value);
 
-    if( done == todo )
+    ack = sysfsval_write(self, data, todo);
+    sysfsval_count(true);
+
+EXIT:
+    return ack;
+}
+
+/** Get text value associated with sysfsval_t object
+ *
+ * @param self sysfsval_t object pointer
+ *
+ * @return cached content of sysfs file as text, or empty string
+ */
+const char *
+sysfsval_get_text(const sysfsval_t *self)
+{
+    return self->sv_text;
+}
+
+/** Update sysfs content associated with sysfsval_t object as text
+ *
+ * Meant for attributes that take multiple tokens, such as "on off"
+ * delay pairs or per-channel intensity lists. Like sysfsval_set(),
+ * the write is skipped if the content would not change.
+ *
+ * Note: The integer value cache is invalidated, mixing integer
+ *       and text writes on the same object defeats write elision.
+ *
+ * @param self sysfsval_t object pointer
+ * @param text string to write to sysfs file
+ *
+ * @return false if updating sysfs content failed, true otherwise
+ */
+bool
+sysfsval_set_text(sysfsval_t *self, const char *text)
+{
+    bool ack = true;
+
+    self->sv_curr = -1;
+
+    size_t todo = strlen(text);
+
+    if( todo >= sizeof self->sv_text ) {
+        mce_log(LOG_ERR, "%s: write: value too long", sysfsval_path(self));
+        self->sv_text[0] = 0;
+        ack = false;
         goto EXIT;
+    }
 
-    ack = false;
+    if( self->sv_file == -1 ) {
+        memcpy(self->sv_text, text, todo + 1);
+        goto EXIT;
+    }
 
-    if( done == -1 )
-        mce_log(LOG_ERR, "%s: write: %m", sysfsval_path(self));
-    else
-        mce_log(LOG_ERR, "%s: write: partial", sysfsval_path(self));
+    if( todo > 0 && !strcmp(self->sv_text, text) ) {
+        sysfsval_count(false);
+        goto EXIT;
+    }
+
+    mce_log(LOG_DEBUG, "%s: write: '%s' -> '%s'", sysfsval_path(self),
+            self->sv_text, text);
+
+    memcpy(self->sv_text, text, todo + 1);
+
+    ack = sysfsval_write(self, text, (int)todo);
+    sysfsval_count(true);
 
 EXIT:
     return ack;
 }
 
+/** Update sysfs content associated with sysfsval_t object as number pair
+ *
+ * Writes two space separated integers, as used for example
+ * by 'on_off_ms' blink control files.
+ *
+ * @param self   sysfsval_t object pointer
+ * @param first  first number to write
+ * @param second second number to write
+ *
+ * @return false if updating sysfs content failed, true otherwise
+ */
+bool
+sysfsval_set_pair(sysfsval_t *self, int first, int second)
+{
+    char data[32];
+
+    int used = sysfsval_format_int(data, first);
+    data[used++] = ' ';
+    sysfsval_format_int(data + used, second);
+
+    return sysfsval_set_text(self, data);
+}
+
 /** Update cached value associated with sysfsval_t object
  *
  * Meant to be used in cases where it is known that writing to
@@ -273,6 +902,7 @@ sysfsval_assume(sysfsval_t *self, int value)
 {
     int prev = self->sv_curr;
     self->sv_curr = value;
+    self->sv_text[0] = 0;
 
     if( prev == self->sv_curr )
         goto EXIT;
@@ -301,10 +931,12 @@ EXIT:
 void
 sysfsval_invalidate(sysfsval_t *self)
 {
-    int prev = self->sv_curr;
-    self->sv_curr = -1;
+    bool known = (self->sv_curr != -1 || self->sv_text[0]);
 
-    if( prev == self->sv_curr )
+    self->sv_curr    = -1;
+    self->sv_text[0] = 0;
+
+    if( !known )
         goto EXIT;
 
     /* If file is closed: assume it was optional and do not
@@ -334,17 +966,12 @@ sysfsval_refresh(sysfsval_t *self)
     bool ack = false;
     int value = -1;
 
-    char data[256];
+    char data[64];
 
     if( self->sv_file == -1 )
         goto EXIT;
 
-    if( lseek(self->sv_file, 0, SEEK_SET) == -1 ) {
-        mce_log(LOG_ERR, "%s: seek: %m", sysfsval_path(self));
-        goto EXIT;
-    }
-
-    int done = read(self->sv_file, data, sizeof data - 1);
+    int done = TEMP_FAILURE_RETRY(pread(self->sv_file, data, sizeof data - 1, 0));
 
     if( done == -1 ) {
         mce_log(LOG_ERR, "%s: read: %m", sysfsval_path(self));
@@ -357,7 +984,16 @@ sysfsval_refresh(sysfsval_t *self)
     }
 
     data[done] = 0;
-    value = strtol(data, 0, 0);
+    value = sysfsval_parse_int(data);
+
+    /* Cache also as text, sans trailing white space */
+    while( done > 0 && (data[done-1] == '\n' || data[done-1] == ' ') )
+        data[--done] = 0;
+
+    if( done < (int)sizeof self->sv_text )
+        memcpy(self->sv_text, data, done + 1);
+    else
+        self->sv_text[0] = 0;
 
     mce_log(LOG_DEBUG, "%s: read: %d -> %d", sysfsval_path(self),
             self->sv_curr, value);
@@ -372,3 +1008,121 @@ EXIT:
 
     return ack;
 }
+
+/** Glib io watch callback for sysfs change notifications
+ *
+ * @param chn  io channel (unused)
+ * @param cnd  io condition
+ * @param aptr sysfsval_t object pointer
+ *
+ * @return TRUE to keep the watch alive, FALSE to remove it
+ */
+static gboolean
+sysfsval_watch_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
+{
+    (void)chn;
+
+    sysfsval_t *self = aptr;
+    gboolean    keep = FALSE;
+
+    if( !self->sv_watch_id )
+        goto EXIT;
+
+    if( cnd & ~(G_IO_PRI | G_IO_ERR) ) {
+        mce_log(LOG_WARNING, "%s: unexpected poll condition 0x%x",
+                sysfsval_path(self), (unsigned)cnd);
+        goto EXIT;
+    }
+
+    /* Reading the file both updates the cache and re-arms the
+     * notification on kernel side */
+    if( !sysfsval_refresh(self) )
+        goto EXIT;
+
+    keep = TRUE;
+
+    /* The notification itself is the event - the value can be
+     * the same as before, e.g. with brightness_hw_changed */
+    if( self->sv_notify_cb )
+        self->sv_notify_cb(self, self->sv_notify_aptr);
+
+EXIT:
+    if( !keep && self->sv_watch_id ) {
+        mce_log(LOG_WARNING, "%s: change notifications disabled",
+                sysfsval_path(self));
+        self->sv_watch_id = 0;
+    }
+
+    return keep;
+}
+
+/** Start tracking kernel side changes to sysfs file
+ *
+ * Meant to be used with attributes that kernel sysfs_notify()s. The
+ * cached value is refreshed when kernel signals a change, and the
+ * callback is called after each notification.
+ *
+ * Note: As the cache is then updated from glib mainloop, watches
+ *       should not be used while writes are made from other threads.
+ *
+ * @param self sysfsval_t object pointer
+ * @param cb   function to call when kernel signals a change, or NULL
+ * @param aptr parameter to pass to the callback function
+ *
+ * @return true if watch was set up, false otherwise
+ */
+bool
+sysfsval_watch(sysfsval_t *self, sysfsval_notify_fn cb, void *aptr)
+{
+    bool        ack = false;
+    GIOChannel *chn = 0;
+
+    sysfsval_unwatch(self);
+
+    if( self->sv_file == -1 )
+        goto EXIT;
+
+    /* Notifications are raised only after the file has been read */
+    if( !sysfsval_refresh(self) )
+        goto EXIT;
+
+    if( !(chn = g_io_channel_unix_new(self->sv_file)) )
+        goto EXIT;
+
+    g_io_channel_set_close_on_unref(chn, FALSE);
+
+    self->sv_watch_id = g_io_add_watch(chn, G_IO_PRI | G_IO_ERR,
+                                       sysfsval_watch_cb, self);
+    if( !self->sv_watch_id )
+        goto EXIT;
+
+    self->sv_notify_cb   = cb;
+    self->sv_notify_aptr = aptr;
+
+    mce_log(LOG_DEBUG, "%s: watching", sysfsval_path(self));
+
+    ack = true;
+
+EXIT:
+    /* The watch holds a reference to the channel */
+    if( chn )
+        g_io_channel_unref(chn);
+
+    return ack;
+}
+
+/** Stop tracking kernel side changes to sysfs file
+ *
+ * @param self sysfsval_t object pointer
+ */
+void
+sysfsval_unwatch(sysfsval_t *self)
+{
+    if( self->sv_watch_id ) {
+        mce_log(LOG_DEBUG, "%s: unwatched", sysfsval_path(self));
+        g_source_remove(self->sv_watch_id), self->sv_watch_id = 0;
+    }
+
+    self->sv_notify_cb   = 0;
+    self->sv_notify_aptr = 0;
+}
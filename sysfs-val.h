@@ -32,6 +32,16 @@
 
 typedef struct sysfsval_t sysfsval_t;
 
+/** Callback for notifying about kernel side sysfs value changes */
+typedef void (*sysfsval_notify_fn)(sysfsval_t *self, void *aptr);
+
+/** Callback for mapping sysfs path to the file to actually open
+ *
+ * Returns path to be released with free(), or NULL with errno set
+ * if the file should not be opened.
+ */
+typedef char *(*sysfsval_resolve_fn)(const char *path);
+
 /* ========================================================================= *
  * PROTOS
  * ========================================================================= */
@@ -40,12 +50,23 @@ sysfsval_t        *sysfsval_create    (void);
 void               sysfsval_delete    (sysfsval_t *self);
 bool               sysfsval_open_rw   (sysfsval_t *self, const char *path);
 bool               sysfsval_open_ro   (sysfsval_t *self, const char *path);
+bool               sysfsval_open_wo   (sysfsval_t *self, const char *path);
 void               sysfsval_close     (sysfsval_t *self);
 const char        *sysfsval_path      (const sysfsval_t *self);
+bool               sysfsval_is_open   (const sysfsval_t *self);
 int                sysfsval_get       (const sysfsval_t *self);
 bool               sysfsval_set       (sysfsval_t *self, int value);
+const char        *sysfsval_get_text  (const sysfsval_t *self);
+bool               sysfsval_set_text  (sysfsval_t *self, const char *text);
+bool               sysfsval_set_pair  (sysfsval_t *self, int first, int second);
 void               sysfsval_assume    (sysfsval_t *self, int value);
 void               sysfsval_invalidate(sysfsval_t *self);
 bool               sysfsval_refresh   (sysfsval_t *self);
+bool               sysfsval_watch     (sysfsval_t *self, sysfsval_notify_fn cb, void *aptr);
+void               sysfsval_unwatch   (sysfsval_t *self);
+
+void               sysfsval_registry_flush(void);
+void               sysfsval_set_resolver  (sysfsval_resolve_fn cb);
+void               sysfsval_get_stats     (unsigned *written, unsigned *elided);
 
 #endif /* SYSFS_VAL_H_ */
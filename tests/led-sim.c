@@ -0,0 +1,509 @@
+/** @file led-sim.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Led engine simulator
+ *
+ * Runs scripted led scenarios against a fake backend, using a virtual
+ * clock and the virtual led timer - so that the results are fully
+ * deterministic and a minute of breathing takes no time at all.
+ *
+ * For each scenario the following are measured:
+ * - backend writes made after the change was requested
+ * - led timer wakeups per minute
+ * - latency from request until the backend shows the target color
+ *
+ * and compared against limits. Exit status is non-zero if any of
+ * the limits is exceeded, i.e. led engine behavior has regressed.
+ * ========================================================================= */
+
+#include "sysfs-led-main.h"
+#include "sysfs-led-timer.h"
+#include "sysfs-led-util.h"
+
+#include "mce-stubs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Write made to the fake backend */
+typedef struct
+{
+  int64_t tick;     // virtual time stamp [ms]
+  bool    blink;    // blink vs value write
+  int     arg[3];   // on/off, or r/g/b
+} sim_write_t;
+
+/** Measured scenario results */
+typedef struct
+{
+  int writes;       // backend writes made during the scenario
+  int wakeups;      // led timer wakeups per minute
+  int latency;      // time until target is shown [ms], or -1 if never
+} sim_result_t;
+
+/** Scenario description */
+typedef struct
+{
+  const char  *name;
+  int          duration;                         // measuring period [ms]
+  void       (*setup)(sysfs_led_t *led);         // state before change
+  void       (*change)(sysfs_led_t *led);        // change to measure
+  int          target[3];                        // -1 = any nonzero
+  sim_result_t limit;                            // maximum values
+} sim_scenario_t;
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+static int64_t  sim_clock_cb        (void);
+static void     sim_blink_cb        (void *data, int on_ms, int off_ms);
+static void     sim_value_cb        (void *data, int r, int g, int b);
+static void     sim_record          (bool blink, int a, int b, int c);
+static void     sim_advance         (int ms);
+static bool     sim_is_target       (const sim_write_t *write, const int *target);
+static void     sim_run             (const sim_scenario_t *scenario, sim_result_t *res);
+
+static void     sim_setup_off       (sysfs_led_t *led);
+static void     sim_setup_red       (sysfs_led_t *led);
+static void     sim_setup_breathing (sysfs_led_t *led);
+static void     sim_setup_sequence  (sysfs_led_t *led);
+static void     sim_change_red      (sysfs_led_t *led);
+static void     sim_change_green    (sysfs_led_t *led);
+static void     sim_change_level    (sysfs_led_t *led);
+static void     sim_change_blink    (sysfs_led_t *led);
+static void     sim_change_breathing(sysfs_led_t *led);
+static void     sim_change_sequence (sysfs_led_t *led);
+static void     sim_change_display  (sysfs_led_t *led);
+static void     sim_change_stack    (sysfs_led_t *led);
+
+int             main                (int argc, char **argv);
+
+/* ========================================================================= *
+ * FAKE BACKEND
+ * ========================================================================= */
+
+/** Maximum number of writes recorded per scenario */
+#define SIM_WRITES_MAX 8192
+
+/** Virtual clock [us] */
+static int64_t      sim_now = 0;
+
+/** Recorded backend writes */
+static sim_write_t  sim_writes[SIM_WRITES_MAX];
+static int          sim_write_count = 0;
+
+/** Number of led timer wakeups */
+static int          sim_wakeups = 0;
+
+/** Virtual clock function for led_util_set_clock() */
+static int64_t
+sim_clock_cb(void)
+{
+  return sim_now;
+}
+
+/** Record backend write at current virtual time */
+static void
+sim_record(bool blink, int a, int b, int c)
+{
+  if( sim_write_count < SIM_WRITES_MAX ) {
+    sim_write_t *write = &sim_writes[sim_write_count];
+    write->tick   = sim_now / 1000;
+    write->blink  = blink;
+    write->arg[0] = a;
+    write->arg[1] = b;
+    write->arg[2] = c;
+  }
+  sim_write_count += 1;
+}
+
+static void
+sim_blink_cb(void *data, int on_ms, int off_ms)
+{
+  (void)data;
+
+  sim_record(true, on_ms, off_ms, 0);
+}
+
+static void
+sim_value_cb(void *data, int r, int g, int b)
+{
+  (void)data;
+
+  sim_record(false, r, g, b);
+}
+
+/** Fake backend resembling a typical sysfs led */
+static const led_control_t sim_control =
+{
+  .name        = "simulator",
+  .can_breathe = true,
+  .breath_type = LED_RAMP_HALF_SINE,
+  .settle_type = LED_SETTLE_FIXED,
+  .settle_ms   = 10,
+  .step_delay  = 50,
+  .max_steps   = 256,
+  .blink       = sim_blink_cb,
+  .value       = sim_value_cb,
+};
+
+/** Advance virtual clock, dispatching led timers as they get due
+ *
+ * @param ms how much to advance the clock [ms]
+ */
+static void
+sim_advance(int ms)
+{
+  int64_t end = sim_now + ms * 1000LL;
+  int64_t due = 0;
+
+  while( led_timer_get_due(&due) && due * 1000 <= end ) {
+    if( sim_now < due * 1000 )
+      sim_now = due * 1000;
+    sim_wakeups += 1;
+    led_timer_run();
+  }
+
+  sim_now = end;
+}
+
+/* ========================================================================= *
+ * SCENARIOS
+ * ========================================================================= */
+
+static void
+sim_setup_off(sysfs_led_t *led)
+{
+  (void)led;
+}
+
+static void
+sim_setup_red(sysfs_led_t *led)
+{
+  sysfs_led_object_set_pattern(led, 255, 0, 0, 0, 0);
+}
+
+static void
+sim_setup_breathing(sysfs_led_t *led)
+{
+  sysfs_led_object_set_breathing(led, true);
+  sysfs_led_object_set_pattern(led, 0, 0, 255, 1000, 1000);
+}
+
+static void
+sim_setup_sequence(sysfs_led_t *led)
+{
+  static const led_keyframe_t frames[] =
+  {
+    { 255,   0,   0, 500, LED_INTERP_LINEAR },
+    {   0,   0, 255, 500, LED_INTERP_HOLD   },
+  };
+  sysfs_led_object_set_sequence(led, frames, G_N_ELEMENTS(frames), 1);
+}
+
+static void
+sim_change_red(sysfs_led_t *led)
+{
+  sysfs_led_object_set_pattern(led, 255, 0, 0, 0, 0);
+}
+
+static void
+sim_change_green(sysfs_led_t *led)
+{
+  sysfs_led_object_set_pattern(led, 0, 255, 0, 0, 0);
+}
+
+static void
+sim_change_level(sysfs_led_t *led)
+{
+  sysfs_led_object_set_brightness(led, 128);
+}
+
+static void
+sim_change_blink(sysfs_led_t *led)
+{
+  sysfs_led_object_set_pattern(led, 0, 255, 0, 500, 1500);
+}
+
+static void
+sim_change_breathing(sysfs_led_t *led)
+{
+  sysfs_led_object_set_breathing(led, true);
+  sysfs_led_object_set_pattern(led, 0, 0, 255, 1000, 1000);
+}
+
+static void
+sim_change_sequence(sysfs_led_t *led)
+{
+  static const led_keyframe_t frames[] =
+  {
+    { 255,   0,   0, 500, LED_INTERP_LINEAR },
+    {   0, 255,   0, 500, LED_INTERP_LINEAR },
+    {   0,   0, 255, 500, LED_INTERP_HOLD   },
+    {   0,   0,   0, 500, LED_INTERP_HOLD   },
+  };
+  sysfs_led_object_set_sequence(led, frames, G_N_ELEMENTS(frames), 0);
+}
+
+static void
+sim_change_display(sysfs_led_t *led)
+{
+  sysfs_led_object_set_display_state(led, false);
+}
+
+static void
+sim_change_stack(sysfs_led_t *led)
+{
+  static const led_keyframe_t red[] =
+  {
+    { 255,   0,   0, 1000, LED_INTERP_HOLD },
+    {   0,   0,   0, 1000, LED_INTERP_HOLD },
+  };
+  static const led_keyframe_t green[] =
+  {
+    {   0, 255,   0, 1000, LED_INTERP_HOLD },
+    {   0,   0,   0, 1000, LED_INTERP_HOLD },
+  };
+  sysfs_led_object_pattern_register(led, "red", 10, 4000,
+                                    red, G_N_ELEMENTS(red));
+  sysfs_led_object_pattern_register(led, "green", 10, 4000,
+                                    green, G_N_ELEMENTS(green));
+  sysfs_led_object_pattern_activate(led, "red", true);
+  sysfs_led_object_pattern_activate(led, "green", true);
+}
+
+/** Scripted scenarios and their regression limits
+ *
+ * The limits are what the led engine currently does - if a change
+ * makes things better, the limits should be tightened accordingly.
+ */
+static const sim_scenario_t sim_scenarios[] =
+{
+  {
+    .name     = "static-on",
+    .duration = 1000,
+    .setup    = sim_setup_off,
+    .change   = sim_change_red,
+    .target   = { 255, 0, 0 },
+    .limit    = { .writes = 2, .wakeups = 0, .latency = 0 },
+  },
+  {
+    .name     = "color-change",
+    .duration = 1000,
+    .setup    = sim_setup_red,
+    .change   = sim_change_green,
+    .target   = { 0, 255, 0 },
+    .limit    = { .writes = 1, .wakeups = 0, .latency = 0 },
+  },
+  {
+    .name     = "level-change",
+    .duration = 1000,
+    .setup    = sim_setup_red,
+    .change   = sim_change_level,
+    .target   = { 128, 0, 0 },
+    .limit    = { .writes = 1, .wakeups = 0, .latency = 0 },
+  },
+  {
+    .name     = "hw-blink",
+    .duration = 60000,
+    .setup    = sim_setup_off,
+    .change   = sim_change_blink,
+    .target   = { 0, 255, 0 },
+    .limit    = { .writes = 4, .wakeups = 1, .latency = 10 },
+  },
+  {
+    .name     = "breathing",
+    .duration = 60000,
+    .setup    = sim_setup_off,
+    .change   = sim_change_breathing,
+    .target   = { -1, -1, -1 },
+    .limit    = { .writes = 1200, .wakeups = 1200, .latency = 100 },
+  },
+  {
+    .name     = "breathing-to-static",
+    .duration = 1000,
+    .setup    = sim_setup_breathing,
+    .change   = sim_change_red,
+    .target   = { 255, 0, 0 },
+    .limit    = { .writes = 2, .wakeups = 0, .latency = 0 },
+  },
+  {
+    .name     = "sequence",
+    .duration = 60000,
+    .setup    = sim_setup_off,
+    .change   = sim_change_sequence,
+    .target   = { 255, 0, 0 },
+    .limit    = { .writes = 660, .wakeups = 660, .latency = 50 },
+  },
+  {
+    .name     = "sequence-end-level",
+    .duration = 1000,
+    .setup    = sim_setup_sequence,
+    .change   = sim_change_level,
+    .target   = { -1, -1, -1 },
+    .limit    = { .writes = 1, .wakeups = 0, .latency = 0 },
+  },
+  {
+    .name     = "display-off",
+    .duration = 60000,
+    .setup    = sim_setup_breathing,
+    .change   = sim_change_display,
+    .target   = { 0, 0, 255 },
+    .limit    = { .writes = 4, .wakeups = 1, .latency = 10 },
+  },
+  {
+    .name     = "stack-slicing",
+    .duration = 60000,
+    .setup    = sim_setup_off,
+    .change   = sim_change_stack,
+    .target   = { 255, 0, 0 },
+    .limit    = { .writes = 159, .wakeups = 160, .latency = 50 },
+  },
+};
+
+/* ========================================================================= *
+ * DRIVER
+ * ========================================================================= */
+
+/** Check if write shows the target color
+ *
+ * @param write  recorded write
+ * @param target color, negative values match any nonzero color
+ */
+static bool
+sim_is_target(const sim_write_t *write, const int *target)
+{
+  if( write->blink )
+    return false;
+
+  if( target[0] < 0 )
+    return write->arg[0] || write->arg[1] || write->arg[2];
+
+  return (write->arg[0] == target[0] &&
+          write->arg[1] == target[1] &&
+          write->arg[2] == target[2]);
+}
+
+/** Run scenario with a fresh led engine instance
+ *
+ * @param scenario scenario to run
+ * @param res      where to store measured results
+ */
+static void
+sim_run(const sim_scenario_t *scenario, sim_result_t *res)
+{
+  sysfs_led_t *led = sysfs_led_create(&sim_control);
+
+  scenario->setup(led);
+  sim_advance(5000);
+
+  sim_write_count = 0;
+  sim_wakeups     = 0;
+  int64_t start   = sim_now / 1000;
+
+  scenario->change(led);
+  sim_advance(scenario->duration);
+
+  res->writes  = sim_write_count;
+  res->wakeups = (int)(sim_wakeups * 60000LL / scenario->duration);
+  res->latency = -1;
+
+  for( int i = 0; i < sim_write_count && i < SIM_WRITES_MAX; ++i ) {
+    if( sim_is_target(&sim_writes[i], scenario->target) ) {
+      res->latency = (int)(sim_writes[i].tick - start);
+      break;
+    }
+  }
+
+  /* Let kernel settle time pass so that delete does not block */
+  sim_advance(1000);
+  sysfs_led_delete(led);
+}
+
+int
+main(int argc, char **argv)
+{
+  int exit_code = EXIT_SUCCESS;
+  int verbosity = LOG_WARNING;
+  int opt;
+
+  while( (opt = getopt(argc, argv, "v")) != -1 ) {
+    switch( opt ) {
+    case 'v':
+      verbosity = LOG_DEBUG;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-v]\n", *argv);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  mce_stubs_set_verbosity(verbosity);
+
+  sim_now = 1000 * 1000;
+  led_util_set_clock(sim_clock_cb);
+
+  if( !sysfs_led_sched_select(LED_TIMER_VIRTUAL) ) {
+    fprintf(stderr, "virtual led timer not available\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("%-20s %13s %13s %13s\n",
+         "scenario", "writes", "wakeups/min", "latency/ms");
+
+  for( size_t i = 0; i < G_N_ELEMENTS(sim_scenarios); ++i ) {
+    const sim_scenario_t *scenario = &sim_scenarios[i];
+    const sim_result_t   *limit    = &scenario->limit;
+    sim_result_t          res;
+
+    sim_run(scenario, &res);
+
+    bool ok = (res.writes  <= limit->writes  &&
+               res.wakeups <= limit->wakeups &&
+               res.latency >= 0 && res.latency <= limit->latency);
+
+    printf("%-20s %6d/%-6d %6d/%-6d %6d/%-6d %s\n", scenario->name,
+           res.writes,  limit->writes,
+           res.wakeups, limit->wakeups,
+           res.latency, limit->latency,
+           ok ? "ok" : "FAIL");
+
+    if( !ok )
+      exit_code = EXIT_FAILURE;
+  }
+
+  led_timer_quit();
+  led_util_set_clock(0);
+
+  return exit_code;
+}
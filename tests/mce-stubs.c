@@ -0,0 +1,183 @@
+/** @file mce-stubs.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Stand-ins for mce functionality used by the plugin
+ *
+ * Allows linking led engine and sysfsval code to host side test
+ * programs. Configuration values can be given via environment,
+ * e.g. MCE_HYBRIS_TEST_CONFIG="QuirkWakeupBudget=120;TimerBackend=glib"
+ * - group names are ignored.
+ * ========================================================================= */
+
+#include "mce-stubs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+static const char *mce_stubs_lookup  (const char *key, size_t *len);
+
+gboolean           mce_conf_has_group(const gchar *group);
+gboolean           mce_conf_has_key  (const gchar *group, const gchar *key);
+gchar             *mce_conf_get_string(const gchar *group, const gchar *key, const gchar *defaultval);
+gchar            **mce_conf_get_keys (const gchar *group, gsize *length);
+int                mce_log_p_        (int lev, const char *file, const char *func);
+
+/* ========================================================================= *
+ * CONFIG
+ * ========================================================================= */
+
+/** Locate configuration value from environment
+ *
+ * @param key  configuration key
+ * @param len  where to store length of the value
+ *
+ * @return pointer to start of value, or NULL if not defined
+ */
+static const char *
+mce_stubs_lookup(const char *key, size_t *len)
+{
+  const char *res = 0;
+  const char *cfg = getenv(MCE_STUBS_CONFIG_ENV);
+  size_t      klen = strlen(key);
+
+  for( const char *pos = cfg; pos && *pos; ) {
+    size_t n = strcspn(pos, ";");
+
+    if( n > klen && pos[klen] == '=' && !strncmp(pos, key, klen) ) {
+      res  = pos + klen + 1;
+      *len = n - klen - 1;
+      break;
+    }
+
+    pos += n;
+    if( *pos )
+      ++pos;
+  }
+
+  return res;
+}
+
+gboolean
+mce_conf_has_group(const gchar *group)
+{
+  (void)group;
+
+  return getenv(MCE_STUBS_CONFIG_ENV) != 0;
+}
+
+gboolean
+mce_conf_has_key(const gchar *group, const gchar *key)
+{
+  size_t len = 0;
+
+  (void)group;
+
+  return mce_stubs_lookup(key, &len) != 0;
+}
+
+gchar *
+mce_conf_get_string(const gchar *group, const gchar *key,
+                    const gchar *defaultval)
+{
+  size_t      len = 0;
+  const char *val = mce_stubs_lookup(key, &len);
+
+  (void)group;
+
+  if( val )
+    return strndup(val, len);
+
+  return defaultval ? strdup(defaultval) : 0;
+}
+
+gchar **
+mce_conf_get_keys(const gchar *group, gsize *length)
+{
+  const char *cfg  = getenv(MCE_STUBS_CONFIG_ENV);
+  gchar     **keys = g_strsplit(cfg ?: "", ";", 0);
+  gsize       n    = 0;
+
+  (void)group;
+
+  for( gsize i = 0; keys[i]; ++i ) {
+    char *eq = strchr(keys[i], '=');
+    if( !eq ) {
+      g_free(keys[i]);
+      continue;
+    }
+    *eq = 0;
+    keys[n++] = keys[i];
+  }
+  keys[n] = 0;
+
+  *length = n;
+  return keys;
+}
+
+/* ========================================================================= *
+ * LOGGING
+ * ========================================================================= */
+
+/** Verbosity level, messages above this are suppressed */
+static int mce_stubs_verbosity = LOG_WARNING;
+
+/** Log level check used by plugin logging when log hook is set
+ */
+int
+mce_log_p_(int lev, const char *file, const char *func)
+{
+  (void)file;
+  (void)func;
+
+  return lev <= mce_stubs_verbosity;
+}
+
+/** Log hook that prints to stderr
+ */
+static void
+mce_stubs_log_cb(int lev, const char *file, const char *func,
+                 const char *text)
+{
+  (void)lev;
+  (void)file;
+
+  fprintf(stderr, "%s: %s\n", func, text);
+}
+
+/** Route plugin logging to stderr with given verbosity
+ *
+ * @param verbosity syslog priority of least important messages to show
+ */
+void
+mce_stubs_set_verbosity(int verbosity)
+{
+  mce_stubs_verbosity = verbosity;
+  mce_hybris_set_log_hook(mce_stubs_log_cb);
+}
@@ -0,0 +1,429 @@
+/** @file sysfs-bench.c
+ *
+ * mce-plugin-libhybris - Libhybris plugin for Mode Control Entity
+ * <p>
+ * Copyright (C) 2017 Jolla Ltd.
+ * <p>
+ * @author Simo Piiroinen <simo.piiroinen@jollamobile.com>
+ *
+ * mce-plugin-libhybris is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License.
+ *
+ * mce-plugin-libhybris is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with mce-plugin-libhybris; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* ========================================================================= *
+ * Sysfsval micro-benchmark
+ *
+ * Compares the pwrite/pread based sysfsval fast path against the
+ * write + lseek/read + stdio formatting approach it replaced, using
+ * files on tmpfs. The unit of work is one led step, i.e. setting
+ * the red, green and blue channels.
+ *
+ * System calls made by the code under test are counted by wrapping
+ * the libc functions at link time (see Makefile). Syscall counts are
+ * deterministic and verified - timing and cpu cycle counts depend on
+ * the host and are just reported.
+ * ========================================================================= */
+
+#include "sysfs-val.h"
+
+#include "mce-stubs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include <glib.h>
+
+/* ========================================================================= *
+ * TYPES
+ * ========================================================================= */
+
+/** Benchmark case */
+typedef struct
+{
+  const char *name;
+  void      (*step)(int i);   // one led step worth of work
+  int         syscalls;       // expected syscalls per step, or -1
+} bench_case_t;
+
+/* ========================================================================= *
+ * PROTOTYPES
+ * ========================================================================= */
+
+ssize_t         __real_write       (int fd, const void *buf, size_t cnt);
+ssize_t         __real_read        (int fd, void *buf, size_t cnt);
+ssize_t         __real_pwrite      (int fd, const void *buf, size_t cnt, off_t offs);
+ssize_t         __real_pread       (int fd, void *buf, size_t cnt, off_t offs);
+off_t           __real_lseek       (int fd, off_t offs, int whence);
+ssize_t         __real_pwrite64    (int fd, const void *buf, size_t cnt, off64_t offs);
+ssize_t         __real_pread64     (int fd, void *buf, size_t cnt, off64_t offs);
+off64_t         __real_lseek64     (int fd, off64_t offs, int whence);
+
+ssize_t         __wrap_write       (int fd, const void *buf, size_t cnt);
+ssize_t         __wrap_read        (int fd, void *buf, size_t cnt);
+ssize_t         __wrap_pwrite      (int fd, const void *buf, size_t cnt, off_t offs);
+ssize_t         __wrap_pread       (int fd, void *buf, size_t cnt, off_t offs);
+off_t           __wrap_lseek       (int fd, off_t offs, int whence);
+ssize_t         __wrap_pwrite64    (int fd, const void *buf, size_t cnt, off64_t offs);
+ssize_t         __wrap_pread64     (int fd, void *buf, size_t cnt, off64_t offs);
+off64_t         __wrap_lseek64     (int fd, off64_t offs, int whence);
+
+static int64_t  bench_get_ns       (void);
+static int      bench_cycles_open  (void);
+static int64_t  bench_cycles_read  (int fd);
+static void     bench_fast_set     (int i);
+static void     bench_fast_elided  (int i);
+static void     bench_fast_refresh (int i);
+static void     bench_legacy_set   (int i);
+static void     bench_legacy_refresh(int i);
+static bool     bench_setup        (const char *dir);
+static void     bench_cleanup      (const char *dir);
+
+int             main               (int argc, char **argv);
+
+/* ========================================================================= *
+ * SYSCALL COUNTING
+ * ========================================================================= */
+
+/** Number of read/write/seek calls made */
+static unsigned bench_syscalls = 0;
+
+ssize_t
+__wrap_write(int fd, const void *buf, size_t cnt)
+{
+  bench_syscalls += 1;
+  return __real_write(fd, buf, cnt);
+}
+
+ssize_t
+__wrap_read(int fd, void *buf, size_t cnt)
+{
+  bench_syscalls += 1;
+  return __real_read(fd, buf, cnt);
+}
+
+ssize_t
+__wrap_pwrite(int fd, const void *buf, size_t cnt, off_t offs)
+{
+  bench_syscalls += 1;
+  return __real_pwrite(fd, buf, cnt, offs);
+}
+
+ssize_t
+__wrap_pread(int fd, void *buf, size_t cnt, off_t offs)
+{
+  bench_syscalls += 1;
+  return __real_pread(fd, buf, cnt, offs);
+}
+
+off_t
+__wrap_lseek(int fd, off_t offs, int whence)
+{
+  bench_syscalls += 1;
+  return __real_lseek(fd, offs, whence);
+}
+
+/* With _FILE_OFFSET_BITS=64 libc headers redirect to the 64-bit variants */
+
+ssize_t
+__wrap_pwrite64(int fd, const void *buf, size_t cnt, off64_t offs)
+{
+  bench_syscalls += 1;
+  return __real_pwrite64(fd, buf, cnt, offs);
+}
+
+ssize_t
+__wrap_pread64(int fd, void *buf, size_t cnt, off64_t offs)
+{
+  bench_syscalls += 1;
+  return __real_pread64(fd, buf, cnt, offs);
+}
+
+off64_t
+__wrap_lseek64(int fd, off64_t offs, int whence)
+{
+  bench_syscalls += 1;
+  return __real_lseek64(fd, offs, whence);
+}
+
+/* ========================================================================= *
+ * MEASURING
+ * ========================================================================= */
+
+/** Get monotonic time stamp [ns] */
+static int64_t
+bench_get_ns(void)
+{
+  struct timespec ts = { 0, 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** Open user space cpu cycle counter
+ *
+ * @return file descriptor, or -1 if performance counters are not available
+ */
+static int
+bench_cycles_open(void)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.size           = sizeof attr;
+  attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 0;
+  attr.exclude_hv     = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/** Read cpu cycle counter
+ *
+ * @return cycle count, or -1 if not available
+ */
+static int64_t
+bench_cycles_read(int fd)
+{
+  uint64_t cnt = 0;
+
+  if( fd == -1 || __real_read(fd, &cnt, sizeof cnt) != sizeof cnt )
+    return -1;
+
+  return (int64_t)cnt;
+}
+
+/* ========================================================================= *
+ * CASES
+ * ========================================================================= */
+
+/** Channels of the fake led */
+#define BENCH_CHANNELS 3
+
+static const char * const bench_names[BENCH_CHANNELS] =
+{
+  "red", "green", "blue",
+};
+
+/** Sysfsval objects for the fast path */
+static sysfsval_t *bench_val[BENCH_CHANNELS];
+
+/** File descriptors for the legacy path */
+static int bench_fd[BENCH_CHANNELS] = { -1, -1, -1 };
+
+/** Sysfsval: new values to all channels */
+static void
+bench_fast_set(int i)
+{
+  for( int c = 0; c < BENCH_CHANNELS; ++c )
+    sysfsval_set(bench_val[c], (i + c) & 255);
+}
+
+/** Sysfsval: values already in place */
+static void
+bench_fast_elided(int i)
+{
+  (void)i;
+
+  for( int c = 0; c < BENCH_CHANNELS; ++c )
+    sysfsval_set(bench_val[c], 128);
+}
+
+/** Sysfsval: read back all channels */
+static void
+bench_fast_refresh(int i)
+{
+  (void)i;
+
+  for( int c = 0; c < BENCH_CHANNELS; ++c )
+    sysfsval_refresh(bench_val[c]);
+}
+
+/** Replaced approach: format with snprintf() and write() */
+static void
+bench_legacy_set(int i)
+{
+  for( int c = 0; c < BENCH_CHANNELS; ++c ) {
+    char data[64];
+    int  todo = snprintf(data, sizeof data, "%d", (i + c) & 255);
+    /* Seek only to keep the tmpfs file from growing, sysfs
+     * does not need it and is not charged for it */
+    __real_lseek(bench_fd[c], 0, SEEK_SET);
+    if( write(bench_fd[c], data, todo) != todo )
+      abort();
+  }
+}
+
+/** Replaced approach: lseek(), read() and strtol() */
+static void
+bench_legacy_refresh(int i)
+{
+  (void)i;
+
+  for( int c = 0; c < BENCH_CHANNELS; ++c ) {
+    char data[64];
+    if( lseek(bench_fd[c], 0, SEEK_SET) == -1 )
+      abort();
+    int done = read(bench_fd[c], data, sizeof data - 1);
+    if( done <= 0 )
+      abort();
+    data[done] = 0;
+    if( strtol(data, 0, 0) < 0 )
+      abort();
+  }
+}
+
+static const bench_case_t bench_cases[] =
+{
+  { "sysfsval-set",     bench_fast_set,       3 * 1 },
+  { "sysfsval-elided",  bench_fast_elided,    3 * 0 },
+  { "sysfsval-refresh", bench_fast_refresh,   3 * 1 },
+  { "legacy-set",       bench_legacy_set,     3 * 1 },
+  { "legacy-refresh",   bench_legacy_refresh, 3 * 2 },
+};
+
+/* ========================================================================= *
+ * DRIVER
+ * ========================================================================= */
+
+/** Create channel files and open them both ways
+ */
+static bool
+bench_setup(const char *dir)
+{
+  bool ack = false;
+
+  for( int c = 0; c < BENCH_CHANNELS; ++c ) {
+    char path[256];
+    snprintf(path, sizeof path, "%s/%s", dir, bench_names[c]);
+
+    if( (bench_fd[c] = open(path, O_RDWR | O_CREAT, 0644)) == -1 ) {
+      perror(path);
+      goto EXIT;
+    }
+
+    if( !(bench_val[c] = sysfsval_create()) ||
+        !sysfsval_open_rw(bench_val[c], path) )
+      goto EXIT;
+  }
+
+  ack = true;
+
+EXIT:
+  return ack;
+}
+
+/** Close and remove channel files
+ */
+static void
+bench_cleanup(const char *dir)
+{
+  for( int c = 0; c < BENCH_CHANNELS; ++c ) {
+    char path[256];
+    snprintf(path, sizeof path, "%s/%s", dir, bench_names[c]);
+
+    sysfsval_delete(bench_val[c]), bench_val[c] = 0;
+    if( bench_fd[c] != -1 )
+      close(bench_fd[c]), bench_fd[c] = -1;
+    unlink(path);
+  }
+
+  rmdir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+  int  exit_code = EXIT_FAILURE;
+  int  rounds    = 100000;
+  char dir[]     = "/dev/shm/sysfs-bench-XXXXXX";
+  int  cycles_fd = -1;
+
+  if( argc > 1 )
+    rounds = atoi(argv[1]);
+
+  mce_stubs_set_verbosity(LOG_WARNING);
+
+  if( !mkdtemp(dir) ) {
+    /* No /dev/shm - fall back to /tmp, which might not be tmpfs */
+    strcpy(dir, "/tmp/sysfs-bench-XXXXXX");
+    if( !mkdtemp(dir) ) {
+      perror("mkdtemp");
+      goto EXIT;
+    }
+  }
+
+  if( !bench_setup(dir) )
+    goto CLEANUP;
+
+  /* Start from known state */
+  bench_fast_elided(0);
+  bench_fast_refresh(0);
+
+  cycles_fd = bench_cycles_open();
+
+  exit_code = EXIT_SUCCESS;
+
+  printf("%-20s %12s %12s %12s\n",
+         "case", "syscalls", "ns/step", "cycles/step");
+
+  for( size_t k = 0; k < G_N_ELEMENTS(bench_cases); ++k ) {
+    const bench_case_t *bench = &bench_cases[k];
+
+    /* Warm up and count syscalls of a single step */
+    bench->step(1);
+    bench_syscalls = 0;
+    bench->step(2);
+    unsigned syscalls = bench_syscalls;
+
+    int64_t c0 = bench_cycles_read(cycles_fd);
+    int64_t t0 = bench_get_ns();
+    for( int i = 0; i < rounds; ++i )
+      bench->step(i);
+    int64_t t1 = bench_get_ns();
+    int64_t c1 = bench_cycles_read(cycles_fd);
+
+    bool ok = (bench->syscalls < 0 || (int)syscalls == bench->syscalls);
+
+    char cycles[32] = "-";
+    if( c0 >= 0 && c1 >= c0 )
+      snprintf(cycles, sizeof cycles, "%" PRId64,
+               (c1 - c0) / rounds);
+
+    printf("%-20s %5u/%-6d %12" PRId64 " %12s %s\n",
+           bench->name, syscalls, bench->syscalls,
+           (t1 - t0) / rounds, cycles,
+           ok ? "ok" : "FAIL");
+
+    if( !ok )
+      exit_code = EXIT_FAILURE;
+  }
+
+CLEANUP:
+  if( cycles_fd != -1 )
+    close(cycles_fd);
+  bench_cleanup(dir);
+
+EXIT:
+  return exit_code;
+}